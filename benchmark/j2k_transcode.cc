@@ -35,15 +35,18 @@
 #include "array_data.h"
 #include "util.h"
 #include "version.h"
+#include "j2k_encoder.h"
 #include "j2k_transcode.h"
 #include "openjpeg_image.h"
 #include <sys/time.h>
 #include <iostream>
 #include <cstdio>
+#include <thread>
 
 using std::cout;
 using std::cerr;
 using std::shared_ptr;
+using std::vector;
 
 class Timer
 {
@@ -81,7 +84,7 @@ int
 main (int argc, char* argv[])
 {
 	if (argc < 2) {
-		cerr << "Syntax: " << argv[0] << " private-test-path\n";
+		cerr << "Syntax: " << argv[0] << " private-test-path [threads]\n";
 		exit (EXIT_FAILURE);
 	}
 
@@ -109,6 +112,18 @@ main (int argc, char* argv[])
 	cout << "Decompress: " << count / decompress.get() << " fps.\n";
 	cout << "Compress:   " << count / compress.get() << " fps.\n";
 
+	/* Encode the same frames with a J2KEncoder using 1, some and then all of the available threads */
+	vector<shared_ptr<const dcp::OpenJPEGImage>> frames (count, dcp::decompress_j2k(j2k, 0));
+	int const all_threads = std::max (1U, std::thread::hardware_concurrency());
+	for (auto threads: { 1, argc > 2 ? atoi(argv[2]) : std::max(1, all_threads / 2), all_threads }) {
+		dcp::J2KEncoder encoder (j2k_bandwidth, 24, false, false, threads);
+		Timer encode;
+		encode.start ();
+		encoder.encode (frames);
+		encode.stop ();
+		cout << "J2KEncoder with " << threads << " thread(s): " << count / encode.get() << " fps.\n";
+	}
+
 	FILE* f = fopen ("check.j2c", "wb");
 	fwrite (recomp.data(), 1, recomp.size(), f);
 	fclose (f);
@@ -33,15 +33,33 @@
 
 #include "openjpeg_image.h"
 #include "rgb_xyz.h"
+#include "rgb_xyz_avx2.h"
 #include "colour_conversion.h"
 #include <boost/scoped_array.hpp>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <thread>
 #include <stdint.h>
 
 using boost::scoped_array;
+using std::cout;
 using std::shared_ptr;
 
 int const trials = 256;
 
+/** Run f `trials' times and report the rate in megapixels per second */
+static void
+run (char const* name, dcp::Size size, std::function<void ()> f)
+{
+	auto const start = std::chrono::steady_clock::now();
+	for (int i = 0; i < trials; ++i) {
+		f ();
+	}
+	std::chrono::duration<double> const time = std::chrono::steady_clock::now() - start;
+	cout << name << ": " << (double(size.width) * size.height * trials / 1e6) / time.count() << " Mpixel/s\n";
+}
+
 int
 main ()
 {
@@ -60,10 +78,27 @@ main ()
 		}
 	}
 
-	shared_ptr<dcp::OpenJPEGImage> xyz;
-	for (int i = 0; i < trials; ++i) {
-		xyz = dcp::rgb_to_xyz (rgb.get(), size, size.width * 6, dcp::ColourConversion::srgb_to_xyz());
-	}
-}
+	auto const conversion = dcp::ColourConversion::srgb_to_xyz();
+	auto const xyz = dcp::rgb_to_xyz (rgb.get(), size, size.width * 6, conversion);
+	scoped_array<uint8_t> rgba (new uint8_t[size.width * size.height * 4]);
+
+	bool const avx2 = dcp::rgb_xyz_avx2 ();
 
+	for (auto use_avx2: { false, true }) {
+		if (use_avx2 && !avx2) {
+			cout << "AVX2 not available.\n";
+			break;
+		}
+		dcp::set_rgb_xyz_avx2 (use_avx2);
+		cout << (use_avx2 ? "AVX2" : "Scalar") << ":\n";
+		run ("  rgb_to_xyz ", size, [&]() { dcp::rgb_to_xyz(rgb.get(), size, size.width * 6, conversion); });
+		run ("  xyz_to_rgb ", size, [&]() { dcp::xyz_to_rgb(xyz, conversion, rgb.get(), size.width * 6); });
+		run ("  xyz_to_rgba", size, [&]() { dcp::xyz_to_rgba(xyz, conversion, rgba.get(), size.width * 4); });
+	}
 
+	int const threads = std::max(1U, std::thread::hardware_concurrency());
+	cout << threads << " threads:\n";
+	run ("  rgb_to_xyz ", size, [&]() { dcp::rgb_to_xyz(rgb.get(), size, size.width * 6, conversion, threads); });
+	run ("  xyz_to_rgb ", size, [&]() { dcp::xyz_to_rgb(xyz, conversion, rgb.get(), size.width * 6, threads); });
+	run ("  xyz_to_rgba", size, [&]() { dcp::xyz_to_rgba(xyz, conversion, rgba.get(), size.width * 4, threads); });
+}
@@ -0,0 +1,523 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  benchmark/suite.cc
+ *  @brief Benchmarks of the main read, verify and write paths, using synthetic DCPs.
+ *
+ *  Results are written as JSON so that they can be compared between releases.
+ */
+
+
+#include "atmos_asset.h"
+#include "atmos_asset_reader.h"
+#include "atmos_asset_writer.h"
+#include "atmos_frame.h"
+#include "certificate_chain.h"
+#include "compose.hpp"
+#include "cpl.h"
+#include "dcp.h"
+#include "decrypted_kdm.h"
+#include "encrypted_kdm.h"
+#include "interop_subtitle_asset.h"
+#include "j2k_encoder.h"
+#include "key.h"
+#include "language_tag.h"
+#include "local_time.h"
+#include "mono_picture_asset.h"
+#include "mono_picture_asset_reader.h"
+#include "mono_picture_asset_writer.h"
+#include "mono_picture_frame.h"
+#include "openjpeg_image.h"
+#include "reel.h"
+#include "reel_mono_picture_asset.h"
+#include "reel_sound_asset.h"
+#include "smpte_subtitle_asset.h"
+#include "sound_asset.h"
+#include "sound_asset_reader.h"
+#include "sound_asset_writer.h"
+#include "sound_frame.h"
+#include "stereo_picture_asset.h"
+#include "stereo_picture_asset_reader.h"
+#include "stereo_picture_asset_writer.h"
+#include "stereo_picture_frame.h"
+#include "subtitle_string.h"
+#include "util.h"
+#include "verify.h"
+#include "version.h"
+#include <boost/filesystem.hpp>
+#include <getopt.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+using std::cerr;
+using std::cout;
+using std::function;
+using std::make_shared;
+using std::map;
+using std::pair;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using boost::optional;
+
+
+/** @return the time taken to run f, in seconds */
+static double
+seconds (function<void ()> f)
+{
+	auto const start = std::chrono::steady_clock::now();
+	f ();
+	std::chrono::duration<double> const time = std::chrono::steady_clock::now() - start;
+	return time.count();
+}
+
+
+static string
+json_string (string s)
+{
+	string out = "\"";
+	for (auto i: s) {
+		if (i == '"' || i == '\\') {
+			out += '\\';
+			out += i;
+		} else if (static_cast<unsigned char>(i) < 0x20) {
+			char buffer[8];
+			snprintf (buffer, sizeof(buffer), "\\u%04x", i);
+			out += buffer;
+		} else {
+			out += i;
+		}
+	}
+	return out + "\"";
+}
+
+
+/** Results, in the order that they were added */
+class Results
+{
+public:
+	void add (string name, double value, string unit)
+	{
+		cerr << name << ": " << value << " " << unit << "\n";
+		_results.push_back ({name, {value, unit}});
+	}
+
+	string as_json (int frames) const
+	{
+		std::ostringstream s;
+		s << "{\n"
+		  << "  \"libdcp_version\": " << json_string(dcp::version) << ",\n"
+		  << "  \"git_commit\": " << json_string(dcp::git_commit) << ",\n"
+		  << "  \"frames\": " << frames << ",\n"
+		  << "  \"results\": {";
+		for (size_t i = 0; i < _results.size(); ++i) {
+			s << (i ? ",\n" : "\n")
+			  << "    " << json_string(_results[i].first) << ": { "
+			  << "\"value\": " << (std::isfinite(_results[i].second.first) ? _results[i].second.first : 0)
+			  << ", \"unit\": " << json_string(_results[i].second.second) << " }";
+		}
+		s << "\n  }\n}\n";
+		return s.str();
+	}
+
+private:
+	vector<pair<string, pair<double, string>>> _results;
+};
+
+
+/** @return a 2K frame of JPEG2000 with some detail in it, so that it is a realistic size */
+static dcp::ArrayData
+make_j2k ()
+{
+	dcp::Size const size (1998, 1080);
+	auto xyz = make_shared<dcp::OpenJPEGImage>(size);
+	for (int c = 0; c < 3; ++c) {
+		auto p = xyz->data(c);
+		for (int y = 0; y < size.height; ++y) {
+			for (int x = 0; x < size.width; ++x) {
+				*p++ = ((x * 4095 / size.width + y * (c + 1)) & 0xfff) ^ (rand() & 0x3f);
+			}
+		}
+	}
+
+	return dcp::J2KEncoder(150000000, 24, false, false).encode(xyz);
+}
+
+
+static shared_ptr<dcp::Subtitle>
+make_subtitle (int index)
+{
+	return make_shared<dcp::SubtitleString>(
+		optional<string>(),
+		false,
+		false,
+		false,
+		dcp::Colour(255, 255, 255),
+		42,
+		1,
+		dcp::Time(index * 48, 24, 24),
+		dcp::Time(index * 48 + 40, 24, 24),
+		0.5,
+		dcp::HAlign::CENTER,
+		0.8,
+		dcp::VAlign::TOP,
+		dcp::Direction::LTR,
+		dcp::String::compose("Subtitle number %1, which has a line of text of a typical length", index),
+		dcp::Effect::NONE,
+		dcp::Colour(0, 0, 0),
+		dcp::Time(),
+		dcp::Time()
+		);
+}
+
+
+static void
+help (string n)
+{
+	cerr << "Syntax: " << n << " [OPTION]\n"
+	     << "  -h, --help               show this help\n"
+	     << "  -f, --frames <n>         number of frames in each synthetic asset (default 240)\n"
+	     << "  -o, --output <file>      write JSON results to <file> rather than to stdout\n"
+	     << "  -d, --directory <dir>    empty or new directory to write synthetic DCPs to (default a temporary directory, which is removed afterwards)\n"
+	     << "  --openssl <path>         openssl binary to make certificates with for the KDM benchmarks (default openssl)\n";
+}
+
+
+int
+main (int argc, char* argv[])
+{
+	dcp::init ();
+
+	int frames = 240;
+	optional<boost::filesystem::path> output;
+	optional<boost::filesystem::path> directory;
+	boost::filesystem::path openssl = "openssl";
+
+	int option_index = 0;
+	while (true) {
+		static struct option long_options[] = {
+			{ "help", no_argument, 0, 'h' },
+			{ "frames", required_argument, 0, 'f' },
+			{ "output", required_argument, 0, 'o' },
+			{ "directory", required_argument, 0, 'd' },
+			{ "openssl", required_argument, 0, 'A' },
+			{ 0, 0, 0, 0 }
+		};
+
+		int c = getopt_long (argc, argv, "hf:o:d:A:", long_options, &option_index);
+
+		if (c == -1) {
+			break;
+		}
+
+		switch (c) {
+		case 'h':
+			help (argv[0]);
+			exit (EXIT_SUCCESS);
+		case 'f':
+			frames = atoi (optarg);
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'd':
+			directory = optarg;
+			break;
+		case 'A':
+			openssl = optarg;
+			break;
+		}
+	}
+
+	if (frames < 1) {
+		cerr << argv[0] << ": frames must be at least 1\n";
+		exit (EXIT_FAILURE);
+	}
+
+	/* Never clear out a directory that we were given, as it may hold things that the user wants to keep */
+	if (directory && boost::filesystem::exists(*directory) && !boost::filesystem::is_empty(*directory)) {
+		cerr << argv[0] << ": " << directory->string() << " already exists and is not empty\n";
+		exit (EXIT_FAILURE);
+	}
+
+	auto const dir = directory ? *directory : boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("libdcp-benchmark-%%%%-%%%%");
+	/* Everything that goes into the DCP that is verified is written here */
+	auto const dcp_dir = dir / "dcp";
+	boost::filesystem::create_directories (dcp_dir);
+
+	srand (1);
+	dcp::Fraction const edit_rate (24, 1);
+	Results results;
+
+	auto const j2k = make_j2k ();
+
+	/* Writing MXFs */
+
+	auto mono = make_shared<dcp::MonoPictureAsset>(edit_rate, dcp::Standard::SMPTE);
+	results.add ("mono_write", frames / seconds([&]() {
+		auto writer = mono->start_write (dcp_dir / "video.mxf", false);
+		for (int i = 0; i < frames; ++i) {
+			writer->write (j2k.data(), j2k.size());
+		}
+		writer->finalize ();
+	}), "fps");
+
+	auto stereo = make_shared<dcp::StereoPictureAsset>(edit_rate, dcp::Standard::SMPTE);
+	results.add ("stereo_write", frames / seconds([&]() {
+		auto writer = stereo->start_write (dir / "stereo.mxf", false);
+		for (int i = 0; i < frames * 2; ++i) {
+			writer->write (j2k.data(), j2k.size());
+		}
+		writer->finalize ();
+	}), "fps");
+
+	int const channels = 6;
+	int const sampling_rate = 48000;
+	int const samples_per_frame = sampling_rate / 24;
+	auto sound = make_shared<dcp::SoundAsset>(edit_rate, sampling_rate, channels, dcp::LanguageTag("en-GB"), dcp::Standard::SMPTE);
+	{
+		vector<vector<float>> audio (channels, vector<float>(samples_per_frame));
+		vector<float*> pointers;
+		for (int c = 0; c < channels; ++c) {
+			for (int s = 0; s < samples_per_frame; ++s) {
+				audio[c][s] = sin(2 * M_PI * 440 * (c + 1) * s / sampling_rate) * 0.5;
+			}
+			pointers.push_back (audio[c].data());
+		}
+
+		results.add ("sound_write", frames / seconds([&]() {
+			auto writer = sound->start_write (dcp_dir / "audio.mxf");
+			for (int i = 0; i < frames; ++i) {
+				writer->write (pointers.data(), samples_per_frame);
+			}
+			writer->finalize ();
+		}), "fps");
+	}
+
+	auto atmos = make_shared<dcp::AtmosAsset>(edit_rate, 0, 10, 118, 1);
+	{
+		vector<uint8_t> frame (32768);
+		for (auto& i: frame) {
+			i = rand() & 0xff;
+		}
+
+		results.add ("atmos_write", frames / seconds([&]() {
+			auto writer = atmos->start_write (dir / "atmos.mxf");
+			for (int i = 0; i < frames; ++i) {
+				writer->write (frame.data(), frame.size());
+			}
+			writer->finalize ();
+		}), "fps");
+	}
+
+	/* Reading MXFs */
+
+	results.add ("mono_read", frames / seconds([&]() {
+		auto reader = mono->start_read ();
+		for (int i = 0; i < frames; ++i) {
+			reader->get_frame (i);
+		}
+	}), "fps");
+
+	results.add ("stereo_read", frames / seconds([&]() {
+		auto reader = stereo->start_read ();
+		for (int i = 0; i < frames; ++i) {
+			reader->get_frame (i);
+		}
+	}), "fps");
+
+	results.add ("sound_read", frames / seconds([&]() {
+		auto reader = sound->start_read ();
+		for (int i = 0; i < frames; ++i) {
+			reader->get_frame (i);
+		}
+	}), "fps");
+
+	results.add ("atmos_read", frames / seconds([&]() {
+		auto reader = atmos->start_read ();
+		for (int i = 0; i < frames; ++i) {
+			reader->get_frame (i);
+		}
+	}), "fps");
+
+	/* Hashing */
+
+	auto const video_size = boost::filesystem::file_size (dcp_dir / "video.mxf");
+	results.add ("hash", video_size / 1e6 / seconds([&]() {
+		dcp::make_digest (dcp_dir / "video.mxf", {});
+	}), "MB/s");
+
+	/* Subtitles */
+
+	int const subtitles = std::max (1, frames * 4);
+
+	{
+		dcp::InteropSubtitleAsset interop;
+		for (int i = 0; i < subtitles; ++i) {
+			interop.add (make_subtitle(i));
+		}
+		results.add ("interop_subtitle_write", seconds([&]() {
+			interop.write (dir / "subs.xml");
+		}) * 1000, "ms");
+		results.add ("interop_subtitle_parse", seconds([&]() {
+			dcp::InteropSubtitleAsset (dir / "subs.xml");
+		}) * 1000, "ms");
+	}
+
+	{
+		dcp::SMPTESubtitleAsset smpte;
+		for (int i = 0; i < subtitles; ++i) {
+			smpte.add (make_subtitle(i));
+		}
+		results.add ("smpte_subtitle_write", seconds([&]() {
+			smpte.write (dir / "subs.mxf");
+		}) * 1000, "ms");
+		results.add ("smpte_subtitle_parse", seconds([&]() {
+			dcp::SMPTESubtitleAsset (dir / "subs.mxf");
+		}) * 1000, "ms");
+	}
+
+	/* Making and verifying a DCP */
+
+	{
+		dcp::DCP dcp (dcp_dir);
+		auto cpl = make_shared<dcp::CPL>("Benchmark", dcp::ContentKind::FEATURE, dcp::Standard::SMPTE);
+		cpl->add (
+			make_shared<dcp::Reel>(
+				make_shared<dcp::ReelMonoPictureAsset>(mono, 0),
+				make_shared<dcp::ReelSoundAsset>(sound, 0)
+				)
+			);
+		dcp.add (cpl);
+		results.add ("dcp_write_xml", seconds([&]() {
+			dcp.write_xml ();
+		}) * 1000, "ms");
+	}
+
+	{
+		/* Time spent in each stage, in the order that they were first seen */
+		vector<pair<string, double>> stages;
+		auto last = std::chrono::steady_clock::now();
+		auto stage = [&stages, &last](string name, optional<boost::filesystem::path>) {
+			auto const now = std::chrono::steady_clock::now();
+			if (!stages.empty()) {
+				stages.back().second += std::chrono::duration<double>(now - last).count();
+			}
+			last = now;
+			auto i = std::find_if (stages.begin(), stages.end(), [name](pair<string, double> const& s) { return s.first == name; });
+			if (i == stages.end()) {
+				stages.push_back ({name, 0});
+			} else {
+				/* Move it to the end so that time is added to it until the next stage starts */
+				auto existing = *i;
+				stages.erase (i);
+				stages.push_back (existing);
+			}
+		};
+
+		auto const total = seconds([&]() {
+			dcp::verify ({dcp_dir}, stage, [](float) {});
+		});
+		if (!stages.empty()) {
+			stages.back().second += std::chrono::duration<double>(std::chrono::steady_clock::now() - last).count();
+		}
+
+		results.add ("verify", total * 1000, "ms");
+		for (auto const& i: stages) {
+			results.add ("verify_stage: " + i.first, i.second * 1000, "ms");
+		}
+	}
+
+	/* KDMs */
+
+	try {
+		auto encrypted = make_shared<dcp::MonoPictureAsset>(edit_rate, dcp::Standard::SMPTE);
+		encrypted->set_key (dcp::Key());
+		auto writer = encrypted->start_write (dir / "encrypted.mxf", false);
+		writer->write (j2k.data(), j2k.size());
+		writer->finalize ();
+
+		auto cpl = make_shared<dcp::CPL>("Encrypted", dcp::ContentKind::FEATURE, dcp::Standard::SMPTE);
+		auto reel = make_shared<dcp::Reel>();
+		reel->add (make_shared<dcp::ReelMonoPictureAsset>(encrypted, 0));
+		cpl->add (reel);
+
+		auto signer = make_shared<dcp::CertificateChain>(openssl);
+		dcp::LocalTime from;
+		dcp::LocalTime to = from;
+		to.add_days (7);
+
+		int const trials = 20;
+		dcp::DecryptedKDM decrypted (cpl, dcp::Key(), from, to, "Benchmark", "Benchmark", from.as_string());
+		optional<dcp::EncryptedKDM> kdm;
+		results.add ("kdm_encrypt", seconds([&]() {
+			for (int i = 0; i < trials; ++i) {
+				kdm = decrypted.encrypt (signer, signer->leaf(), {}, dcp::Formulation::MODIFIED_TRANSITIONAL_1, true, optional<int>());
+			}
+		}) * 1000 / trials, "ms");
+
+		results.add ("kdm_decrypt", seconds([&]() {
+			for (int i = 0; i < trials; ++i) {
+				dcp::DecryptedKDM (*kdm, *signer->key());
+			}
+		}) * 1000 / trials, "ms");
+	} catch (std::exception& e) {
+		cerr << "Skipping KDM benchmarks: " << e.what() << "\n";
+	}
+
+	auto const json = results.as_json (frames);
+	if (output) {
+		std::ofstream f (output->string());
+		f << json;
+	} else {
+		cout << json;
+	}
+
+	if (!directory) {
+		boost::filesystem::remove_all (dir);
+	}
+
+	return 0;
+}
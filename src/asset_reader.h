@@ -43,9 +43,19 @@
 
 #include "asset.h"
 #include "crypto_context.h"
+#include "compose.hpp"
 #include "dcp_assert.h"
+#include "exceptions.h"
+#include "frame.h"
 #include <asdcp/AS_DCP.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 
 namespace dcp {
@@ -66,13 +76,33 @@ public:
 
 	~AssetReader ()
 	{
+		stop_read_ahead ();
 		delete _reader;
 	}
 
+	/** @param n Frame index, not taking EntryPoint into account.
+	 *  @return The frame.  If the caller has dropped all references to the
+	 *  frame returned by the previous call, and we are not reading ahead,
+	 *  that frame's buffer will be re-used for this one rather than a new
+	 *  one being allocated.  This may be called from more than one thread,
+	 *  but calls will not run in parallel.
+	 */
 	std::shared_ptr<const F> get_frame (int n) const
 	{
+		if (_read_ahead > 0) {
+			return get_read_ahead_frame (n);
+		}
+
+		std::unique_lock<std::mutex> lock (_last_mutex);
+
+		if (_last && _last.use_count() == 1) {
+			_last->read (_reader, n, _crypto_context, _check_hmac);
+			return _last;
+		}
+
 		/* Can't use make_shared here as the constructor is private */
-		return std::shared_ptr<const F> (new F(_reader, n, _crypto_context, _check_hmac));
+		_last.reset (new F(_reader, n, _crypto_context, _check_hmac));
+		return _last;
 	}
 
 	R* reader () const {
@@ -80,9 +110,29 @@ public:
 	}
 
 	void set_check_hmac (bool check) {
+		std::unique_lock<std::mutex> lock (_read_ahead_mutex);
 		_check_hmac = check;
 	}
 
+	/** Start reading (and, if there is a key, decrypting) frames on a background thread,
+	 *  ahead of the ones which are asked for by get_frame().  get_frame() will then return
+	 *  frames which have already been read where it can, and otherwise wait for the
+	 *  background thread to read the one that it wants.  Any frame may still be asked for,
+	 *  but reading in order gives the most benefit.  reader() must not be used while this
+	 *  is enabled.
+	 *
+	 *  @param frames Number of frames to keep read ahead, or 0 to stop reading ahead.
+	 */
+	void set_read_ahead (int frames)
+	{
+		stop_read_ahead ();
+		if (frames > 0) {
+			_read_ahead_end = container_duration (_reader);
+			_read_ahead = frames;
+			_read_ahead_thread = std::thread (&AssetReader::read_ahead, this);
+		}
+	}
+
 protected:
 	R* _reader = nullptr;
 	std::shared_ptr<DecryptionContext> _crypto_context;
@@ -105,7 +155,136 @@ private:
 		}
 	}
 
+	struct ReadAhead
+	{
+		std::shared_ptr<const F> frame;
+		/** Exception thrown when reading the frame, if there was one */
+		std::exception_ptr error;
+	};
+
+	std::shared_ptr<const F> get_read_ahead_frame (int n) const
+	{
+		std::unique_lock<std::mutex> lock (_read_ahead_mutex);
+		if (n < 0 || n >= _read_ahead_end) {
+			/* The read-ahead thread never reads outside the asset, so we would wait for ever */
+			boost::throw_exception (ReadError(String::compose("could not read frame %1, which is outside the asset", n)));
+		}
+		move_read_ahead_window (n);
+		_read_ahead_changed.wait (lock, [this, n]() { return _read_ahead_frames.find(n) != _read_ahead_frames.end(); });
+
+		auto i = _read_ahead_frames.find (n);
+		auto frame = i->second;
+		_read_ahead_frames.erase (i);
+		move_read_ahead_window (n + 1);
+
+		if (frame.error) {
+			std::rethrow_exception (frame.error);
+		}
+		return frame.frame;
+	}
+
+	/** @return The frame after the last one in the window of frames that we should read ahead,
+	 *  which stops at the end of the asset.  _read_ahead_mutex must be held by the caller.
+	 */
+	int read_ahead_window_end () const
+	{
+		return std::min (_read_ahead_position + _read_ahead, _read_ahead_end);
+	}
+
+	/** Move the window of frames that we should read ahead so that it starts at
+	 *  `position', forgetting any frames that are now outside it.  _read_ahead_mutex
+	 *  must be held by the caller.
+	 */
+	void move_read_ahead_window (int position) const
+	{
+		_read_ahead_position = position;
+		auto const end = read_ahead_window_end ();
+		auto i = _read_ahead_frames.begin ();
+		while (i != _read_ahead_frames.end()) {
+			if (i->first < position || i->first >= end) {
+				i = _read_ahead_frames.erase (i);
+			} else {
+				++i;
+			}
+		}
+		_read_ahead_changed.notify_all ();
+	}
+
+	/** Body of the thread which reads frames ahead */
+	void read_ahead ()
+	{
+		std::unique_lock<std::mutex> lock (_read_ahead_mutex);
+		while (!_read_ahead_stop) {
+			/* Find the first frame in the window that we don't yet have */
+			auto const end = read_ahead_window_end ();
+			auto next = _read_ahead_position;
+			while (next < end && _read_ahead_frames.find(next) != _read_ahead_frames.end()) {
+				++next;
+			}
+
+			if (next >= end) {
+				_read_ahead_changed.wait (lock);
+				continue;
+			}
+
+			auto const check_hmac = _check_hmac;
+			lock.unlock ();
+
+			ReadAhead frame;
+			try {
+				frame.frame.reset (new F(_reader, next, _crypto_context, check_hmac));
+			} catch (...) {
+				frame.error = std::current_exception ();
+			}
+
+			lock.lock ();
+			/* get_frame() may have moved the window while we were reading */
+			if (next >= _read_ahead_position && next < read_ahead_window_end()) {
+				_read_ahead_frames[next] = frame;
+				_read_ahead_changed.notify_all ();
+			}
+		}
+	}
+
+	void stop_read_ahead ()
+	{
+		if (!_read_ahead_thread.joinable()) {
+			return;
+		}
+
+		{
+			std::unique_lock<std::mutex> lock (_read_ahead_mutex);
+			_read_ahead_stop = true;
+			_read_ahead_changed.notify_all ();
+		}
+
+		_read_ahead_thread.join ();
+		_read_ahead_stop = false;
+		_read_ahead_frames.clear ();
+		_read_ahead = 0;
+	}
+
 	bool _check_hmac = true;
+	/** The frame that we returned from the last call to get_frame() */
+	mutable std::shared_ptr<F> _last;
+	/** mutex held by get_frame() to protect _last, and the frame it refers to, while it is being re-used */
+	mutable std::mutex _last_mutex;
+
+	/** Number of frames to read ahead, or 0.  This is atomic as get_frame() looks at it without
+	 *  taking _read_ahead_mutex.
+	 */
+	std::atomic<int> _read_ahead{0};
+	/** Number of frames in the asset, found when reading ahead is started */
+	int _read_ahead_end = 0;
+	std::thread _read_ahead_thread;
+	/** Mutex to protect the _read_ahead_ variables below and _check_hmac */
+	mutable std::mutex _read_ahead_mutex;
+	mutable std::condition_variable _read_ahead_changed;
+	/** First frame of the window that we are reading ahead */
+	mutable int _read_ahead_position = 0;
+	/** Frames (or errors) which have been read ahead, keyed by index */
+	mutable std::map<int, ReadAhead> _read_ahead_frames;
+	bool _read_ahead_stop = false;
 };
 
 
@@ -37,10 +37,12 @@
  */
 
 
+#include "asset.h"
 #include "asset_writer.h"
 #include "crypto_context.h"
 #include "dcp_assert.h"
 #include "mxf.h"
+#include "util.h"
 #include <asdcp/AS_DCP.h>
 #include <asdcp/KM_prng.h>
 
@@ -66,5 +68,132 @@ AssetWriter::finalize ()
 {
 	DCP_ASSERT (!_finalized);
 	_finalized = true;
+
+	stop_write_behind ();
+
+	if (_started && _hash_on_finalize) {
+		auto asset = dynamic_cast<Asset*>(_mxf);
+		DCP_ASSERT (asset);
+		asset->set_hash (make_digest(_file, _hash_progress));
+	}
+
 	return _started;
 }
+
+
+void
+AssetWriter::set_hash_on_finalize (boost::function<void (float)> progress)
+{
+	_hash_on_finalize = true;
+	_hash_progress = progress;
+}
+
+
+void
+AssetWriter::set_write_behind (int writes)
+{
+	flush_write_behind ();
+	stop_write_behind ();
+	if (writes > 0) {
+		_write_behind = writes;
+		_write_behind_thread = std::thread (&AssetWriter::write_behind_thread, this);
+	}
+}
+
+
+void
+AssetWriter::write_behind (std::function<void ()> write)
+{
+	if (_write_behind == 0) {
+		write ();
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock (_write_behind_mutex);
+	_write_behind_changed.wait (lock, [this]() {
+		return _write_behind_error || static_cast<int>(_write_behind_queue.size()) < _write_behind;
+	});
+
+	if (_write_behind_error) {
+		auto error = _write_behind_error;
+		_write_behind_error = nullptr;
+		std::rethrow_exception (error);
+	}
+
+	_write_behind_queue.push_back (write);
+	_write_behind_changed.notify_all ();
+}
+
+
+void
+AssetWriter::flush_write_behind ()
+{
+	if (!_write_behind_thread.joinable()) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock (_write_behind_mutex);
+	_write_behind_changed.wait (lock, [this]() {
+		return _write_behind_error || (_write_behind_queue.empty() && !_write_behind_busy);
+	});
+
+	if (_write_behind_error) {
+		auto error = _write_behind_error;
+		_write_behind_error = nullptr;
+		std::rethrow_exception (error);
+	}
+}
+
+
+void
+AssetWriter::stop_write_behind ()
+{
+	if (!_write_behind_thread.joinable()) {
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock (_write_behind_mutex);
+		_write_behind_stop = true;
+		_write_behind_changed.notify_all ();
+	}
+
+	_write_behind_thread.join ();
+	_write_behind_stop = false;
+	_write_behind_queue.clear ();
+	_write_behind = 0;
+}
+
+
+void
+AssetWriter::write_behind_thread ()
+{
+	std::unique_lock<std::mutex> lock (_write_behind_mutex);
+	while (true) {
+		_write_behind_changed.wait (lock, [this]() { return _write_behind_stop || !_write_behind_queue.empty(); });
+		if (_write_behind_stop) {
+			return;
+		}
+
+		auto write = _write_behind_queue.front ();
+		_write_behind_queue.pop_front ();
+		_write_behind_busy = true;
+		lock.unlock ();
+
+		std::exception_ptr error;
+		try {
+			write ();
+		} catch (...) {
+			error = std::current_exception ();
+		}
+
+		lock.lock ();
+		_write_behind_busy = false;
+		if (error) {
+			/* Later writes are abandoned, since the file is probably now broken */
+			_write_behind_error = error;
+			_write_behind_queue.clear ();
+		}
+		_write_behind_changed.notify_all ();
+	}
+}
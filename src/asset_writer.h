@@ -44,6 +44,14 @@
 #include "types.h"
 #include "crypto_context.h"
 #include <boost/filesystem.hpp>
+#include <boost/function.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
 
 
 namespace dcp {
@@ -69,6 +77,21 @@ public:
 	/** @return true if anything was written by this writer */
 	virtual bool finalize ();
 
+	/** Ask finalize() to compute the digest of the finished file and give it to the asset
+	 *  with Asset::set_hash(), so that it need not be read again when the PKL is written.
+	 *  asdcplib re-writes the header at the start of the file as it finalizes, so the digest
+	 *  cannot be built up as frames are written; instead the file is read back straight
+	 *  afterwards, while it is likely to still be in the page cache.
+	 *
+	 *  @param progress Called with the proportion of the file that has been hashed.  It may throw
+	 *  to cancel the hash, in which case finalize() will pass the exception on once the file
+	 *  itself has been finalized.
+	 */
+	void set_hash_on_finalize (boost::function<void (float)> progress = boost::function<void (float)>());
+
+	/** @return number of frames written so far; with write-behind this does not include
+	 *  those which are still queued.
+	 */
 	int64_t frames_written () const {
 		return _frames_written;
 	}
@@ -76,6 +99,30 @@ public:
 protected:
 	AssetWriter (MXF* mxf, boost::filesystem::path file);
 
+	/** Start doing writes on a background thread, so that a caller which is (for example)
+	 *  encoding frames need not wait for storage.  Writes which are queued with write_behind()
+	 *  are then done in order on that thread; an error from one is thrown by the next call to
+	 *  write_behind() or flush_write_behind().
+	 *
+	 *  @param writes Maximum number of writes to queue before write_behind() waits for
+	 *  some to finish, or 0 to go back to writing on the calling thread.
+	 */
+	void set_write_behind (int writes);
+
+	/** @return true if set_write_behind() has started a write-behind thread */
+	bool writing_behind () const {
+		return _write_behind > 0;
+	}
+
+	/** Queue a write for the write-behind thread, or just do it now if there is no such thread */
+	void write_behind (std::function<void ()> write);
+
+	/** Wait for all queued writes to finish, throwing any error that one of them had */
+	void flush_write_behind ();
+
+	/** Stop the write-behind thread, abandoning any writes which are still queued */
+	void stop_write_behind ();
+
 	/** MXF that we are writing */
 	MXF* _mxf = nullptr;
 	/** File that we are writing to */
@@ -83,12 +130,34 @@ protected:
 	/** Number of `frames' written so far; the definition of a frame
 	 *  varies depending on the subclass.
 	 */
-	int64_t _frames_written = 0;
+	std::atomic<int64_t> _frames_written{0};
 	/** true if finalize() has been called on this object */
 	bool _finalized = false;
 	/** true if something has been written to this asset */
 	bool _started = false;
 	std::shared_ptr<EncryptionContext> _crypto_context;
+
+private:
+	/** true if finalize() should compute the file's digest */
+	bool _hash_on_finalize = false;
+	boost::function<void (float)> _hash_progress;
+
+	/** Body of the write-behind thread */
+	void write_behind_thread ();
+
+	/** Maximum number of queued writes, or 0 if we are not using write-behind */
+	int _write_behind = 0;
+	std::thread _write_behind_thread;
+	/** Mutex to protect the _write_behind_ variables below */
+	std::mutex _write_behind_mutex;
+	std::condition_variable _write_behind_changed;
+	/** Writes waiting to be done by the write-behind thread */
+	std::list<std::function<void ()>> _write_behind_queue;
+	/** true if the write-behind thread is doing a write */
+	bool _write_behind_busy = false;
+	/** Error from a write which has not yet been thrown */
+	std::exception_ptr _write_behind_error;
+	bool _write_behind_stop = false;
 };
 
 }
@@ -0,0 +1,66 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/compiled_colour_conversion.cc
+ *  @brief CompiledColourConversion class.
+ */
+
+
+#include "colour_conversion.h"
+#include "compiled_colour_conversion.h"
+#include "rgb_xyz.h"
+#include "transfer_function.h"
+
+
+using namespace dcp;
+
+
+CompiledColourConversion::CompiledColourConversion (ColourConversion const& conversion)
+	: _in (conversion.in())
+	, _out (conversion.out())
+	, _rgb_to_xyz_lut_in (_in->lut(12, false))
+	, _rgb_to_xyz_lut_out (_out->lut(16, true))
+	, _xyz_to_rgb_lut_in (_out->lut(12, false))
+	, _xyz_to_rgb_lut_out (_in->lut(16, true))
+{
+	combined_rgb_to_xyz (conversion, _rgb_to_xyz_matrix);
+
+	auto const matrix = conversion.xyz_to_rgb ();
+	for (int y = 0; y < 3; ++y) {
+		for (int x = 0; x < 3; ++x) {
+			_xyz_to_rgb_matrix[y * 3 + x] = matrix (y, x);
+		}
+	}
+}
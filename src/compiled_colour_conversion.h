@@ -0,0 +1,119 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/compiled_colour_conversion.h
+ *  @brief CompiledColourConversion class.
+ */
+
+
+#ifndef LIBDCP_COMPILED_COLOUR_CONVERSION_H
+#define LIBDCP_COMPILED_COLOUR_CONVERSION_H
+
+
+#include <memory>
+
+
+namespace dcp {
+
+
+class ColourConversion;
+class TransferFunction;
+
+
+/** @class CompiledColourConversion
+ *  @brief The tables and matrices that rgb_to_xyz(), xyz_to_rgb() and xyz_to_rgba() need
+ *  to carry out a ColourConversion.
+ *
+ *  Making one of these does all the work that would otherwise be done on each call
+ *  to those functions (fetching LUTs, and multiplying and inverting matrices) so that it
+ *  can be done once and then shared between many frames and threads.  A CompiledColourConversion
+ *  is not changed after construction, so it can be used by many threads at the same time.
+ */
+class CompiledColourConversion
+{
+public:
+	explicit CompiledColourConversion (ColourConversion const& conversion);
+
+	/** @return LUT to linearise 12-bit RGB */
+	double const * rgb_to_xyz_lut_in () const {
+		return _rgb_to_xyz_lut_in;
+	}
+
+	/** @return LUT to apply the output transfer function to linear XYZ scaled to 16 bits */
+	double const * rgb_to_xyz_lut_out () const {
+		return _rgb_to_xyz_lut_out;
+	}
+
+	/** @return the product of the RGB to XYZ matrix, the Bradford transform and the DCI companding,
+	 *  as given by combined_rgb_to_xyz().
+	 */
+	double const * rgb_to_xyz_matrix () const {
+		return _rgb_to_xyz_matrix;
+	}
+
+	/** @return LUT to linearise 12-bit XYZ */
+	double const * xyz_to_rgb_lut_in () const {
+		return _xyz_to_rgb_lut_in;
+	}
+
+	/** @return LUT to apply the inverse of the input transfer function to linear RGB scaled to 16 bits */
+	double const * xyz_to_rgb_lut_out () const {
+		return _xyz_to_rgb_lut_out;
+	}
+
+	/** @return XYZ to RGB matrix */
+	double const * xyz_to_rgb_matrix () const {
+		return _xyz_to_rgb_matrix;
+	}
+
+private:
+	/** The transfer functions own the LUTs, so we must keep them */
+	std::shared_ptr<const TransferFunction> _in;
+	std::shared_ptr<const TransferFunction> _out;
+
+	double const * _rgb_to_xyz_lut_in;
+	double const * _rgb_to_xyz_lut_out;
+	double _rgb_to_xyz_matrix[9];
+
+	double const * _xyz_to_rgb_lut_in;
+	double const * _xyz_to_rgb_lut_out;
+	double _xyz_to_rgb_matrix[9];
+};
+
+
+}
+
+
+#endif
@@ -72,7 +72,11 @@ LIBDCP_DISABLE_WARNINGS
 LIBDCP_ENABLE_WARNINGS
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <exception>
+#include <mutex>
 #include <numeric>
+#include <thread>
 
 
 using std::string;
@@ -486,6 +490,63 @@ DCP::write_assetmap (
 }
 
 
+/** Calculate the hashes of those assets which are within a DCP, hashing several at once
+ *  @param root DCP directory.
+ *  @param threads Number of assets to hash at the same time.
+ */
+static void
+hash_assets (vector<shared_ptr<Asset>> assets, boost::filesystem::path root, int threads)
+{
+	/* Referenced assets from outside the DCP don't go in our PKL, so there's no need to hash them */
+	auto const canonical_root = boost::filesystem::canonical (root);
+	auto external = [&canonical_root](shared_ptr<Asset> asset) {
+		return !asset->file() || !relative_to_root(canonical_root, boost::filesystem::canonical(*asset->file()));
+	};
+	assets.erase (std::remove_if(assets.begin(), assets.end(), external), assets.end());
+
+	/* Each asset must only be hashed by one thread */
+	std::sort (assets.begin(), assets.end());
+	assets.erase (std::unique(assets.begin(), assets.end()), assets.end());
+
+	std::mutex mutex;
+	auto next = assets.begin();
+	std::exception_ptr error;
+
+	auto hash = [&]() {
+		while (true) {
+			shared_ptr<Asset> asset;
+			{
+				std::unique_lock<std::mutex> lock (mutex);
+				if (next == assets.end() || error) {
+					return;
+				}
+				asset = *next++;
+			}
+			try {
+				asset->hash ();
+			} catch (...) {
+				std::unique_lock<std::mutex> lock (mutex);
+				if (!error) {
+					error = std::current_exception ();
+				}
+			}
+		}
+	};
+
+	vector<std::thread> hashers;
+	for (int i = 0; i < std::max(1, threads); ++i) {
+		hashers.push_back (std::thread(hash));
+	}
+	for (auto& i: hashers) {
+		i.join ();
+	}
+
+	if (error) {
+		std::rethrow_exception (error);
+	}
+}
+
+
 void
 DCP::write_xml (
 	string issuer,
@@ -521,6 +582,7 @@ DCP::write_xml (
 	if (_pkls.empty()) {
 		pkl = make_shared<PKL>(standard, annotation_text, issue_date, issuer, creator);
 		_pkls.push_back (pkl);
+		hash_assets (assets(), _directory, _hash_threads);
 		for (auto i: assets()) {
 			i->add_to_pkl (pkl, _directory);
 		}
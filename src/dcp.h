@@ -161,6 +161,14 @@ public:
 
 	void resolve_refs (std::vector<std::shared_ptr<Asset>> assets);
 
+	/** Set the number of assets that write_xml() should hash at the same time.  Each one
+	 *  is read from start to finish, so more than a few may make a disk slower rather
+	 *  than faster.  The default is 2.
+	 */
+	void set_hash_threads (int threads) {
+		_hash_threads = threads;
+	}
+
 	/** @return Standard of a DCP that was read in */
 	boost::optional<Standard> standard () const {
 		return _standard;
@@ -207,6 +215,8 @@ private:
 
 	/** Standard of DCP that was read in */
 	boost::optional<Standard> _standard;
+	/** Number of assets to hash at the same time in write_xml() */
+	int _hash_threads = 2;
 };
 
 
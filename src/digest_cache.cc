@@ -0,0 +1,277 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/digest_cache.cc
+ *  @brief DigestCache class
+ */
+
+
+#include "compose.hpp"
+#include "digest_cache.h"
+#include "exceptions.h"
+#include "util.h"
+#include <boost/algorithm/string.hpp>
+#include <sys/stat.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <vector>
+
+
+using std::istringstream;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using boost::optional;
+using namespace dcp;
+
+
+/** Files modified this recently (in nanoseconds) may still be changing without their modification time
+ *  changing, so their digests are not cached.
+ */
+static int64_t const settle_time = 2000000000LL;
+
+static std::mutex current_cache_mutex;
+static shared_ptr<DigestCache> current_cache;
+
+
+bool
+DigestCache::Identity::operator== (Identity const& other) const
+{
+	return device == other.device && inode == other.inode && size == other.size && modified == other.modified && changed == other.changed;
+}
+
+
+DigestCache::DigestCache (boost::filesystem::path file, Policy policy)
+	: _file (file)
+	, _policy (policy)
+{
+	if (!boost::filesystem::exists(file)) {
+		return;
+	}
+
+	vector<string> lines;
+	auto const contents = file_to_string (file, 256 * 1048576);
+	boost::split (lines, contents, boost::is_any_of("\n"));
+	for (auto const& line: lines) {
+		/* Each line is <digest> <device> <inode> <size> <modified> <changed> <path> */
+		istringstream s (line);
+		Entry entry;
+		s >> entry.digest >> entry.identity.device >> entry.identity.inode >> entry.identity.size >> entry.identity.modified >> entry.identity.changed;
+		if (!s || s.get() != ' ') {
+			continue;
+		}
+		string path;
+		std::getline (s, path);
+		if (!path.empty()) {
+			_entries[path] = entry;
+		}
+	}
+}
+
+
+optional<DigestCache::Identity>
+DigestCache::identity (boost::filesystem::path file)
+{
+	Identity id;
+#ifdef LIBDCP_WINDOWS
+	boost::system::error_code ec;
+	id.size = boost::filesystem::file_size (file, ec);
+	if (ec) {
+		return {};
+	}
+	auto const modified = boost::filesystem::last_write_time (file, ec);
+	if (ec) {
+		return {};
+	}
+	id.modified = static_cast<int64_t>(modified) * 1000000000LL;
+#else
+	struct stat st;
+	if (stat(file.c_str(), &st) != 0) {
+		return {};
+	}
+	id.device = st.st_dev;
+	id.inode = st.st_ino;
+	id.size = st.st_size;
+#ifdef LIBDCP_OSX
+	id.modified = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000LL + st.st_mtimespec.tv_nsec;
+	id.changed = static_cast<int64_t>(st.st_ctimespec.tv_sec) * 1000000000LL + st.st_ctimespec.tv_nsec;
+#else
+	id.modified = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+	id.changed = static_cast<int64_t>(st.st_ctim.tv_sec) * 1000000000LL + st.st_ctim.tv_nsec;
+#endif
+#endif
+	return id;
+}
+
+
+optional<string>
+DigestCache::get (boost::filesystem::path file) const
+{
+	boost::system::error_code ec;
+	auto const path = boost::filesystem::canonical (file, ec);
+	if (ec) {
+		return {};
+	}
+
+	auto const id = identity (path);
+	if (!id) {
+		return {};
+	}
+
+	std::unique_lock<std::mutex> lock (_mutex);
+	auto i = _entries.find (path);
+	if (i == _entries.end() || !(i->second.identity == *id)) {
+		return {};
+	}
+
+	return i->second.digest;
+}
+
+
+bool
+DigestCache::put (boost::filesystem::path file, string digest)
+{
+	boost::system::error_code ec;
+	auto const path = boost::filesystem::canonical (file, ec);
+	if (ec) {
+		return true;
+	}
+
+	auto const id = identity (path);
+	if (!id) {
+		return true;
+	}
+
+	std::unique_lock<std::mutex> lock (_mutex);
+
+	auto i = _entries.find (path);
+	bool const matched = i == _entries.end() || !(i->second.identity == *id) || i->second.digest == digest;
+	if (!matched) {
+		_mismatches.push_back (path);
+	}
+
+	auto const now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	if (now - id->modified < settle_time) {
+		return matched;
+	}
+
+	auto& entry = _entries[path];
+	if (entry.identity == *id && entry.digest == digest) {
+		return matched;
+	}
+	entry.identity = *id;
+	entry.digest = digest;
+	_dirty = true;
+	return matched;
+}
+
+
+vector<boost::filesystem::path>
+DigestCache::mismatches () const
+{
+	std::unique_lock<std::mutex> lock (_mutex);
+	return _mismatches;
+}
+
+
+void
+DigestCache::flush ()
+{
+	std::unique_lock<std::mutex> lock (_mutex);
+	if (_dirty) {
+		write ();
+		_dirty = false;
+	}
+}
+
+
+/** Write our entries to _file; must be called with _mutex held */
+void
+DigestCache::write () const
+{
+	/* Use a unique name so that other processes sharing the cache do not write over our temporary file */
+	auto tmp = boost::filesystem::unique_path (_file.string() + ".%%%%-%%%%-%%%%.tmp");
+
+	auto f = fopen_boost (tmp, "w");
+	if (!f) {
+		throw FileError ("could not open digest cache for writing", tmp, errno);
+	}
+
+	for (auto const& i: _entries) {
+		auto const& id = i.second.identity;
+		fprintf (
+			f, "%s %llu %llu %llu %lld %lld %s\n",
+			i.second.digest.c_str(),
+			static_cast<unsigned long long>(id.device),
+			static_cast<unsigned long long>(id.inode),
+			static_cast<unsigned long long>(id.size),
+			static_cast<long long>(id.modified),
+			static_cast<long long>(id.changed),
+			i.first.string().c_str()
+			);
+	}
+
+	if (fclose(f) != 0) {
+		auto const error = errno;
+		boost::system::error_code ec;
+		boost::filesystem::remove (tmp, ec);
+		throw FileError ("could not write digest cache", tmp, error);
+	}
+
+	boost::system::error_code ec;
+	boost::filesystem::rename (tmp, _file, ec);
+	if (ec) {
+		boost::filesystem::remove (tmp, ec);
+		throw FileError ("could not rename digest cache into place", _file, ec.value());
+	}
+}
+
+
+void
+dcp::set_digest_cache (shared_ptr<DigestCache> cache)
+{
+	std::unique_lock<std::mutex> lock (current_cache_mutex);
+	current_cache = cache;
+}
+
+
+shared_ptr<DigestCache>
+dcp::digest_cache ()
+{
+	std::unique_lock<std::mutex> lock (current_cache_mutex);
+	return current_cache;
+}
@@ -0,0 +1,151 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/digest_cache.h
+ *  @brief DigestCache class
+ */
+
+
+#ifndef LIBDCP_DIGEST_CACHE_H
+#define LIBDCP_DIGEST_CACHE_H
+
+
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace dcp {
+
+
+/** @class DigestCache
+ *  @brief An on-disk store of the SHA1 digests of files, so that unchanged files need not be hashed again.
+ *
+ *  A digest is only used if the file's device, inode, size, modification time and status change time
+ *  are all the same as when it was stored.  Once a cache has been given to set_digest_cache() it will
+ *  be consulted by make_digest() (and hence Asset::hash()).
+ */
+class DigestCache
+{
+public:
+	enum class Policy
+	{
+		/** Use a cached digest, if there is one, rather than hashing the file */
+		TRUST,
+		/** Always hash files, refreshing the cache with the results and noting any
+		 *  which do not match what was cached (see mismatches())
+		 */
+		VERIFY
+	};
+
+	/** @param file File to keep the cache in; it will be read now if it exists, and written by flush().
+	 *  Digests added since the last flush() are lost when the cache is destroyed.
+	 */
+	DigestCache (boost::filesystem::path file, Policy policy);
+
+	DigestCache (DigestCache const&) = delete;
+	DigestCache& operator= (DigestCache const&) = delete;
+
+	Policy policy () const {
+		return _policy;
+	}
+
+	/** @return the cached digest of a file, if there is one and it is still valid */
+	boost::optional<std::string> get (boost::filesystem::path file) const;
+
+	/** Store a file's digest, if the file looks like it is no longer being modified.
+	 *  The cache file is not written until flush() is called.
+	 *  @return false if the cache already had a different digest for the file as it is now,
+	 *  meaning that the cache was wrong; the file is then added to mismatches().
+	 */
+	bool put (boost::filesystem::path file, std::string digest);
+
+	/** @return files whose cached digests have been found by put() to be wrong */
+	std::vector<boost::filesystem::path> mismatches () const;
+
+	/** Write any new digests to the cache file; throws FileError if this fails */
+	void flush ();
+
+private:
+	struct Identity
+	{
+		uint64_t device = 0;
+		uint64_t inode = 0;
+		uint64_t size = 0;
+		/** modification time in nanoseconds */
+		int64_t modified = 0;
+		/** status change time in nanoseconds */
+		int64_t changed = 0;
+
+		bool operator== (Identity const& other) const;
+	};
+
+	struct Entry
+	{
+		Identity identity;
+		std::string digest;
+	};
+
+	static boost::optional<Identity> identity (boost::filesystem::path file);
+	void write () const;
+
+	boost::filesystem::path _file;
+	Policy _policy;
+
+	mutable std::mutex _mutex;
+	/** Entries keyed by canonical path */
+	std::map<boost::filesystem::path, Entry> _entries;
+	/** true if _entries has changed since it was last written to _file */
+	bool _dirty = false;
+	std::vector<boost::filesystem::path> _mismatches;
+};
+
+
+/** Set the cache that make_digest() should use, or nullptr to use none */
+extern void set_digest_cache (std::shared_ptr<DigestCache> cache);
+
+/** @return the cache that make_digest() should use, or nullptr */
+extern std::shared_ptr<DigestCache> digest_cache ();
+
+
+}
+
+
+#endif
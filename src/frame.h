@@ -43,25 +43,179 @@
 
 #include "crypto_context.h"
 #include "exceptions.h"
+#include "frame_buffer_pool.h"
 #include <asdcp/KM_fileio.h>
 #include <asdcp/AS_DCP.h>
+#include <algorithm>
+#include <memory>
 
 
 namespace dcp {
 
 
+template <class R, class F> class AssetReader;
+
+
+/** The largest buffer that read_frame() will grow a frame buffer to */
+int const maximum_frame_buffer_size = 64 * Kumu::Megabyte;
+
+
+/** @return A new frame buffer with at least `size' bytes of space, taken from the
+ *  frame_buffer_pool() if there is one.
+ */
+template <class B>
+std::shared_ptr<B>
+make_frame_buffer (int size)
+{
+	auto pool = frame_buffer_pool ();
+	if (!pool) {
+		return std::make_shared<B>(size);
+	}
+
+	auto block = pool->get (size);
+	auto buffer = new B ();
+	buffer->SetData (block->data(), block->size());
+	return std::shared_ptr<B>(buffer, [block](B* b) mutable {
+		delete b;
+		block.reset ();
+	});
+}
+
+
+template <>
+inline std::shared_ptr<ASDCP::JP2K::SFrameBuffer>
+make_frame_buffer (int size)
+{
+	auto pool = frame_buffer_pool ();
+	if (!pool) {
+		return std::make_shared<ASDCP::JP2K::SFrameBuffer>(size);
+	}
+
+	/* Take both blocks at once so that two readers cannot each hold one and wait for the other */
+	auto blocks = pool->get (size, 2);
+	auto left = blocks[0];
+	auto right = blocks[1];
+	auto buffer = new ASDCP::JP2K::SFrameBuffer ();
+	buffer->Left.SetData (left->data(), left->size());
+	buffer->Right.SetData (right->data(), right->size());
+	return std::shared_ptr<ASDCP::JP2K::SFrameBuffer>(buffer, [left, right](ASDCP::JP2K::SFrameBuffer* b) mutable {
+		delete b;
+		left.reset ();
+		right.reset ();
+	});
+}
+
+
+inline int
+container_duration (ASDCP::JP2K::MXFReader* reader)
+{
+	ASDCP::JP2K::PictureDescriptor desc;
+	return ASDCP_SUCCESS(reader->FillPictureDescriptor(desc)) ? desc.ContainerDuration : 0;
+}
+
+
+inline int
+container_duration (ASDCP::JP2K::MXFSReader* reader)
+{
+	ASDCP::JP2K::PictureDescriptor desc;
+	return ASDCP_SUCCESS(reader->FillPictureDescriptor(desc)) ? desc.ContainerDuration : 0;
+}
+
+
+inline int
+container_duration (ASDCP::PCM::MXFReader* reader)
+{
+	ASDCP::PCM::AudioDescriptor desc;
+	return ASDCP_SUCCESS(reader->FillAudioDescriptor(desc)) ? desc.ContainerDuration : 0;
+}
+
+
+inline int
+container_duration (ASDCP::ATMOS::MXFReader* reader)
+{
+	ASDCP::ATMOS::AtmosDescriptor desc;
+	return ASDCP_SUCCESS(reader->FillAtmosDescriptor(desc)) ? desc.ContainerDuration : 0;
+}
+
+
+/** @return The size of buffer needed for frame n of reader, judged from the distance between
+ *  its entry in the index and the next one.  This also covers the frame's KLV header (and, for
+ *  a stereo asset, both eyes) so it is a little more than the frame needs.  0 is returned if
+ *  the index cannot tell us, as is the case for the last frame.
+ */
+template <class R>
+int
+frame_size_from_index (R* reader, int n)
+{
+	/* Don't ask for an entry beyond the end, as asdcplib would log an error */
+	if (n < 0 || n + 1 >= container_duration(reader)) {
+		return 0;
+	}
+
+	Kumu::fpos_t start = 0;
+	Kumu::fpos_t end = 0;
+	i8_t temporal_offset = 0;
+	i8_t key_frame_offset = 0;
+	if (
+		ASDCP_FAILURE(reader->LocateFrame(n, start, temporal_offset, key_frame_offset)) ||
+		ASDCP_FAILURE(reader->LocateFrame(n + 1, end, temporal_offset, key_frame_offset)) ||
+		end <= start
+	   ) {
+		return 0;
+	}
+
+	return static_cast<int>(std::min(end - start, static_cast<Kumu::fpos_t>(maximum_frame_buffer_size)));
+}
+
+
+/** Read frame n from reader into buffer.  If the buffer is null, or the reader's index says that
+ *  the frame is bigger than the buffer, a new buffer is made of the size that the index gives;
+ *  if the index cannot say, a new buffer is made of `size' bytes and replaced with a bigger one
+ *  if asdcplib reports that it is too small.  The buffer is never made smaller, so reading
+ *  a run of frames into the same buffer only allocates when a frame bigger than all the
+ *  previous ones is found.
+ *  @param size Capacity of buffer, or the size to use for a new buffer if buffer is null and the
+ *  index cannot give one; updated if the buffer is replaced.
+ */
+template <class R, class B>
+ASDCP::Result_t
+read_frame (R* reader, int n, std::shared_ptr<B>& buffer, int& size, std::shared_ptr<const DecryptionContext> c, bool check_hmac)
+{
+	auto const indexed = frame_size_from_index (reader, n);
+	if (indexed > size) {
+		buffer.reset ();
+	}
+
+	if (!buffer) {
+		if (indexed) {
+			size = indexed;
+		}
+		buffer = make_frame_buffer<B>(size);
+	}
+
+	while (true) {
+		auto const r = reader->ReadFrame (n, *buffer, c->context(), check_hmac ? c->hmac() : nullptr);
+		if (r != Kumu::RESULT_SMALLBUF || size >= maximum_frame_buffer_size) {
+			return r;
+		}
+		size = std::min (size * 2, maximum_frame_buffer_size);
+		/* Give the old buffer back before asking for the new one, otherwise a pool which
+		 * cannot fit both would wait for ever for us to release it.
+		 */
+		buffer.reset ();
+		buffer = make_frame_buffer<B>(size);
+	}
+}
+
+
 template <class R, class B>
 class Frame
 {
 public:
 	Frame (R* reader, int n, std::shared_ptr<const DecryptionContext> c, bool check_hmac)
 	{
-		/* XXX: unfortunate guesswork on this buffer size */
-		_buffer = std::make_shared<B>(Kumu::Megabyte);
-
-		if (ASDCP_FAILURE(reader->ReadFrame(n, *_buffer, c->context(), check_hmac ? c->hmac() : nullptr))) {
-			boost::throw_exception (ReadError ("could not read frame"));
-		}
+		/* read() will make a buffer of the right size */
+		read (reader, n, c, check_hmac);
 	}
 
 	Frame (Frame const&) = delete;
@@ -77,8 +231,21 @@ public:
 		return _buffer->Size ();
 	}
 
+protected:
+	template <class, class> friend class AssetReader;
+
+	/** Read another frame into this object, re-using its buffer */
+	void read (R* reader, int n, std::shared_ptr<const DecryptionContext> c, bool check_hmac)
+	{
+		if (ASDCP_FAILURE(read_frame(reader, n, _buffer, _buffer_size, c, check_hmac))) {
+			boost::throw_exception (ReadError ("could not read frame"));
+		}
+	}
+
 private:
 	std::shared_ptr<B> _buffer;
+	/** Capacity of _buffer, or the size to make it if the index does not give one */
+	int _buffer_size = Kumu::Megabyte;
 };
 
 
@@ -0,0 +1,205 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/frame_buffer_pool.cc
+ *  @brief FrameBufferPool class
+ */
+
+
+#include "frame_buffer_pool.h"
+#include <condition_variable>
+#include <iterator>
+#include <map>
+#include <mutex>
+
+
+using std::make_pair;
+using std::shared_ptr;
+using std::vector;
+using namespace dcp;
+
+
+static std::mutex current_pool_mutex;
+static shared_ptr<FrameBufferPool> current_pool;
+
+
+struct FrameBufferPool::State
+{
+	explicit State (int64_t limit_)
+		: limit (limit_)
+	{}
+
+	~State ()
+	{
+		for (auto i: idle) {
+			delete i.second;
+		}
+	}
+
+	/** Return a block which was taken from the pool */
+	void release (Block* block)
+	{
+		std::unique_lock<std::mutex> lock (mutex);
+		in_use -= block->size();
+		idle.insert (make_pair(block->size(), block));
+		changed.notify_all ();
+	}
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	int64_t const limit;
+	int64_t allocated = 0;
+	int64_t in_use = 0;
+	/** Blocks which are not in use, keyed by size */
+	std::multimap<int, Block*> idle;
+};
+
+
+FrameBufferPool::FrameBufferPool (int64_t limit)
+	: _state (new State(limit))
+{
+
+}
+
+
+shared_ptr<FrameBufferPool::Block>
+FrameBufferPool::get (int size)
+{
+	return get(size, 1).front();
+}
+
+
+vector<shared_ptr<FrameBufferPool::Block>>
+FrameBufferPool::get (int size, int count)
+{
+	vector<Block*> blocks;
+	/* Blocks that can never fit in the pool are allocated outside it, but only once nothing is
+	 * in use, so that they can take no more memory than the pool would.
+	 */
+	bool const too_big = static_cast<int64_t>(count) * size > _state->limit;
+
+	std::unique_lock<std::mutex> lock (_state->mutex);
+	while (true) {
+		/* Take idle blocks that are big enough without being wastefully big */
+		auto i = _state->idle.lower_bound (size);
+		while (i != _state->idle.end() && i->first <= size * 2 && static_cast<int>(blocks.size()) < count) {
+			blocks.push_back (i->second);
+			i = _state->idle.erase (i);
+		}
+
+		/* Free the biggest of the other idle blocks until there is room for the new ones that we need */
+		int64_t const needed = static_cast<int64_t>(count - blocks.size()) * size;
+		while (_state->allocated + needed > _state->limit && !_state->idle.empty()) {
+			auto j = std::prev (_state->idle.end());
+			_state->allocated -= j->first;
+			delete j->second;
+			_state->idle.erase (j);
+		}
+
+		if (_state->allocated + needed <= _state->limit || (too_big && _state->in_use == 0)) {
+			break;
+		}
+
+		/* Put back what we took and wait for other threads to release some blocks */
+		for (auto j: blocks) {
+			_state->idle.insert (make_pair(j->size(), j));
+		}
+		blocks.clear ();
+		_state->changed.wait (lock);
+	}
+
+	vector<shared_ptr<Block>> result;
+	auto state = _state;
+
+	auto const pooled = std::min (
+		static_cast<int64_t>(count),
+		static_cast<int64_t>(blocks.size()) + std::max(int64_t(0), (_state->limit - _state->allocated) / size)
+		);
+
+	while (static_cast<int64_t>(blocks.size()) < pooled) {
+		blocks.push_back (new Block(size));
+		_state->allocated += size;
+	}
+
+	for (auto j: blocks) {
+		_state->in_use += j->size();
+		result.push_back (shared_ptr<Block>(j, [state](Block* b) { state->release(b); }));
+	}
+
+	while (static_cast<int>(result.size()) < count) {
+		result.push_back (std::make_shared<Block>(size));
+	}
+
+	return result;
+}
+
+
+int64_t
+FrameBufferPool::limit () const
+{
+	return _state->limit;
+}
+
+
+int64_t
+FrameBufferPool::allocated () const
+{
+	std::unique_lock<std::mutex> lock (_state->mutex);
+	return _state->allocated;
+}
+
+
+int64_t
+FrameBufferPool::in_use () const
+{
+	std::unique_lock<std::mutex> lock (_state->mutex);
+	return _state->in_use;
+}
+
+
+void
+dcp::set_frame_buffer_pool (shared_ptr<FrameBufferPool> pool)
+{
+	std::unique_lock<std::mutex> lock (current_pool_mutex);
+	current_pool = pool;
+}
+
+
+shared_ptr<FrameBufferPool>
+dcp::frame_buffer_pool ()
+{
+	std::unique_lock<std::mutex> lock (current_pool_mutex);
+	return current_pool;
+}
@@ -0,0 +1,136 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/frame_buffer_pool.h
+ *  @brief FrameBufferPool class
+ */
+
+
+#ifndef LIBDCP_FRAME_BUFFER_POOL_H
+#define LIBDCP_FRAME_BUFFER_POOL_H
+
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+namespace dcp {
+
+
+/** @class FrameBufferPool
+ *  @brief A bounded pool of memory for frame buffers, which can be shared by many readers.
+ *
+ *  Once a pool has been given to set_frame_buffer_pool() the buffers of frames read by
+ *  AssetReaders will be taken from it.  A block goes back to the pool when the last
+ *  reference to it is dropped, and can then be re-used.
+ */
+class FrameBufferPool
+{
+public:
+	/** @param limit Maximum number of bytes that the pool should have allocated at any one time */
+	explicit FrameBufferPool (int64_t limit);
+
+	FrameBufferPool (FrameBufferPool const&) = delete;
+	FrameBufferPool& operator= (FrameBufferPool const&) = delete;
+
+	class Block
+	{
+	public:
+		explicit Block (int size)
+			: _data (new uint8_t[size])
+			, _size (size)
+		{}
+
+		Block (Block const&) = delete;
+		Block& operator= (Block const&) = delete;
+
+		uint8_t* data () const {
+			return _data.get();
+		}
+
+		int size () const {
+			return _size;
+		}
+
+	private:
+		std::unique_ptr<uint8_t[]> _data;
+		int _size;
+	};
+
+	/** Get a block of at least `size' bytes.  If there is not enough room in the pool this will
+	 *  wait until other blocks are returned to it, so the pool's limit must allow for all the
+	 *  frames that will be held at once (including those in read-ahead windows); if the calling
+	 *  thread itself holds the blocks that it is waiting for, it will wait for ever.  A request
+	 *  which could never fit in the pool waits until nothing is in use and is then allocated
+	 *  outside the pool (and freed when it is released).
+	 */
+	std::shared_ptr<Block> get (int size);
+
+	/** Get `count' blocks of at least `size' bytes all at once, in the same way as get(int).
+	 *  This avoids the deadlock that could happen if two threads each took some of the blocks
+	 *  that they needed and then waited for the others.
+	 */
+	std::vector<std::shared_ptr<Block>> get (int size, int count);
+
+	int64_t limit () const;
+
+	/** @return number of bytes that the pool currently has allocated, whether they are in use or not */
+	int64_t allocated () const;
+
+	/** @return number of bytes in blocks that are currently in use */
+	int64_t in_use () const;
+
+private:
+	struct State;
+
+	/** State which is shared with the blocks that are in use, so that
+	 *  they can be returned even if this pool has been destroyed.
+	 */
+	std::shared_ptr<State> _state;
+};
+
+
+/** Set the pool that frame buffers should be taken from, or nullptr to allocate them individually */
+extern void set_frame_buffer_pool (std::shared_ptr<FrameBufferPool> pool);
+
+/** @return the pool that frame buffers should be taken from, or nullptr */
+extern std::shared_ptr<FrameBufferPool> frame_buffer_pool ();
+
+
+}
+
+
+#endif
@@ -0,0 +1,399 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/j2k_decoder.cc
+ *  @brief J2KDecoder class
+ */
+
+
+#include "compose.hpp"
+#include "data.h"
+#include "dcp_assert.h"
+#include "exceptions.h"
+#include "j2k_decoder.h"
+#include "j2k_errors.h"
+#include "j2k_transcode.h"
+#include "openjpeg_image.h"
+#include <openjpeg.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+
+using std::exception_ptr;
+using std::max;
+using std::min;
+using std::mutex;
+using std::pow;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using boost::optional;
+using namespace dcp;
+
+
+#if defined(OPJ_VERSION_MAJOR) && defined(OPJ_VERSION_MINOR)
+#if OPJ_VERSION_MAJOR > 2 || (OPJ_VERSION_MAJOR == 2 && OPJ_VERSION_MINOR >= 2)
+#define LIBDCP_HAVE_OPJ_CODEC_SET_THREADS
+#endif
+#endif
+
+
+J2KDecoder::J2KDecoder (int reduce)
+	: _reduce (reduce)
+{
+	DCP_ASSERT (reduce >= 0);
+}
+
+
+void
+J2KDecoder::set_reduce (int reduce)
+{
+	DCP_ASSERT (reduce >= 0);
+	_reduce = reduce;
+}
+
+
+void
+J2KDecoder::set_threads_per_frame (int threads)
+{
+	DCP_ASSERT (threads > 0);
+	_threads_per_frame = threads;
+}
+
+
+void
+J2KDecoder::set_layers (int layers)
+{
+	DCP_ASSERT (layers >= 0);
+	_layers = layers;
+}
+
+
+void
+J2KDecoder::set_area (optional<Area> area)
+{
+	DCP_ASSERT (!area || (area->x >= 0 && area->y >= 0 && area->width > 0 && area->height > 0));
+	_area = area;
+}
+
+
+shared_ptr<OpenJPEGImage>
+J2KDecoder::decode (Data const& data) const
+{
+	return decode (data.data(), data.size());
+}
+
+
+#ifdef LIBDCP_OPENJPEG2
+
+
+namespace {
+
+
+/** Source of data for openjpeg which reads straight from the caller's buffer.  openjpeg
+ *  will copy what it reads into its own stream buffer, but anything that it skips
+ *  (for example when only decoding part of an image) is not copied at all.
+ */
+class ReadBuffer
+{
+public:
+	ReadBuffer (uint8_t const * data, int64_t size)
+		: _data (data)
+		, _size (size)
+	{}
+
+	OPJ_SIZE_T read (void* buffer, OPJ_SIZE_T nb_bytes)
+	{
+		auto const N = min (nb_bytes, _size - _offset);
+		if (N == 0) {
+			/* This is how openjpeg expects to be told about the end of the stream */
+			return static_cast<OPJ_SIZE_T>(-1);
+		}
+		memcpy (buffer, _data + _offset, N);
+		_offset += N;
+		return N;
+	}
+
+	OPJ_OFF_T skip (OPJ_OFF_T nb_bytes)
+	{
+		if (nb_bytes > 0 && _offset == _size) {
+			return -1;
+		}
+		auto const target = max (OPJ_OFF_T(0), min (OPJ_OFF_T(_size), OPJ_OFF_T(_offset) + nb_bytes));
+		auto const skipped = target - OPJ_OFF_T(_offset);
+		_offset = target;
+		return skipped;
+	}
+
+	OPJ_BOOL seek (OPJ_OFF_T position)
+	{
+		if (position < 0 || position > OPJ_OFF_T(_size)) {
+			return OPJ_FALSE;
+		}
+		_offset = position;
+		return OPJ_TRUE;
+	}
+
+private:
+	uint8_t const * _data;
+	OPJ_SIZE_T _size;
+	OPJ_SIZE_T _offset = 0;
+};
+
+
+OPJ_SIZE_T
+read_function (void* buffer, OPJ_SIZE_T nb_bytes, void* data)
+{
+	return reinterpret_cast<ReadBuffer*>(data)->read (buffer, nb_bytes);
+}
+
+
+OPJ_OFF_T
+skip_function (OPJ_OFF_T nb_bytes, void* data)
+{
+	return reinterpret_cast<ReadBuffer*>(data)->skip (nb_bytes);
+}
+
+
+OPJ_BOOL
+seek_function (OPJ_OFF_T position, void* data)
+{
+	return reinterpret_cast<ReadBuffer*>(data)->seek (position);
+}
+
+
+/** Owner of the openjpeg objects used to decode one frame */
+class Decode
+{
+public:
+	Decode () = default;
+	Decode (Decode const&) = delete;
+	Decode& operator= (Decode const&) = delete;
+
+	~Decode ()
+	{
+		if (stream) {
+			opj_stream_destroy (stream);
+		}
+		if (codec) {
+			opj_destroy_codec (codec);
+		}
+		if (image) {
+			opj_image_destroy (image);
+		}
+	}
+
+	opj_codec_t* codec = nullptr;
+	opj_stream_t* stream = nullptr;
+	opj_image_t* image = nullptr;
+};
+
+
+}
+
+
+shared_ptr<OpenJPEGImage>
+J2KDecoder::decode (uint8_t const* data, int64_t size) const
+{
+	uint8_t const jp2_magic[] = {
+		0x00,
+		0x00,
+		0x00,
+		0x0c,
+		'j',
+		'P',
+		0x20,
+		0x20
+	};
+
+	auto format = OPJ_CODEC_J2K;
+	if (size >= int (sizeof (jp2_magic)) && memcmp (data, jp2_magic, sizeof (jp2_magic)) == 0) {
+		format = OPJ_CODEC_JP2;
+	}
+
+	auto failed = [format, size](J2KErrors const& errors) {
+		auto first = errors.first();
+		if (first) {
+			boost::throw_exception (J2KDecompressionError(*first));
+		} else if (format == OPJ_CODEC_J2K) {
+			boost::throw_exception (ReadError(String::compose("could not decode JPEG2000 codestream of %1 bytes.", size)));
+		} else {
+			boost::throw_exception (ReadError(String::compose("could not decode JP2 file of %1 bytes.", size)));
+		}
+	};
+
+	Decode objects;
+	J2KErrors errors;
+
+	/* openjpeg has no way to re-use a decompresser for a second codestream, so we need a new one for each frame */
+	objects.codec = opj_create_decompress (format);
+	if (!objects.codec) {
+		boost::throw_exception (ReadError("could not create JPEG2000 decompresser"));
+	}
+	opj_dparameters_t parameters;
+	opj_set_default_decoder_parameters (&parameters);
+	parameters.cp_reduce = _reduce;
+	parameters.cp_layer = _layers;
+	opj_setup_decoder (objects.codec, &parameters);
+	opj_set_error_handler (objects.codec, j2k_error_callback, &errors);
+
+#ifdef LIBDCP_HAVE_OPJ_CODEC_SET_THREADS
+	if (_threads_per_frame > 1) {
+		/* This fails harmlessly if openjpeg was built without thread support */
+		opj_codec_set_threads (objects.codec, _threads_per_frame);
+	}
+#endif
+
+	objects.stream = opj_stream_default_create (OPJ_TRUE);
+	if (!objects.stream) {
+		boost::throw_exception (MiscError("could not create JPEG2000 stream"));
+	}
+
+	ReadBuffer buffer (data, size);
+	opj_stream_set_read_function (objects.stream, read_function);
+	opj_stream_set_skip_function (objects.stream, skip_function);
+	opj_stream_set_seek_function (objects.stream, seek_function);
+	opj_stream_set_user_data (objects.stream, &buffer, nullptr);
+	opj_stream_set_user_data_length (objects.stream, size);
+
+	/* openjpeg can report an error and still return success, so check for both */
+	if (!opj_read_header(objects.stream, objects.codec, &objects.image) || errors.first()) {
+		failed (errors);
+	}
+
+	if (_area && !opj_set_decode_area(objects.codec, objects.image, _area->x, _area->y, _area->x + _area->width, _area->y + _area->height)) {
+		auto first = errors.first();
+		boost::throw_exception (J2KDecompressionError(first ? *first : "could not set JPEG2000 decode area"));
+	}
+
+	if (!opj_decode(objects.codec, objects.stream, objects.image) || errors.first()) {
+		failed (errors);
+	}
+
+	auto image = objects.image;
+	objects.image = nullptr;
+
+	if (_area) {
+		/* The decoded area is now at the top-left of the components, which have already been reduced */
+		image->x0 = 0;
+		image->y0 = 0;
+		image->x1 = image->comps[0].w;
+		image->y1 = image->comps[0].h;
+	} else {
+		image->x1 = rint (float(image->x1) / pow (2.0f, _reduce));
+		image->y1 = rint (float(image->y1) / pow (2.0f, _reduce));
+	}
+
+	return shared_ptr<OpenJPEGImage> (new OpenJPEGImage(image));
+}
+
+
+#endif
+
+
+#ifdef LIBDCP_OPENJPEG1
+
+shared_ptr<OpenJPEGImage>
+J2KDecoder::decode (uint8_t const* data, int64_t size) const
+{
+	if (_area || _layers) {
+		throw MiscError ("decoding part of a JPEG2000 image is not supported with openjpeg 1");
+	}
+
+	return decompress_j2k (data, size, _reduce);
+}
+
+#endif
+
+
+vector<shared_ptr<OpenJPEGImage>>
+J2KDecoder::decode (vector<shared_ptr<const Data>> const& frames, int threads) const
+{
+	vector<shared_ptr<OpenJPEGImage>> images (frames.size());
+	if (frames.empty()) {
+		return images;
+	}
+
+	if (threads <= 0) {
+		threads = max (1U, std::thread::hardware_concurrency());
+	}
+	threads = min (threads, static_cast<int>(frames.size()));
+
+	std::atomic<size_t> next (0);
+	mutex error_mutex;
+	exception_ptr error;
+
+	auto work = [this, &frames, &images, &next, &error_mutex, &error]() {
+		while (true) {
+			auto const index = next++;
+			if (index >= frames.size()) {
+				return;
+			}
+			try {
+				images[index] = decode (*frames[index]);
+			} catch (...) {
+				std::lock_guard<mutex> lm (error_mutex);
+				if (!error) {
+					error = std::current_exception ();
+				}
+				/* Stop the other threads picking up any more frames */
+				next = frames.size();
+				return;
+			}
+		}
+	};
+
+	vector<std::thread> workers;
+	for (int i = 1; i < threads; ++i) {
+		workers.push_back (std::thread(work));
+	}
+	/* This thread does its share too */
+	work ();
+
+	for (auto& i: workers) {
+		i.join ();
+	}
+
+	if (error) {
+		std::rethrow_exception (error);
+	}
+
+	return images;
+}
@@ -0,0 +1,147 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/j2k_decoder.h
+ *  @brief J2KDecoder class
+ */
+
+
+#ifndef LIBDCP_J2K_DECODER_H
+#define LIBDCP_J2K_DECODER_H
+
+
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+namespace dcp {
+
+
+class Data;
+class OpenJPEGImage;
+
+
+/** @class J2KDecoder
+ *  @brief A JPEG2000 decoder which can be set up once and then used to decode many frames.
+ *
+ *  decode() may be called from several threads at the same time.
+ */
+class J2KDecoder
+{
+public:
+	/** @param reduce A power of 2 by which to reduce the size of decoded images; see decompress_j2k() */
+	explicit J2KDecoder (int reduce = 0);
+
+	/** An area of an image, in the co-ordinates of the full-size image */
+	struct Area
+	{
+		Area () {}
+
+		Area (int x_, int y_, int width_, int height_)
+			: x (x_)
+			, y (y_)
+			, width (width_)
+			, height (height_)
+		{}
+
+		int x = 0;
+		int y = 0;
+		int width = 0;
+		int height = 0;
+	};
+
+	void set_reduce (int reduce);
+
+	/** Set the number of threads that openjpeg should use to decode each frame.  This
+	 *  has no effect if openjpeg is older than 2.2 or was built without thread support.
+	 */
+	void set_threads_per_frame (int threads);
+
+	/** Set the number of quality layers to decode, or 0 to decode all of them.  Decoding fewer
+	 *  layers is quicker, but gives a lower-quality image.
+	 */
+	void set_layers (int layers);
+
+	/** Decode only part of each frame, or the whole frame if area is not set.  Only the
+	 *  code-blocks which contribute to the area are decoded, which makes small areas
+	 *  much cheaper than decoding the whole frame and cropping.
+	 */
+	void set_area (boost::optional<Area> area);
+
+	int reduce () const {
+		return _reduce;
+	}
+
+	int layers () const {
+		return _layers;
+	}
+
+	int threads_per_frame () const {
+		return _threads_per_frame;
+	}
+
+	boost::optional<Area> area () const {
+		return _area;
+	}
+
+	/** Decode one frame.  The data is read directly from the given buffer, which must
+	 *  remain valid for the duration of the call.
+	 */
+	std::shared_ptr<OpenJPEGImage> decode (uint8_t const* data, int64_t size) const;
+	std::shared_ptr<OpenJPEGImage> decode (Data const& data) const;
+
+	/** Decode some frames using a set of threads.
+	 *  @param frames JPEG2000 data to decode.
+	 *  @param threads Number of threads to use, or 0 to use one per CPU.  Each of these threads
+	 *  will also use threads_per_frame() openjpeg threads.
+	 *  @return Decoded images, in the same order as frames.  If any frame fails to decode the
+	 *  exception from the first failure is re-thrown once all threads have finished.
+	 */
+	std::vector<std::shared_ptr<OpenJPEGImage>> decode (std::vector<std::shared_ptr<const Data>> const& frames, int threads = 0) const;
+
+private:
+	int _reduce = 0;
+	int _layers = 0;
+	int _threads_per_frame = 1;
+	boost::optional<Area> _area;
+};
+
+
+}
+
+
+#endif
@@ -0,0 +1,519 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/j2k_encoder.cc
+ *  @brief J2KEncoder class
+ */
+
+
+#include "compose.hpp"
+#include "dcp_assert.h"
+#include "exceptions.h"
+#include "j2k_encoder.h"
+#include "j2k_errors.h"
+#include "j2k_transcode.h"
+#include "openjpeg_image.h"
+#include <openjpeg.h>
+#include <boost/shared_array.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+
+using std::max;
+using std::min;
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using boost::optional;
+using namespace dcp;
+
+
+struct J2KEncoder::Scratch
+{
+	/** @return A copy of xyz for openjpeg to overwrite, re-using the image from last time if it can */
+	OpenJPEGImage& copy (OpenJPEGImage const& xyz)
+	{
+		auto source = xyz.opj_image();
+		auto dest = image ? image->opj_image() : nullptr;
+		if (dest && dest->x1 == source->x1 && dest->y1 == source->y1 && dest->numcomps == source->numcomps) {
+			for (unsigned int i = 0; i < source->numcomps; ++i) {
+				dest->comps[i].prec = source->comps[i].prec;
+				dest->comps[i].sgnd = source->comps[i].sgnd;
+				memcpy (dest->comps[i].data, source->comps[i].data, source->x1 * source->y1 * 4);
+			}
+		} else {
+			image.reset (new OpenJPEGImage(xyz));
+		}
+		return *image;
+	}
+
+	/** Copy of the image that is being encoded */
+	unique_ptr<OpenJPEGImage> image;
+};
+
+
+#ifdef LIBDCP_OPENJPEG2
+
+
+struct J2KEncoder::Parameters
+{
+	opj_cparameters_t parameters;
+	vector<char> comment;
+};
+
+
+J2KEncoder::J2KEncoder (int bandwidth, int frames_per_second, bool threed, bool fourk, int threads, string comment)
+	: _parameters (new Parameters)
+	, _threads (threads > 0 ? threads : max(1U, std::thread::hardware_concurrency()))
+{
+	if (comment.empty()) {
+		/* asdcplib complains with "Illegal data size" when reading frames encoded with an empty comment */
+		throw MiscError("JPEG2000 comment can not be an empty string");
+	}
+
+	_parameters->comment.assign (comment.begin(), comment.end());
+	_parameters->comment.push_back ('\0');
+
+	auto& parameters = _parameters->parameters;
+	opj_set_default_encoder_parameters (&parameters);
+	if (fourk) {
+		parameters.numresolution = 7;
+	}
+	parameters.rsiz = fourk ? OPJ_PROFILE_CINEMA_4K : OPJ_PROFILE_CINEMA_2K;
+	/* openjpeg takes a copy of this in opj_setup_encoder() */
+	parameters.cp_comment = _parameters->comment.data();
+
+	/* set max image */
+	parameters.max_cs_size = (bandwidth / 8) / frames_per_second;
+	if (threed) {
+		/* In 3D we have only half the normal bandwidth per eye */
+		parameters.max_cs_size /= 2;
+	}
+	parameters.max_comp_size = parameters.max_cs_size / 1.25;
+	parameters.tcp_numlayers = 1;
+	parameters.tcp_mct = 1;
+	parameters.numgbits = fourk ? 2 : 1;
+}
+
+
+int
+J2KEncoder::maximum_frame_size () const
+{
+	return _parameters->parameters.max_cs_size;
+}
+
+
+namespace {
+
+
+/** Destination for openjpeg's output, which writes into a buffer that is then handed to the
+ *  caller without being copied.
+ */
+class WriteBuffer
+{
+public:
+	/** @param capacity Size of buffer to start with; it is replaced with a bigger one if necessary */
+	explicit WriteBuffer (OPJ_SIZE_T capacity)
+		: _data (new uint8_t[capacity])
+		, _capacity (capacity)
+	{}
+
+	OPJ_SIZE_T write (void* buffer, OPJ_SIZE_T nb_bytes)
+	{
+		if (_offset + nb_bytes > _capacity) {
+			auto const capacity = max(_capacity * 2, _offset + nb_bytes);
+			boost::shared_array<uint8_t> bigger (new uint8_t[capacity]);
+			memcpy (bigger.get(), _data.get(), _length);
+			_data = bigger;
+			_capacity = capacity;
+		}
+		memcpy (_data.get() + _offset, buffer, nb_bytes);
+		_offset += nb_bytes;
+		_length = max (_length, _offset);
+		return nb_bytes;
+	}
+
+	OPJ_BOOL seek (OPJ_OFF_T position)
+	{
+		if (position < 0) {
+			return OPJ_FALSE;
+		}
+		_offset = position;
+		return OPJ_TRUE;
+	}
+
+	/** @return The codestream, which shares our buffer */
+	ArrayData data () const
+	{
+		return ArrayData (_data, _length);
+	}
+
+private:
+	boost::shared_array<uint8_t> _data;
+	OPJ_SIZE_T _capacity;
+	OPJ_SIZE_T _offset = 0;
+	/** Amount of _data that has been written */
+	OPJ_SIZE_T _length = 0;
+};
+
+
+OPJ_SIZE_T
+write_function (void* buffer, OPJ_SIZE_T nb_bytes, void* data)
+{
+	return reinterpret_cast<WriteBuffer*>(data)->write (buffer, nb_bytes);
+}
+
+
+OPJ_BOOL
+seek_function (OPJ_OFF_T position, void* data)
+{
+	return reinterpret_cast<WriteBuffer*>(data)->seek (position);
+}
+
+
+/** Owner of the openjpeg objects used to encode one frame */
+class Encode
+{
+public:
+	Encode () = default;
+	Encode (Encode const&) = delete;
+	Encode& operator= (Encode const&) = delete;
+
+	~Encode ()
+	{
+		if (stream) {
+			opj_stream_destroy (stream);
+		}
+		if (codec) {
+			opj_destroy_codec (codec);
+		}
+	}
+
+	opj_codec_t* codec = nullptr;
+	opj_stream_t* stream = nullptr;
+};
+
+
+}
+
+
+ArrayData
+J2KEncoder::encode_image (OpenJPEGImage& xyz, int max_cs_size) const
+{
+	auto image = xyz.opj_image();
+
+	Encode objects;
+	J2KErrors errors;
+
+	auto failed = [&errors](string message) {
+		auto first = errors.first();
+		if (first) {
+			message += ": " + *first;
+		}
+		boost::throw_exception (MiscError(message));
+	};
+
+	objects.codec = opj_create_compress (OPJ_CODEC_J2K);
+	if (!objects.codec) {
+		throw MiscError ("could not create JPEG2000 encoder");
+	}
+
+	opj_set_error_handler (objects.codec, j2k_error_callback, &errors);
+
+	/* opj_setup_encoder may change the parameters, so give it a copy */
+	auto parameters = _parameters->parameters;
+	parameters.max_cs_size = max_cs_size;
+	parameters.max_comp_size = max_cs_size / 1.25;
+	if (!opj_setup_encoder(objects.codec, &parameters, image) || errors.first()) {
+		failed ("could not set up JPEG2000 encoder");
+	}
+
+	objects.stream = opj_stream_default_create (OPJ_FALSE);
+	if (!objects.stream) {
+		throw MiscError ("could not create JPEG2000 stream");
+	}
+
+	/* Room for the biggest frame that we expect, plus some headers */
+	WriteBuffer buffer (parameters.max_cs_size + 65536);
+	opj_stream_set_write_function (objects.stream, write_function);
+	opj_stream_set_seek_function (objects.stream, seek_function);
+	opj_stream_set_user_data (objects.stream, &buffer, nullptr);
+
+	if (!opj_start_compress(objects.codec, image, objects.stream)) {
+		if ((errno & 0x61500) == 0x61500) {
+			/* We've had one of the magic error codes from our patched openjpeg */
+			boost::throw_exception (StartCompressionError(errno & 0xff));
+		} else {
+			boost::throw_exception (StartCompressionError());
+		}
+	}
+
+	if (errors.first()) {
+		failed ("could not start JPEG2000 encoding");
+	}
+
+	if (!opj_encode(objects.codec, objects.stream) || errors.first()) {
+		failed ("JPEG2000 encoding failed");
+	}
+
+	if (!opj_end_compress(objects.codec, objects.stream) || errors.first()) {
+		failed ("could not end JPEG2000 encoding");
+	}
+
+	return buffer.data ();
+}
+
+
+#endif
+
+
+#ifdef LIBDCP_OPENJPEG1
+
+
+struct J2KEncoder::Parameters
+{
+	int bandwidth;
+	int frames_per_second;
+	bool threed;
+	bool fourk;
+	string comment;
+};
+
+
+J2KEncoder::J2KEncoder (int bandwidth, int frames_per_second, bool threed, bool fourk, int threads, string comment)
+	: _parameters (new Parameters{bandwidth, frames_per_second, threed, fourk, comment})
+	, _threads (threads > 0 ? threads : max(1U, std::thread::hardware_concurrency()))
+{
+
+}
+
+
+int
+J2KEncoder::maximum_frame_size () const
+{
+	return (_parameters->bandwidth / 8) / _parameters->frames_per_second / (_parameters->threed ? 2 : 1);
+}
+
+
+ArrayData
+J2KEncoder::encode_image (OpenJPEGImage& xyz, int max_cs_size) const
+{
+	/* compress_j2k() takes a bandwidth, so work out the one that gives max_cs_size */
+	auto const bandwidth = int64_t(max_cs_size) * 8 * _parameters->frames_per_second * (_parameters->threed ? 2 : 1);
+	return compress_j2k (
+		shared_ptr<const OpenJPEGImage>(&xyz, [](OpenJPEGImage const*) {}),
+		bandwidth, _parameters->frames_per_second, _parameters->threed, _parameters->fourk, _parameters->comment
+		);
+}
+
+
+#endif
+
+
+J2KEncoder::~J2KEncoder ()
+{
+	{
+		std::unique_lock<std::mutex> lm (_queue_mutex);
+		_stopping = true;
+		_queue_condition.notify_all ();
+	}
+
+	for (auto& i: _workers) {
+		i.join ();
+	}
+}
+
+
+void
+J2KEncoder::set_frame_size_limit (optional<int> bytes)
+{
+	DCP_ASSERT (!bytes || *bytes > 0);
+	_frame_size_limit = bytes;
+}
+
+
+ArrayData
+J2KEncoder::encode (OpenJPEGImage const& xyz, OpenJPEGImage* in_place, Scratch& scratch) const
+{
+	auto target = maximum_frame_size ();
+	if (_frame_size_limit) {
+		target = min (target, *_frame_size_limit);
+	}
+
+	int const max_attempts = 8;
+	for (int attempt = 1; ; ++attempt) {
+		/* With a size limit we may need to encode the frame again, so openjpeg must not have the original */
+		auto& image = (in_place && !_frame_size_limit) ? *in_place : scratch.copy(xyz);
+		auto encoded = encode_image (image, target);
+		if (!_frame_size_limit || encoded.size() <= *_frame_size_limit) {
+			return encoded;
+		}
+
+		/* Lower the target by the amount that we overshot, and then a bit more */
+		target = min (int64_t(target) - 1, int64_t(target) * *_frame_size_limit * 97 / (int64_t(encoded.size()) * 100));
+
+		if (attempt == max_attempts || target <= 0) {
+			throw MiscError (String::compose("could not encode JPEG2000 frame in %1 bytes or less", *_frame_size_limit));
+		}
+	}
+}
+
+
+unique_ptr<J2KEncoder::Scratch>
+J2KEncoder::take_scratch () const
+{
+	std::unique_lock<std::mutex> lm (_scratch_mutex);
+	if (_scratch.empty()) {
+		return unique_ptr<Scratch>(new Scratch);
+	}
+
+	auto scratch = std::move (_scratch.back());
+	_scratch.pop_back ();
+	return scratch;
+}
+
+
+void
+J2KEncoder::give_back_scratch (unique_ptr<Scratch> scratch) const
+{
+	std::unique_lock<std::mutex> lm (_scratch_mutex);
+	_scratch.push_back (std::move(scratch));
+}
+
+
+ArrayData
+J2KEncoder::encode (shared_ptr<const OpenJPEGImage> xyz) const
+{
+	return encode (*xyz, nullptr);
+}
+
+
+ArrayData
+J2KEncoder::encode_in_place (shared_ptr<OpenJPEGImage> xyz) const
+{
+	return encode (*xyz, xyz.get());
+}
+
+
+ArrayData
+J2KEncoder::encode (OpenJPEGImage const& xyz, OpenJPEGImage* in_place) const
+{
+	auto scratch = take_scratch ();
+	try {
+		auto encoded = encode (xyz, in_place, *scratch);
+		give_back_scratch (std::move(scratch));
+		return encoded;
+	} catch (...) {
+		give_back_scratch (std::move(scratch));
+		throw;
+	}
+}
+
+
+std::future<ArrayData>
+J2KEncoder::encode_async (shared_ptr<const OpenJPEGImage> xyz)
+{
+	return queue (std::packaged_task<ArrayData ()>([this, xyz]() {
+		return encode (xyz);
+	}));
+}
+
+
+std::future<ArrayData>
+J2KEncoder::encode_async_in_place (shared_ptr<OpenJPEGImage> xyz)
+{
+	return queue (std::packaged_task<ArrayData ()>([this, xyz]() {
+		return encode_in_place (xyz);
+	}));
+}
+
+
+std::future<ArrayData>
+J2KEncoder::queue (std::packaged_task<ArrayData ()> task)
+{
+	auto future = task.get_future ();
+
+	std::unique_lock<std::mutex> lm (_queue_mutex);
+	if (_workers.empty()) {
+		for (int i = 0; i < _threads; ++i) {
+			_workers.push_back (std::thread(&J2KEncoder::thread, this));
+		}
+	}
+	_queue.push_back (std::move(task));
+	_queue_condition.notify_one ();
+
+	return future;
+}
+
+
+vector<ArrayData>
+J2KEncoder::encode (vector<shared_ptr<const OpenJPEGImage>> const& frames)
+{
+	vector<std::future<ArrayData>> futures;
+	for (auto i: frames) {
+		futures.push_back (encode_async(i));
+	}
+
+	vector<ArrayData> encoded;
+	for (auto& i: futures) {
+		encoded.push_back (i.get());
+	}
+	return encoded;
+}
+
+
+void
+J2KEncoder::thread ()
+{
+	while (true) {
+		std::unique_lock<std::mutex> lm (_queue_mutex);
+		while (_queue.empty() && !_stopping) {
+			_queue_condition.wait (lm);
+		}
+
+		if (_stopping) {
+			return;
+		}
+
+		auto task = std::move (_queue.front());
+		_queue.pop_front ();
+		lm.unlock ();
+
+		/* Any exception is passed on to the future */
+		task ();
+	}
+}
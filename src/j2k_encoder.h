@@ -0,0 +1,159 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/j2k_encoder.h
+ *  @brief J2KEncoder class
+ */
+
+
+#ifndef LIBDCP_J2K_ENCODER_H
+#define LIBDCP_J2K_ENCODER_H
+
+
+#include "array_data.h"
+#include <boost/optional.hpp>
+#include <condition_variable>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace dcp {
+
+
+class OpenJPEGImage;
+
+
+/** @class J2KEncoder
+ *  @brief A JPEG2000 encoder for DCI 2K or 4K frames which is set up once and then used to encode many frames.
+ *
+ *  encode() does not modify the image that is passed in: openjpeg overwrites the image that it
+ *  encodes, so it is given a copy in a scratch image which is kept for the next frame.  Callers
+ *  which do not need the image afterwards can use encode_in_place() to save the copy.  Each
+ *  codestream is written straight into the buffer of the ArrayData that is returned.
+ */
+class J2KEncoder
+{
+public:
+	/** @param bandwidth JPEG2000 bandwidth in bits per second.
+	 *  @param frames_per_second Frame rate of the DCP.
+	 *  @param threed true if the frames are for a 3D DCP, in which case each eye gets half of the bandwidth.
+	 *  @param fourk true to encode 4K frames, false to encode 2K.
+	 *  @param threads Number of threads for encode_async() to use, or 0 to use one per CPU.
+	 *  @param comment Comment to write into each codestream; this must not be empty.
+	 */
+	J2KEncoder (int bandwidth, int frames_per_second, bool threed, bool fourk, int threads = 0, std::string comment = "libdcp");
+	~J2KEncoder ();
+
+	J2KEncoder (J2KEncoder const&) = delete;
+	J2KEncoder& operator= (J2KEncoder const&) = delete;
+
+	/** Encode a frame on the calling thread.  This may be called from several threads at the same time */
+	ArrayData encode (std::shared_ptr<const OpenJPEGImage> xyz) const;
+
+	/** As encode(), but letting openjpeg use the image as its working space rather than a copy of it,
+	 *  so that its contents are undefined afterwards.  If a frame size limit is set the image is still
+	 *  copied, as it may need to be encoded more than once.
+	 */
+	ArrayData encode_in_place (std::shared_ptr<OpenJPEGImage> xyz) const;
+
+	/** Queue a frame to be encoded by this encoder's threads */
+	std::future<ArrayData> encode_async (std::shared_ptr<const OpenJPEGImage> xyz);
+
+	/** Queue a frame to be encoded by this encoder's threads as encode_in_place() does */
+	std::future<ArrayData> encode_async_in_place (std::shared_ptr<OpenJPEGImage> xyz);
+
+	/** Encode some frames using this encoder's threads.
+	 *  @return Codestreams, in the same order as frames.
+	 */
+	std::vector<ArrayData> encode (std::vector<std::shared_ptr<const OpenJPEGImage>> const& frames);
+
+	int threads () const {
+		return _threads;
+	}
+
+	/** @return the maximum size of each codestream in bytes, as requested from openjpeg */
+	int maximum_frame_size () const;
+
+	/** Set a hard limit on the size in bytes of each codestream, or none.  openjpeg's rate allocation
+	 *  can overshoot the size that it is asked for, so frames which come out too big are encoded again
+	 *  with lower targets until they fit.  For example, passing risky_picture_frame_size() makes sure
+	 *  that frames pass the Bv2.1 frame size checks in verify().  This must not be called while frames
+	 *  are being encoded.
+	 */
+	void set_frame_size_limit (boost::optional<int> bytes);
+
+	boost::optional<int> frame_size_limit () const {
+		return _frame_size_limit;
+	}
+
+private:
+	struct Parameters;
+	struct Scratch;
+
+	ArrayData encode (OpenJPEGImage const& xyz, OpenJPEGImage* in_place) const;
+	ArrayData encode (OpenJPEGImage const& xyz, OpenJPEGImage* in_place, Scratch& scratch) const;
+	/** Encode an image, which openjpeg may overwrite */
+	ArrayData encode_image (OpenJPEGImage& xyz, int max_cs_size) const;
+	std::future<ArrayData> queue (std::packaged_task<ArrayData ()> task);
+	std::unique_ptr<Scratch> take_scratch () const;
+	void give_back_scratch (std::unique_ptr<Scratch> scratch) const;
+	void thread ();
+
+	std::unique_ptr<Parameters> _parameters;
+	boost::optional<int> _frame_size_limit;
+
+	mutable std::mutex _scratch_mutex;
+	/** Scratch images and buffers which are not currently being used */
+	mutable std::vector<std::unique_ptr<Scratch>> _scratch;
+
+	int _threads;
+	std::mutex _queue_mutex;
+	std::condition_variable _queue_condition;
+	std::list<std::packaged_task<ArrayData ()>> _queue;
+	/** Threads to service _queue; these are started by the first call to encode_async() */
+	std::vector<std::thread> _workers;
+	bool _stopping = false;
+};
+
+
+}
+
+
+#endif
@@ -0,0 +1,94 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/j2k_errors.h
+ *  @brief J2KErrors class
+ */
+
+
+#ifndef LIBDCP_J2K_ERRORS_H
+#define LIBDCP_J2K_ERRORS_H
+
+
+#include <boost/optional.hpp>
+#include <mutex>
+#include <string>
+
+
+namespace dcp {
+
+
+/** @class J2KErrors
+ *  @brief Errors reported by openjpeg while encoding or decoding one frame.
+ *
+ *  These are collected rather than thrown from openjpeg's error callback, as openjpeg
+ *  may call it from one of its own threads, and exceptions must not pass through its C code.
+ */
+class J2KErrors
+{
+public:
+	void add (char const* message)
+	{
+		std::lock_guard<std::mutex> lm (_mutex);
+		if (!_first) {
+			_first = std::string (message);
+		}
+	}
+
+	/** @return the first error that was reported, if there was one */
+	boost::optional<std::string> first () const
+	{
+		std::lock_guard<std::mutex> lm (_mutex);
+		return _first;
+	}
+
+private:
+	mutable std::mutex _mutex;
+	boost::optional<std::string> _first;
+};
+
+
+/** Error handler to give to opj_set_error_handler() with a J2KErrors as its data */
+inline void
+j2k_error_callback (char const* message, void* data)
+{
+	reinterpret_cast<J2KErrors*>(data)->add (message);
+}
+
+
+}
+
+
+#endif
@@ -56,14 +56,16 @@ class OpenJPEGImage;
  *       1 reduces by (2^1 == 2), ie halving the size of the image.
  *  This is useful for scaling 4K DCP images down to 2K.
  *  @return OpenJPEGImage
+ *
+ *  J2KDecoder offers more control, and can decode batches of frames on several threads.
  */
 extern std::shared_ptr<OpenJPEGImage> decompress_j2k (uint8_t const * data, int64_t size, int reduce);
 
 extern std::shared_ptr<OpenJPEGImage> decompress_j2k (Data const& data, int reduce);
 extern std::shared_ptr<OpenJPEGImage> decompress_j2k (std::shared_ptr<const Data> data, int reduce);
 
-/** @xyz Picture to compress.  Parts of xyz's data WILL BE OVERWRITTEN by libopenjpeg so xyz cannot be re-used
- *  after this call; see opj_j2k_encode where if l_reuse_data is false it will set l_tilec->data = l_img_comp->data.
+/** @xyz Picture to compress.  With openjpeg 1, parts of xyz's data WILL BE OVERWRITTEN so xyz cannot be
+ *  re-used after this call.  J2KEncoder is a better choice for encoding many frames.
  */
 extern ArrayData compress_j2k (std::shared_ptr<const OpenJPEGImage>, int bandwith, int frames_per_second, bool threed, bool fourk, std::string comment = "libdcp");
 
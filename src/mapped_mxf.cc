@@ -0,0 +1,339 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/mapped_mxf.cc
+ *  @brief MappedMXF class
+ */
+
+
+#include "compose.hpp"
+#include "dcp_assert.h"
+#include "exceptions.h"
+#include "mapped_mxf.h"
+#include "mxf_stream.h"
+#include "stereo_picture_asset.h"
+#include <asdcp/AS_DCP.h>
+#include <boost/optional.hpp>
+#ifdef LIBDCP_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include <climits>
+
+
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+using namespace dcp;
+
+
+/** Length of a KLV key */
+static size_t const key_length = 16;
+/** Length of the fixed part of a partition pack's value, up to and including BodySID (SMPTE 377-1 7.1) */
+static uint64_t const partition_pack_length = 64;
+
+
+/** @return true if `key' is the KLV key of a header, body or footer partition pack */
+static bool
+is_partition_pack_key (uint8_t const * key)
+{
+	return key[0] == 0x06 && key[1] == 0x0e && key[2] == 0x2b && key[3] == 0x34 &&
+		key[4] == 0x02 && key[5] == 0x05 && key[6] == 0x01 && key[7] == 0x01 &&
+		key[8] == 0x0d && key[9] == 0x01 && key[10] == 0x02 && key[11] == 0x01 && key[12] == 0x01 &&
+		key[13] >= 0x02 && key[13] <= 0x04;
+}
+
+
+/** @return true if `key' is the KLV key of filler */
+static bool
+is_fill_key (uint8_t const * key)
+{
+	return key[0] == 0x06 && key[1] == 0x0e && key[2] == 0x2b && key[3] == 0x34 &&
+		key[4] == 0x01 && key[5] == 0x01 && key[6] == 0x01 &&
+		key[8] == 0x03 && key[9] == 0x01 && key[10] == 0x02 && key[11] == 0x10 && key[12] == 0x01;
+}
+
+
+static uint64_t
+big_endian (uint8_t const * data, int bytes)
+{
+	uint64_t value = 0;
+	for (int i = 0; i < bytes; ++i) {
+		value = (value << 8) | data[i];
+	}
+	return value;
+}
+
+
+/** A file mapped privately (copy-on-write) into memory */
+class MappedMXF::Mapping
+{
+public:
+	explicit Mapping (boost::filesystem::path file)
+	{
+		_size = boost::filesystem::file_size (file);
+		/* Check that the size fits in a size_t, which it may not on a 32-bit system */
+		if (_size == 0 || static_cast<uint64_t>(static_cast<size_t>(_size)) != _size) {
+			boost::throw_exception (FileError("could not map file", file, 0));
+		}
+
+#ifdef LIBDCP_WINDOWS
+		auto handle = CreateFileW (file.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (handle == INVALID_HANDLE_VALUE) {
+			boost::throw_exception (FileError("could not open file for mapping", file, GetLastError()));
+		}
+		auto mapping = CreateFileMapping (handle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+		CloseHandle (handle);
+		if (!mapping) {
+			boost::throw_exception (FileError("could not map file", file, GetLastError()));
+		}
+		_data = reinterpret_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0));
+		CloseHandle (mapping);
+		if (!_data) {
+			boost::throw_exception (FileError("could not map file", file, GetLastError()));
+		}
+#else
+		auto fd = open (file.c_str(), O_RDONLY);
+		if (fd == -1) {
+			boost::throw_exception (FileError("could not open file for mapping", file, errno));
+		}
+		auto data = mmap (nullptr, _size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		auto const error = errno;
+		close (fd);
+		if (data == MAP_FAILED) {
+			boost::throw_exception (FileError("could not map file", file, error));
+		}
+		_data = reinterpret_cast<uint8_t*>(data);
+#endif
+	}
+
+	~Mapping ()
+	{
+#ifdef LIBDCP_WINDOWS
+		UnmapViewOfFile (_data);
+#else
+		munmap (_data, _size);
+#endif
+	}
+
+	Mapping (Mapping const&) = delete;
+	Mapping& operator= (Mapping const&) = delete;
+
+	uint8_t* data () const {
+		return _data;
+	}
+
+	uint64_t size () const {
+		return _size;
+	}
+
+private:
+	uint8_t* _data = nullptr;
+	uint64_t _size = 0;
+};
+
+
+/** A view of some data owned by something else */
+class DataView : public Data
+{
+public:
+	DataView (shared_ptr<void> owner, uint8_t* data, int size)
+		: _owner (owner)
+		, _data (data)
+		, _size (size)
+	{}
+
+	uint8_t const * data () const override {
+		return _data;
+	}
+
+	uint8_t * data () override {
+		return _data;
+	}
+
+	int size () const override {
+		return _size;
+	}
+
+private:
+	shared_ptr<void> _owner;
+	uint8_t* _data;
+	int _size;
+};
+
+
+/** @return the position of each frame in the essence container, according to the MXF index table */
+template <class R>
+static vector<Kumu::fpos_t>
+stream_offsets (boost::filesystem::path file, int frames)
+{
+	R reader;
+	auto r = reader.OpenRead (file.string().c_str());
+	if (ASDCP_FAILURE(r)) {
+		boost::throw_exception (MXFFileError("could not open MXF file for reading", file.string(), r));
+	}
+
+	vector<Kumu::fpos_t> offsets;
+	for (int i = 0; i < frames; ++i) {
+		Kumu::fpos_t offset = 0;
+		i8_t temporal_offset = 0;
+		i8_t key_frame_offset = 0;
+		if (ASDCP_FAILURE(reader.LocateFrame(i, offset, temporal_offset, key_frame_offset))) {
+			boost::throw_exception (ReadError(String::compose("could not find video frame %1 in MXF index", i)));
+		}
+		offsets.push_back (offset);
+	}
+
+	return offsets;
+}
+
+
+MappedMXF::MappedMXF (PictureAsset const* asset)
+	: _stereo (dynamic_cast<StereoPictureAsset const*>(asset))
+{
+	DCP_ASSERT (asset->file());
+	DCP_ASSERT (!asset->encrypted());
+
+	_file = asset->file().get();
+	_mapping = make_shared<Mapping>(_file);
+
+	auto const frames = asset->intrinsic_duration();
+	auto const offsets = _stereo ?
+		stream_offsets<ASDCP::JP2K::MXFSReader>(_file, frames) :
+		stream_offsets<ASDCP::JP2K::MXFReader>(_file, frames);
+
+	auto const data = _mapping->data();
+	auto const size = _mapping->size();
+
+	auto bad = [this]() {
+		boost::throw_exception (ReadError(String::compose("unexpected KLV packet in MXF file %1", _file.string())));
+	};
+
+	/* Read the KLV packet at `position', returning the position of its value and setting up length */
+	auto klv = [data, size, bad](uint64_t position, uint64_t& length) {
+		if (position + key_length + 1 > size) {
+			bad ();
+		}
+		length = data[position + key_length];
+		position += key_length + 1;
+		if (length & 0x80) {
+			auto const length_bytes = length & 0x7f;
+			if (length_bytes == 0 || length_bytes > 8 || position + length_bytes > size) {
+				bad ();
+			}
+			length = 0;
+			for (uint64_t i = 0; i < length_bytes; ++i) {
+				length = (length << 8) | data[position++];
+			}
+		}
+		if (length > size - position) {
+			bad ();
+		}
+		return position;
+	};
+
+	/* Index table offsets are relative to the start of the essence container.  Find that from
+	 * the partition packs: the essence of the first partition which has a body follows the
+	 * partition's header metadata and index, and starts at the stream offset given by its BodyOffset.
+	 */
+	uint64_t position = 0;
+	uint64_t length = 0;
+	boost::optional<uint64_t> essence_start;
+	while (!essence_start) {
+		auto const value = klv (position, length);
+		if (!is_partition_pack_key(data + position) || length < partition_pack_length) {
+			bad ();
+		}
+
+		auto const header_bytes = big_endian (data + value + 32, 8);
+		auto const index_bytes = big_endian (data + value + 40, 8);
+		auto const body_offset = big_endian (data + value + 52, 8);
+		auto const body_sid = big_endian (data + value + 60, 4);
+
+		/* The header byte count includes any filler after the partition pack */
+		position = value + length;
+		if (header_bytes > size - position || index_bytes > size - position - header_bytes) {
+			bad ();
+		}
+		position += header_bytes + index_bytes;
+
+		/* but a writer may have put more filler before the essence */
+		while (position + key_length + 1 <= size && is_fill_key(data + position)) {
+			auto const fill = klv (position, length);
+			position = fill + length;
+		}
+
+		if (body_sid != 0) {
+			if (body_offset > position) {
+				bad ();
+			}
+			essence_start = position - body_offset;
+		}
+	}
+
+	for (auto offset: offsets) {
+		position = *essence_start + offset;
+		for (int eye = 0; eye < (_stereo ? 2 : 1); ++eye) {
+			auto const value = klv (position, length);
+			if (!is_essence_key(data + position) || length > INT_MAX) {
+				bad ();
+			}
+			_extents.push_back ({value, static_cast<int>(length)});
+			position = value + length;
+		}
+	}
+}
+
+
+int
+MappedMXF::frames () const
+{
+	return _stereo ? _extents.size() / 2 : _extents.size();
+}
+
+
+shared_ptr<const Data>
+MappedMXF::get_frame (int n, Eye eye) const
+{
+	if (n < 0 || n >= frames()) {
+		boost::throw_exception (ReadError(String::compose("could not read video frame %1 of %2", n, frames())));
+	}
+
+	auto const& extent = _extents[_stereo ? (n * 2 + (eye == Eye::LEFT ? 0 : 1)) : n];
+	return make_shared<DataView>(_mapping, _mapping->data() + extent.offset, extent.size);
+}
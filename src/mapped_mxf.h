@@ -0,0 +1,103 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/mapped_mxf.h
+ *  @brief MappedMXF class
+ */
+
+
+#ifndef LIBDCP_MAPPED_MXF_H
+#define LIBDCP_MAPPED_MXF_H
+
+
+#include "data.h"
+#include "types.h"
+#include <boost/filesystem.hpp>
+#include <memory>
+#include <vector>
+
+
+namespace dcp {
+
+
+class PictureAsset;
+
+
+/** @class MappedMXF
+ *  @brief Access to the frames of an unencrypted picture asset by mapping its file into memory.
+ *
+ *  The position of each frame is found from the MXF index table when the object is made, and
+ *  frames are then returned as views straight into the mapping, so getting a frame involves
+ *  no reading or copying.  Unlike an AssetReader, frames may be got from many threads at once.
+ */
+class MappedMXF
+{
+public:
+	/** @param asset Unencrypted mono or stereo picture asset */
+	explicit MappedMXF (PictureAsset const* asset);
+
+	MappedMXF (MappedMXF const&) = delete;
+	MappedMXF& operator= (MappedMXF const&) = delete;
+
+	int frames () const;
+
+	/** @param n Frame index, not taking EntryPoint into account.
+	 *  @param eye Eye to get for a stereo asset; ignored for mono assets.
+	 *  @return J2K data of the frame, which remains valid for as long as the returned object
+	 *  exists.  The data may be modified without affecting the file.
+	 */
+	std::shared_ptr<const Data> get_frame (int n, Eye eye = Eye::LEFT) const;
+
+private:
+	class Mapping;
+
+	struct Extent
+	{
+		uint64_t offset;
+		int size;
+	};
+
+	boost::filesystem::path _file;
+	std::shared_ptr<Mapping> _mapping;
+	bool _stereo = false;
+	/** Position of each frame's J2K data in the file; two per frame (left then right) for stereo assets */
+	std::vector<Extent> _extents;
+};
+
+
+}
+
+
+#endif
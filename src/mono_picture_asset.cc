@@ -42,6 +42,7 @@
 #include "mono_picture_asset_reader.h"
 #include "exceptions.h"
 #include "dcp_assert.h"
+#include "mapped_mxf.h"
 #include "mono_picture_frame.h"
 #include "compose.hpp"
 #include <asdcp/AS_DCP.h>
@@ -139,40 +140,74 @@ MonoPictureAsset::equals (shared_ptr<const Asset> other, EqualityOptions opt, No
 
 	bool result = true;
 
-	auto reader = start_read ();
-	auto other_reader = other_picture->start_read ();
+	/* Unencrypted assets can be compared straight from their files without reading or copying each frame */
+	shared_ptr<MappedMXF> mapped;
+	shared_ptr<MappedMXF> other_mapped;
+	if (!encrypted() && !other_picture->encrypted()) {
+		try {
+			mapped = make_shared<MappedMXF>(this);
+			other_mapped = make_shared<MappedMXF>(other_picture.get());
+		} catch (std::exception&) {
+			/* The files could not be mapped, or are laid out in a way that MappedMXF does not
+			 * understand, so read the frames with AssetReaders instead.
+			 */
+			mapped.reset ();
+			other_mapped.reset ();
+		}
+	}
 
 #ifdef LIBDCP_OPENMP
-#pragma omp parallel for
+#pragma omp parallel
 #endif
-
-	for (int i = 0; i < _intrinsic_duration; ++i) {
-		if (i >= other_picture->intrinsic_duration()) {
-			result = false;
+	{
+		/* Readers can only be used by one thread at a time, so each thread has its own; as each
+		 * reader has its own decryption context, encrypted frames are then decrypted in parallel.
+		 */
+		shared_ptr<MonoPictureAssetReader> reader;
+		shared_ptr<MonoPictureAssetReader> other_reader;
+		if (!mapped) {
+			reader = start_read ();
+			other_reader = other_picture->start_read ();
 		}
 
-		if (result || opt.keep_going) {
+#ifdef LIBDCP_OPENMP
+#pragma omp for
+#endif
+		for (int i = 0; i < _intrinsic_duration; ++i) {
+			if (i >= other_picture->intrinsic_duration()) {
+				result = false;
+			}
+
+			if (result || opt.keep_going) {
 
-			auto frame_A = reader->get_frame (i);
-			auto frame_B = other_reader->get_frame (i);
+				shared_ptr<const Data> frame_A;
+				shared_ptr<const Data> frame_B;
+				if (mapped) {
+					frame_A = mapped->get_frame (i);
+					frame_B = other_mapped->get_frame (i);
+				} else {
+					frame_A = reader->get_frame (i);
+					frame_B = other_reader->get_frame (i);
+				}
 
-			list<pair<NoteType, string>> notes;
+				list<pair<NoteType, string>> notes;
 
-			if (!frame_buffer_equals (
-				    i, opt, bind (&storing_note_handler, boost::ref(notes), _1, _2),
-				    frame_A->data(), frame_A->size(),
-				    frame_B->data(), frame_B->size()
-				    )) {
-				result = false;
-			}
+				if (!frame_buffer_equals (
+					    i, opt, bind (&storing_note_handler, boost::ref(notes), _1, _2),
+					    frame_A->data(), frame_A->size(),
+					    frame_B->data(), frame_B->size()
+					    )) {
+					result = false;
+				}
 
 #ifdef LIBDCP_OPENMP
 #pragma omp critical
 #endif
-			{
-				note (NoteType::PROGRESS, String::compose("Compared video frame %1 of %2", i, _intrinsic_duration));
-				for (auto const& i: notes) {
-					note (i.first, i.second);
+				{
+					note (NoteType::PROGRESS, String::compose("Compared video frame %1 of %2", i, _intrinsic_duration));
+					for (auto const& i: notes) {
+						note (i.first, i.second);
+					}
 				}
 			}
 		}
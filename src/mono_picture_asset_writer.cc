@@ -91,14 +91,13 @@ MonoPictureAssetWriter::write (uint8_t const * data, int size)
 		start (data, size);
 	}
 
- 	if (ASDCP_FAILURE (_state->j2k_parser.OpenReadFrame(data, size, _state->frame_buffer))) {
- 		boost::throw_exception (MiscError ("could not parse J2K frame"));
- 	}
+	ASDCP::JP2K::FrameBuffer frame;
+	wrap_j2k_frame (data, size, _state->picture_descriptor, frame);
 
 	uint64_t const before_offset = _state->mxf_writer.Tell ();
 
 	string hash;
-	auto const r = _state->mxf_writer.WriteFrame (_state->frame_buffer, _crypto_context->context(), _crypto_context->hmac(), &hash);
+	auto const r = _state->mxf_writer.WriteFrame (frame, _crypto_context->context(), _crypto_context->hmac(), &hash);
 	if (ASDCP_FAILURE(r)) {
 		boost::throw_exception (MXFFileError ("error in writing video MXF", _file.string(), r));
 	}
@@ -123,9 +122,18 @@ MonoPictureAssetWriter::fake_write (int size)
 }
 
 
+MonoPictureAssetWriter::~MonoPictureAssetWriter ()
+{
+	/* Our queued writes use our members, so stop them before those are destroyed */
+	stop_write_behind ();
+}
+
+
 bool
 MonoPictureAssetWriter::finalize ()
 {
+	flush_write_behind ();
+
 	if (_started) {
 		auto r = _state->mxf_writer.Finalize();
 		if (ASDCP_FAILURE(r)) {
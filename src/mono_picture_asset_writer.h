@@ -64,6 +64,8 @@ namespace dcp {
 class MonoPictureAssetWriter : public PictureAssetWriter
 {
 public:
+	~MonoPictureAssetWriter ();
+
 	FrameInfo write (uint8_t const *, int) override;
 	void fake_write (int size) override;
 	bool finalize () override;
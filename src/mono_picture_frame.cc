@@ -41,6 +41,7 @@
 #include "compose.hpp"
 #include "crypto_context.h"
 #include "exceptions.h"
+#include "frame.h"
 #include "j2k_transcode.h"
 #include "mono_picture_frame.h"
 #include "rgb_xyz.h"
@@ -84,10 +85,19 @@ MonoPictureFrame::MonoPictureFrame (boost::filesystem::path path)
  */
 MonoPictureFrame::MonoPictureFrame (ASDCP::JP2K::MXFReader* reader, int n, shared_ptr<DecryptionContext> c, bool check_hmac)
 {
-	/* XXX: unfortunate guesswork on this buffer size */
-	_buffer = make_shared<ASDCP::JP2K::FrameBuffer>(4 * Kumu::Megabyte);
+	/* read() will size the buffer from the index; this is enough for any frame which meets the DCI
+	 * bit rate limit, for when the index cannot say.
+	 */
+	_buffer_size = 4 * Kumu::Megabyte;
+	read (reader, n, c, check_hmac);
+}
+
 
-	auto const r = reader->ReadFrame (n, *_buffer, c->context(), check_hmac ? c->hmac() : nullptr);
+/** Read another frame into this object, re-using its buffer where possible */
+void
+MonoPictureFrame::read (ASDCP::JP2K::MXFReader* reader, int n, shared_ptr<DecryptionContext> c, bool check_hmac)
+{
+	auto const r = read_frame (reader, n, _buffer, _buffer_size, c, check_hmac);
 
 	if (ASDCP_FAILURE(r)) {
 		boost::throw_exception (ReadError(String::compose ("could not read video frame %1 (%2)", n, static_cast<int>(r))));
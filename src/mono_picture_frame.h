@@ -103,7 +103,11 @@ private:
 
 	MonoPictureFrame (ASDCP::JP2K::MXFReader* reader, int n, std::shared_ptr<DecryptionContext>, bool check_hmac);
 
+	void read (ASDCP::JP2K::MXFReader* reader, int n, std::shared_ptr<DecryptionContext>, bool check_hmac);
+
 	std::shared_ptr<ASDCP::JP2K::FrameBuffer> _buffer;
+	/** Capacity of _buffer when it is used to read frames from an MXF */
+	int _buffer_size = 0;
 };
 
 }
@@ -0,0 +1,212 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/mxf_stream.cc
+ *  @brief MXFStream class
+ */
+
+
+#include "compose.hpp"
+#include "exceptions.h"
+#include "mxf_stream.h"
+#include <asdcp/KM_util.h>
+#include <asdcp/AS_DCP.h>
+#include <climits>
+#include <cstring>
+
+
+using std::make_shared;
+using std::min;
+using std::shared_ptr;
+using std::string;
+using namespace dcp;
+
+
+/** Size of the chunks that we read the file in */
+static size_t const chunk_size = 4 * Kumu::Megabyte;
+
+/** Length of a KLV key */
+static size_t const key_length = 16;
+
+
+MXFStream::MXFStream (boost::filesystem::path file)
+	: _file (file)
+	, _buffer (chunk_size)
+{
+	auto r = _reader.OpenRead (file.string().c_str());
+	if (ASDCP_FAILURE(r)) {
+		boost::throw_exception (FileError("could not open MXF file", file, r));
+	}
+
+	_size = _reader.Size ();
+
+	SHA1_Init (&_sha);
+}
+
+
+/** Make sure that there are at least `bytes' unused bytes in the buffer, reading
+ *  (and hashing) more of the file if necessary.
+ *  @return false if the file ends before there are that many bytes available.
+ */
+bool
+MXFStream::fill (size_t bytes)
+{
+	while (_end - _start < bytes) {
+		if (_eof) {
+			return false;
+		}
+
+		if (_start > 0) {
+			memmove (_buffer.data(), _buffer.data() + _start, _end - _start);
+			_end -= _start;
+			_start = 0;
+		}
+
+		if (_buffer.size() - _end < chunk_size) {
+			_buffer.resize (_end + chunk_size);
+		}
+
+		ui32_t read = 0;
+		auto r = _reader.Read (_buffer.data() + _end, chunk_size, &read);
+		if (r == Kumu::RESULT_ENDOFFILE) {
+			_eof = true;
+		} else if (ASDCP_FAILURE(r)) {
+			boost::throw_exception (FileError("could not read MXF file", _file, r));
+		}
+
+		SHA1_Update (&_sha, _buffer.data() + _end, read);
+		_end += read;
+		_read += read;
+	}
+
+	return true;
+}
+
+
+/** Move past `bytes' bytes of the file */
+void
+MXFStream::skip (uint64_t bytes)
+{
+	while (bytes > 0) {
+		if (_start == _end && !fill(1)) {
+			boost::throw_exception (ReadError(String::compose("unexpected end of MXF file %1", _file.string())));
+		}
+		auto const N = min(static_cast<uint64_t>(_end - _start), bytes);
+		_start += N;
+		bytes -= N;
+	}
+}
+
+
+shared_ptr<const ArrayData>
+MXFStream::next_essence ()
+{
+	/* The whole file is a sequence of KLV packets; look for the next one whose key is a
+	 * generic container essence element (SMPTE 379M) and skip everything else.
+	 */
+	while (fill(key_length + 1)) {
+		bool const essence = is_essence_key (_buffer.data() + _start);
+
+		/* BER-encoded length */
+		size_t header_length = key_length + 1;
+		uint64_t length = _buffer[_start + key_length];
+		if (length & 0x80) {
+			auto const length_bytes = length & 0x7f;
+			if (length_bytes == 0 || length_bytes > 8) {
+				boost::throw_exception (ReadError(String::compose("bad KLV length in MXF file %1", _file.string())));
+			}
+			header_length += length_bytes;
+			if (!fill(header_length)) {
+				boost::throw_exception (ReadError(String::compose("unexpected end of MXF file %1", _file.string())));
+			}
+			length = 0;
+			for (size_t i = 0; i < length_bytes; ++i) {
+				length = (length << 8) | _buffer[_start + key_length + 1 + i];
+			}
+		}
+
+		_start += header_length;
+
+		/* Bytes of the file after the header that we have just read */
+		auto const remaining = _size - (_read - (_end - _start));
+		if (length > remaining || (essence && length > INT_MAX)) {
+			boost::throw_exception (ReadError(String::compose("bad KLV length in MXF file %1", _file.string())));
+		}
+
+		if (!essence) {
+			skip (length);
+			continue;
+		}
+
+		auto data = make_shared<ArrayData>(static_cast<int>(length));
+		size_t done = 0;
+		while (done < length) {
+			if (_start == _end && !fill(1)) {
+				boost::throw_exception (ReadError(String::compose("unexpected end of MXF file %1", _file.string())));
+			}
+			auto const N = min(static_cast<size_t>(_end - _start), static_cast<size_t>(length - done));
+			memcpy (data->data() + done, _buffer.data() + _start, N);
+			_start += N;
+			done += N;
+		}
+		return data;
+	}
+
+	return {};
+}
+
+
+string
+MXFStream::digest ()
+{
+	while (fill(_end - _start + 1)) {
+		_start = _end;
+	}
+
+	byte_t byte_buffer[SHA_DIGEST_LENGTH];
+	SHA1_Final (byte_buffer, &_sha);
+
+	char digest[64];
+	return Kumu::base64encode (byte_buffer, SHA_DIGEST_LENGTH, digest, 64);
+}
+
+
+bool
+dcp::is_essence_key (uint8_t const * key)
+{
+	return key[0] == 0x06 && key[1] == 0x0e && key[2] == 0x2b && key[3] == 0x34 &&
+		key[4] == 0x01 && key[5] == 0x02 &&
+		key[8] == 0x0d && key[9] == 0x01 && key[10] == 0x03 && key[11] == 0x01;
+}
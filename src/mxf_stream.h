@@ -0,0 +1,106 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/mxf_stream.h
+ *  @brief MXFStream class
+ */
+
+
+#ifndef LIBDCP_MXF_STREAM_H
+#define LIBDCP_MXF_STREAM_H
+
+
+#include "array_data.h"
+#include <asdcp/KM_fileio.h>
+#include <openssl/sha.h>
+#include <boost/filesystem.hpp>
+#include <memory>
+#include <vector>
+
+
+namespace dcp {
+
+
+/** @class MXFStream
+ *  @brief A reader which goes through an MXF file from start to finish, returning its plaintext essence
+ *  elements one by one and calculating a digest of the whole file as it goes.
+ *
+ *  This means that an asset's hash can be checked and its frames examined with only one read of the file.
+ *  Encrypted essence is not returned.
+ */
+class MXFStream
+{
+public:
+	explicit MXFStream (boost::filesystem::path file);
+
+	MXFStream (MXFStream const&) = delete;
+	MXFStream& operator= (MXFStream const&) = delete;
+
+	/** @return the next essence element in the file, or nullptr if there are no more */
+	std::shared_ptr<const ArrayData> next_essence ();
+
+	/** Read the remainder of the file, if any, and return the digest of all of it
+	 *  in the same form as make_digest().
+	 */
+	std::string digest ();
+
+private:
+	bool fill (size_t bytes);
+	void skip (uint64_t bytes);
+
+	boost::filesystem::path _file;
+	Kumu::FileReader _reader;
+	/** Size of the file in bytes */
+	uint64_t _size = 0;
+	SHA_CTX _sha;
+	std::vector<uint8_t> _buffer;
+	/** Offset of the first unused byte in _buffer */
+	size_t _start = 0;
+	/** Offset of the byte after the last valid one in _buffer */
+	size_t _end = 0;
+	bool _eof = false;
+	/** Total number of bytes read from the file so far */
+	uint64_t _read = 0;
+};
+
+
+/** @return true if `key' is the 16-byte KLV key of a generic container essence element (SMPTE 379M) */
+extern bool is_essence_key (uint8_t const * key);
+
+
+}
+
+
+#endif
@@ -51,6 +51,7 @@ struct write_smpte_subtitle_test;
 struct write_smpte_subtitle_test2;
 struct write_smpte_subtitle_test3;
 struct sync_test2;
+struct sound_asset_writer_avx2_test;
 
 
 namespace dcp {
@@ -87,6 +88,7 @@ protected:
 	friend struct ::write_smpte_subtitle_test2;
 	friend struct ::write_smpte_subtitle_test3;
 	friend struct ::sync_test2;
+	friend struct ::sound_asset_writer_avx2_test;
 
 	std::string _id;
 };
@@ -0,0 +1,123 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/pcm_avx2.cc
+ *  @brief AVX2 version of the conversion of float samples to 24-bit PCM.
+ *
+ *  This converts eight samples at a time using the same clip, multiply and truncation as the
+ *  scalar code, so the results are bit-identical.
+ */
+
+
+#include "pcm_avx2.h"
+#include <atomic>
+#include <cstring>
+#if defined(__x86_64__) && defined(__GNUC__)
+#define LIBDCP_AVX2
+#include <immintrin.h>
+#endif
+
+
+static std::atomic<bool> avx2_allowed (true);
+
+
+bool
+dcp::pcm_avx2 ()
+{
+#ifdef LIBDCP_AVX2
+	static bool const supported = __builtin_cpu_supports ("avx2");
+	return supported && avx2_allowed;
+#else
+	return false;
+#endif
+}
+
+
+void
+dcp::set_pcm_avx2 (bool allowed)
+{
+	avx2_allowed = allowed;
+}
+
+
+#ifdef LIBDCP_AVX2
+
+
+__attribute__((target("avx2")))
+int
+dcp::float_to_pcm24_avx2 (float const * in, int count, uint8_t* out)
+{
+	float const clip = 1.0f - 1.0f / (1 << 23);
+	auto const top = _mm256_set1_ps (clip);
+	auto const bottom = _mm256_set1_ps (-clip);
+	auto const scale = _mm256_set1_ps (1 << 23);
+	/* Take the low three bytes of each of four 32-bit values in each 128-bit lane */
+	auto const pack = _mm256_setr_epi8 (
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1
+		);
+
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		/* The sample is the second operand of min so that, like the scalar comparisons, NaN passes through */
+		auto x = _mm256_max_ps (bottom, _mm256_min_ps(top, _mm256_loadu_ps(in + i)));
+		auto const s = _mm256_shuffle_epi8 (_mm256_cvttps_epi32(_mm256_mul_ps(x, scale)), pack);
+
+		auto const low = _mm256_castsi256_si128 (s);
+		auto const high = _mm256_extracti128_si256 (s, 1);
+		auto o = out + i * 3;
+		_mm_storel_epi64 (reinterpret_cast<__m128i*>(o), low);
+		int32_t const low_rest = _mm_extract_epi32 (low, 2);
+		memcpy (o + 8, &low_rest, 4);
+		_mm_storel_epi64 (reinterpret_cast<__m128i*>(o + 12), high);
+		int32_t const high_rest = _mm_extract_epi32 (high, 2);
+		memcpy (o + 20, &high_rest, 4);
+	}
+
+	return i;
+}
+
+
+#else
+
+
+int
+dcp::float_to_pcm24_avx2 (float const *, int, uint8_t*)
+{
+	return 0;
+}
+
+
+#endif
@@ -0,0 +1,71 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/pcm_avx2.h
+ *  @brief AVX2 version of the conversion of float samples to 24-bit PCM.
+ */
+
+
+#ifndef LIBDCP_PCM_AVX2_H
+#define LIBDCP_PCM_AVX2_H
+
+
+#include <stdint.h>
+
+
+namespace dcp {
+
+
+/** @return true if the AVX2 PCM conversion is built in, supported by this CPU, and has not been disabled */
+extern bool pcm_avx2 ();
+
+/** Allow or prevent use of the AVX2 PCM conversion; it is allowed by default */
+extern void set_pcm_avx2 (bool allowed);
+
+/** Convert float samples to packed little-endian 24-bit PCM, clipping them to +/-(1 - 2^-23),
+ *  giving results identical to those of the scalar code in SoundAssetWriter.  As many samples
+ *  as possible are converted from the start of `in'; the caller must convert the rest.
+ *  @param in Samples to convert.
+ *  @param count Number of samples in `in'.
+ *  @param out Buffer for 3 * count bytes of PCM.
+ *  @return Number of samples converted.
+ */
+extern int float_to_pcm24_avx2 (float const * in, int count, uint8_t* out);
+
+
+}
+
+
+#endif
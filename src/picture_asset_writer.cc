@@ -38,6 +38,8 @@
 
 
 #include "picture_asset_writer.h"
+#include "data.h"
+#include "dcp_assert.h"
 #include "exceptions.h"
 #include "picture_asset.h"
 #include <asdcp/KM_fileio.h>
@@ -48,6 +50,7 @@
 
 using std::string;
 using std::shared_ptr;
+using std::make_shared;
 using namespace dcp;
 
 
@@ -65,3 +68,49 @@ PictureAssetWriter::write (Data const& data)
 {
 	return write (data.data(), data.size());
 }
+
+
+std::future<FrameInfo>
+PictureAssetWriter::write_async (shared_ptr<const Data> data)
+{
+	/* Check arguments here, so that a mistake is found by the caller rather than on the write-behind thread */
+	DCP_ASSERT (!_finalized);
+	DCP_ASSERT (data && data->size() > 0);
+
+	auto promise = make_shared<std::promise<FrameInfo>>();
+	auto future = promise->get_future ();
+
+	if (!writing_behind()) {
+		try {
+			promise->set_value (write(data->data(), data->size()));
+		} catch (...) {
+			promise->set_exception (std::current_exception());
+		}
+		return future;
+	}
+
+	write_behind ([this, data, promise]() {
+		try {
+			promise->set_value (write(data->data(), data->size()));
+		} catch (...) {
+			promise->set_exception (std::current_exception());
+			throw;
+		}
+	});
+	return future;
+}
+
+
+void
+PictureAssetWriter::write_async (shared_ptr<const Data> data, std::function<void (FrameInfo)> written)
+{
+	DCP_ASSERT (!_finalized);
+	DCP_ASSERT (data && data->size() > 0);
+
+	write_behind ([this, data, written]() {
+		auto info = write (data->data(), data->size());
+		if (written) {
+			written (info);
+		}
+	});
+}
@@ -45,6 +45,8 @@
 #include "metadata.h"
 #include "types.h"
 #include <boost/utility.hpp>
+#include <functional>
+#include <future>
 #include <memory>
 #include <stdint.h>
 #include <string>
@@ -87,6 +89,29 @@ public:
 
 	FrameInfo write (Data const& data);
 
+	/** Start writing frames given to write_async() on a background thread; see AssetWriter::set_write_behind.
+	 *  If the asset is encrypted the frames are also encrypted and HMAC'd on that thread, since
+	 *  asdcplib does this as it writes each frame.
+	 *  write() and fake_write() must not be called while any write_async() frames are still queued.
+	 */
+	using AssetWriter::set_write_behind;
+
+	/** Queue a frame to be written on the write-behind thread, or write it now if
+	 *  set_write_behind() has not been called.  If a previously-queued frame could
+	 *  not be written its error will be thrown from here (or from finalize()).
+	 *  @param data JPEG2000 codestream to write.
+	 *  @return Future FrameInfo of the frame; if this frame cannot be written the future
+	 *  will throw its error.  This is the case whether or not the write was done straight away.
+	 */
+	std::future<FrameInfo> write_async (std::shared_ptr<const Data> data);
+
+	/** As the other write_async() but calling a function (on the write-behind thread)
+	 *  with the frame's FrameInfo once it has been written.  If set_write_behind() has not
+	 *  been called the frame is written, and the function called, before this returns,
+	 *  and any error in writing is thrown from here.
+	 */
+	void write_async (std::shared_ptr<const Data> data, std::function<void (FrameInfo)> written);
+
 protected:
 	template <class P, class Q>
 	friend void start (PictureAssetWriter *, std::shared_ptr<P>, Q *, uint8_t const *, int);
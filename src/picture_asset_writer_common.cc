@@ -45,17 +45,65 @@ namespace dcp {
 
 struct ASDCPStateBase
 {
-	ASDCPStateBase ()
-		: frame_buffer (4 * Kumu::Megabyte)
-	{}
-
 	ASDCP::JP2K::CodestreamParser j2k_parser;
-	ASDCP::JP2K::FrameBuffer frame_buffer;
 	ASDCP::WriterInfo writer_info;
 	ASDCP::JP2K::PictureDescriptor picture_descriptor;
 };
 
 
+/** Make a frame buffer refer to some J2K data, rather than copying the data into it as
+ *  JP2K::CodestreamParser::OpenReadFrame() would.  start() has already parsed the header of
+ *  the first frame, so here we just check that the data starts with SOC and SIZ markers and
+ *  that the image size in the SIZ segment is the same as that of the first frame.
+ *  As OpenReadFrame() does, we also set the frame's plaintext offset to the start of the
+ *  first tile's data, so that the headers are left unencrypted in encrypted assets.
+ *  The data must stay valid until the frame buffer has been written.
+ */
+static void
+wrap_j2k_frame (uint8_t const * data, int size, ASDCP::JP2K::PictureDescriptor const& descriptor, ASDCP::JP2K::FrameBuffer& buffer)
+{
+	auto get_16 = [data](int offset) {
+		return (uint32_t(data[offset]) << 8) | uint32_t(data[offset + 1]);
+	};
+
+	auto get_32 = [data](int offset) {
+		return (uint32_t(data[offset]) << 24) | (uint32_t(data[offset + 1]) << 16) | (uint32_t(data[offset + 2]) << 8) | uint32_t(data[offset + 3]);
+	};
+
+	/* SOC, then SIZ, Lsiz, Rsiz, Xsiz, Ysiz, ... */
+	if (
+		size < 16 ||
+		data[0] != 0xff || data[1] != 0x4f ||
+		data[2] != 0xff || data[3] != 0x51 ||
+		get_32(8) != descriptor.StoredWidth ||
+		get_32(12) != descriptor.StoredHeight
+	   ) {
+		boost::throw_exception (MiscError ("could not parse J2K frame"));
+	}
+
+	/* Skip the marker segments after SOC, which all have lengths, until we reach SOD */
+	int position = 2;
+	while (true) {
+		if (position + 2 > size || data[position] != 0xff) {
+			boost::throw_exception (MiscError ("could not parse J2K frame"));
+		}
+		if (data[position + 1] == 0x93) {
+			position += 2;
+			break;
+		}
+		if (position + 4 > size) {
+			boost::throw_exception (MiscError ("could not parse J2K frame"));
+		}
+		position += 2 + get_16(position + 2);
+	}
+
+	/* asdcplib only reads from the buffer when writing it */
+	buffer.SetData (const_cast<uint8_t*>(data), size);
+	buffer.Size (size);
+	buffer.PlaintextOffset (position);
+}
+
+
 }
 
 
@@ -64,7 +112,11 @@ void dcp::start (PictureAssetWriter* writer, shared_ptr<P> state, Q* asset, uint
 {
 	asset->set_file (writer->_file);
 
-	if (ASDCP_FAILURE (state->j2k_parser.OpenReadFrame(data, size, state->frame_buffer))) {
+	/* Parse the whole of the first frame to get the picture descriptor; later frames are
+	 * written straight from the caller's data (see wrap_j2k_frame()).
+	 */
+	ASDCP::JP2K::FrameBuffer first_frame (size);
+	if (ASDCP_FAILURE (state->j2k_parser.OpenReadFrame(data, size, first_frame))) {
 		boost::throw_exception (MiscError ("could not parse J2K frame"));
 	}
 
@@ -0,0 +1,258 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/picture_preview.cc
+ *  @brief PicturePreview class
+ */
+
+
+#include "compose.hpp"
+#include "dcp_assert.h"
+#include "mapped_mxf.h"
+#include "mono_picture_asset.h"
+#include "mono_picture_asset_reader.h"
+#include "mono_picture_frame.h"
+#include "openjpeg_image.h"
+#include "picture_preview.h"
+#include "rgb_xyz.h"
+#include "stereo_picture_asset.h"
+#include "stereo_picture_asset_reader.h"
+#include "stereo_picture_frame.h"
+#include "util.h"
+#include <climits>
+#include <cstdio>
+#include <mutex>
+
+
+using std::dynamic_pointer_cast;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using boost::optional;
+using namespace dcp;
+
+
+/** Where the J2K data of frames comes from: a mapping of the file if the asset is unencrypted
+ *  and can be mapped, otherwise a reader (which decrypts, if necessary).
+ */
+class PicturePreview::Source
+{
+public:
+	explicit Source (shared_ptr<const PictureAsset> asset)
+	{
+		if (!asset->encrypted()) {
+			try {
+				_mapped = make_shared<MappedMXF>(asset.get());
+				return;
+			} catch (std::exception&) {
+				/* The file could not be mapped, or is laid out in a way that MappedMXF does
+				 * not understand, so read it with a reader instead.
+				 */
+			}
+		}
+
+		if (auto mono = dynamic_pointer_cast<const MonoPictureAsset>(asset)) {
+			_mono = mono->start_read ();
+		} else if (auto stereo = dynamic_pointer_cast<const StereoPictureAsset>(asset)) {
+			_stereo = stereo->start_read ();
+		} else {
+			DCP_ASSERT (false);
+		}
+	}
+
+	shared_ptr<const Data> get (int64_t frame, Eye eye)
+	{
+		if (_mapped) {
+			return _mapped->get_frame (frame, eye);
+		}
+
+		std::lock_guard<std::mutex> lm (_mutex);
+		if (_mono) {
+			return _mono->get_frame (frame);
+		}
+
+		auto both = _stereo->get_frame (frame);
+		if (eye == Eye::LEFT) {
+			return both->left ();
+		}
+		return both->right ();
+	}
+
+private:
+	shared_ptr<MappedMXF> _mapped;
+	/** mutex to serialise use of the readers */
+	std::mutex _mutex;
+	shared_ptr<MonoPictureAssetReader> _mono;
+	shared_ptr<StereoPictureAssetReader> _stereo;
+};
+
+
+PicturePreview::PicturePreview (
+	shared_ptr<const PictureAsset> asset,
+	int reduce,
+	optional<boost::filesystem::path> cache_directory,
+	ColourConversion const& conversion
+	)
+	: _asset (asset)
+	, _stereo (static_cast<bool>(dynamic_pointer_cast<const StereoPictureAsset>(asset)))
+	, _cache_directory (cache_directory)
+	, _conversion (conversion)
+	, _decoder (reduce)
+	, _source (make_shared<Source>(asset))
+{
+	/* Previews are small enough that the first quality layer is plenty */
+	_decoder.set_layers (1);
+}
+
+
+optional<boost::filesystem::path>
+PicturePreview::cache_file (int64_t frame, Eye eye) const
+{
+	if (!_cache_directory) {
+		return {};
+	}
+
+	string eye_name;
+	if (_stereo) {
+		eye_name = eye == Eye::LEFT ? "_left" : "_right";
+	}
+
+	return *_cache_directory / _asset->id() / String::compose("%1%2_reduce%3.ppm", frame, eye_name, _decoder.reduce());
+}
+
+
+/** @param maximum Largest size that the preview can be; anything bigger means that the file is not a preview
+ *  that we wrote.
+ */
+static optional<PicturePreview::Image>
+read_ppm (boost::filesystem::path file, Size maximum)
+{
+	auto f = fopen_boost (file, "rb");
+	if (!f) {
+		return {};
+	}
+
+	int width = 0;
+	int height = 0;
+	int max_value = 0;
+	/* The header ends with a single whitespace character, which fgetc skips */
+	if (
+		fscanf(f, "P6 %d %d %d", &width, &height, &max_value) != 3 ||
+		width <= 0 || height <= 0 || width > maximum.width || height > maximum.height ||
+		max_value != 255 || fgetc(f) == EOF
+	   ) {
+		fclose (f);
+		return {};
+	}
+
+	auto const bytes = static_cast<int64_t>(width) * height * 3;
+	if (bytes > INT_MAX) {
+		fclose (f);
+		return {};
+	}
+
+	PicturePreview::Image image = { Size(width, height), ArrayData(static_cast<int>(bytes)) };
+	auto const ok = fread (image.rgb.data(), image.rgb.size(), 1, f) == 1;
+	fclose (f);
+	if (!ok) {
+		return {};
+	}
+
+	return image;
+}
+
+
+/** Write a preview to a file.  This is done via a temporary file so that a partly-written preview is
+ *  never seen, and failure is ignored as the preview can always be made again.
+ */
+static void
+write_ppm (boost::filesystem::path file, PicturePreview::Image const& image)
+{
+	boost::system::error_code ec;
+	boost::filesystem::create_directories (file.parent_path(), ec);
+
+	auto tmp = file;
+	tmp += boost::filesystem::unique_path (".%%%%-%%%%-%%%%.tmp");
+
+	auto f = fopen_boost (tmp, "wb");
+	if (!f) {
+		return;
+	}
+
+	auto ok = fprintf (f, "P6\n%d %d\n255\n", image.size.width, image.size.height) > 0;
+	ok = ok && fwrite (image.rgb.data(), image.rgb.size(), 1, f) == 1;
+	ok = fclose (f) == 0 && ok;
+
+	if (ok) {
+		boost::filesystem::rename (tmp, file, ec);
+	}
+
+	if (!ok || ec) {
+		boost::filesystem::remove (tmp, ec);
+	}
+}
+
+
+PicturePreview::Image
+PicturePreview::make (int64_t frame, Eye eye) const
+{
+	auto j2k = _source->get (frame, eye);
+	auto xyz = _decoder.decode (*j2k);
+	auto const size = xyz->size ();
+	Image image = { size, ArrayData(size.width * size.height * 3) };
+	xyz_to_rgb_fast (xyz, _conversion, image.rgb.data(), size.width * 3);
+	return image;
+}
+
+
+PicturePreview::Image
+PicturePreview::get (int64_t frame, Eye eye) const
+{
+	auto file = cache_file (frame, eye);
+	if (file) {
+		/* Decoding at reduced resolution rounds sizes, so a preview may be up to this size */
+		auto const factor = 1 << _decoder.reduce();
+		auto const full = _asset->size();
+		if (auto cached = read_ppm(*file, Size((full.width + factor - 1) / factor, (full.height + factor - 1) / factor))) {
+			return *cached;
+		}
+	}
+
+	auto image = make (frame, eye);
+	if (file) {
+		write_ppm (*file, image);
+	}
+	return image;
+}
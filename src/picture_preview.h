@@ -0,0 +1,123 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/picture_preview.h
+ *  @brief PicturePreview class
+ */
+
+
+#ifndef LIBDCP_PICTURE_PREVIEW_H
+#define LIBDCP_PICTURE_PREVIEW_H
+
+
+#include "array_data.h"
+#include "colour_conversion.h"
+#include "compiled_colour_conversion.h"
+#include "j2k_decoder.h"
+#include "types.h"
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <memory>
+
+
+namespace dcp {
+
+
+class PictureAsset;
+
+
+/** @class PicturePreview
+ *  @brief A maker of small RGB previews of the frames of a picture asset, for scrubbing through it.
+ *
+ *  Frames are decoded at reduced resolution, using only the first quality layer, and converted to
+ *  RGB with xyz_to_rgb_fast().  Previews can also be kept in a directory so that each one is only
+ *  made once; they are stored as binary PPM files in a sub-directory named after the asset's ID.
+ *  The conversion that was used is not recorded, so each directory should only be used with one
+ *  conversion.
+ */
+class PicturePreview
+{
+public:
+	/** @param asset Picture asset; if it is encrypted it must have a key.
+	 *  @param reduce Power of 2 by which to reduce the size of frames, e.g. 2 to make previews which
+	 *  are a quarter of the width and height of the asset.
+	 *  @param cache_directory Directory to keep previews in, or none.
+	 *  @param conversion Conversion to use from XYZ to RGB.
+	 */
+	PicturePreview (
+		std::shared_ptr<const PictureAsset> asset,
+		int reduce = 2,
+		boost::optional<boost::filesystem::path> cache_directory = boost::optional<boost::filesystem::path>(),
+		ColourConversion const& conversion = ColourConversion::srgb_to_xyz()
+		);
+
+	PicturePreview (PicturePreview const&) = delete;
+	PicturePreview& operator= (PicturePreview const&) = delete;
+
+	struct Image
+	{
+		Size size;
+		/** Packed RGB 8:8:8 data with a stride of size.width * 3 bytes */
+		ArrayData rgb;
+	};
+
+	/** Get the preview of a frame, from the cache if it is there; otherwise it is made, and added
+	 *  to the cache.  This may be called from several threads at the same time.
+	 *  @param frame Frame index, not taking EntryPoint into account.
+	 *  @param eye Eye to get for a stereo asset; ignored for mono assets.
+	 */
+	Image get (int64_t frame, Eye eye = Eye::LEFT) const;
+
+	/** @return the file that the preview of a frame is kept in, if there is a cache directory */
+	boost::optional<boost::filesystem::path> cache_file (int64_t frame, Eye eye = Eye::LEFT) const;
+
+private:
+	class Source;
+
+	Image make (int64_t frame, Eye eye) const;
+
+	std::shared_ptr<const PictureAsset> _asset;
+	bool _stereo;
+	boost::optional<boost::filesystem::path> _cache_directory;
+	CompiledColourConversion _conversion;
+	J2KDecoder _decoder;
+	std::shared_ptr<Source> _source;
+};
+
+
+}
+
+
+#endif
@@ -38,12 +38,20 @@
 
 
 #include "colour_conversion.h"
+#include "compiled_colour_conversion.h"
 #include "compose.hpp"
 #include "dcp_assert.h"
 #include "openjpeg_image.h"
 #include "rgb_xyz.h"
+#include "rgb_xyz_avx2.h"
 #include "transfer_function.h"
+#include <boost/function.hpp>
 #include <cmath>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <numeric>
+#include <thread>
 
 
 using std::cout;
@@ -51,6 +59,8 @@ using std::make_shared;
 using std::max;
 using std::min;
 using std::shared_ptr;
+using std::vector;
+using boost::function;
 using boost::optional;
 using namespace dcp;
 
@@ -58,6 +68,75 @@ using namespace dcp;
 static auto constexpr DCI_COEFFICIENT = 48.0 / 52.37;
 
 
+/** Call a function for each of a set of bands of rows.
+ *  @param executor Executor to run the bands on, or empty to run up to `bands' of them at once
+ *  on threads made for this call.
+ *  @param rows Function taking the band index, the first row of the band and the row after its last.
+ */
+static void
+for_each_band (int height, Executor executor, int bands, function<void (int, int, int)> rows)
+{
+	bands = max (1, min (bands, height));
+	if (bands == 1 && !executor) {
+		rows (0, 0, height);
+		return;
+	}
+
+	std::mutex mutex;
+	std::condition_variable done;
+	int remaining = bands;
+	std::exception_ptr error;
+
+	auto band = [&rows, &mutex, &done, &remaining, &error, height, bands](int i) {
+		try {
+			rows (i, height * i / bands, height * (i + 1) / bands);
+		} catch (...) {
+			std::unique_lock<std::mutex> lock (mutex);
+			if (!error) {
+				error = std::current_exception ();
+			}
+		}
+		std::unique_lock<std::mutex> lock (mutex);
+		--remaining;
+		done.notify_all ();
+	};
+
+	if (executor) {
+		for (int i = 0; i < bands; ++i) {
+			try {
+				executor ([&band, i]() { band (i); });
+			} catch (...) {
+				/* Bands which have already been handed over refer to our locals, so
+				 * they must finish before we can give up.
+				 */
+				std::unique_lock<std::mutex> lock (mutex);
+				if (!error) {
+					error = std::current_exception ();
+				}
+				remaining -= bands - i;
+				break;
+			}
+		}
+		std::unique_lock<std::mutex> lock (mutex);
+		while (remaining > 0) {
+			done.wait (lock);
+		}
+	} else {
+		vector<std::thread> workers;
+		for (int i = 0; i < bands; ++i) {
+			workers.push_back (std::thread(band, i));
+		}
+		for (auto& i: workers) {
+			i.join ();
+		}
+	}
+
+	if (error) {
+		std::rethrow_exception (error);
+	}
+}
+
+
 void
 dcp::xyz_to_rgba (
 	std::shared_ptr<const OpenJPEGImage> xyz_image,
@@ -66,72 +145,129 @@ dcp::xyz_to_rgba (
 	int stride
 	)
 {
-	int const max_colour = pow (2, 16) - 1;
+	xyz_to_rgba (xyz_image, conversion, argb, stride, 1);
+}
 
-	struct {
-		double x, y, z;
-	} s;
 
-	struct {
-		double r, g, b;
-	} d;
+void
+dcp::xyz_to_rgba (
+	std::shared_ptr<const OpenJPEGImage> xyz_image,
+	ColourConversion const & conversion,
+	uint8_t* argb,
+	int stride,
+	int threads
+	)
+{
+	xyz_to_rgba (xyz_image, CompiledColourConversion(conversion), argb, stride, threads);
+}
 
-	int* xyz_x = xyz_image->data (0);
-	int* xyz_y = xyz_image->data (1);
-	int* xyz_z = xyz_image->data (2);
 
-	double const * lut_in = conversion.out()->lut (12, false);
-	double const * lut_out = conversion.in()->lut (16, true);
-	boost::numeric::ublas::matrix<double> const matrix = conversion.xyz_to_rgb ();
+void
+dcp::xyz_to_rgba (
+	std::shared_ptr<const OpenJPEGImage> xyz_image,
+	CompiledColourConversion const & conversion,
+	uint8_t* argb,
+	int stride,
+	int threads
+	)
+{
+	xyz_to_rgba (xyz_image, conversion, argb, stride, Executor(), threads);
+}
+
 
-	double fast_matrix[9] = {
-		matrix (0, 0), matrix (0, 1), matrix (0, 2),
-		matrix (1, 0), matrix (1, 1), matrix (1, 2),
-		matrix (2, 0), matrix (2, 1), matrix (2, 2)
-	};
+void
+dcp::xyz_to_rgba (
+	std::shared_ptr<const OpenJPEGImage> xyz_image,
+	CompiledColourConversion const & conversion,
+	uint8_t* argb,
+	int stride,
+	Executor executor,
+	int bands
+	)
+{
+	int const max_colour = pow (2, 16) - 1;
+
+	auto const lut_in = conversion.xyz_to_rgb_lut_in ();
+	auto const lut_out = conversion.xyz_to_rgb_lut_out ();
+	auto const fast_matrix = conversion.xyz_to_rgb_matrix ();
 
 	int const height = xyz_image->size().height;
 	int const width = xyz_image->size().width;
 
-	for (int y = 0; y < height; ++y) {
-		uint8_t* argb_line = argb;
-		for (int x = 0; x < width; ++x) {
+	bool const avx2 = rgb_xyz_avx2 ();
+
+	for_each_band (height, executor, bands, [&](int, int y_start, int y_end) {
+		struct {
+			double x, y, z;
+		} s;
+
+		struct {
+			double r, g, b;
+		} d;
+
+		int* xyz_x = xyz_image->data(0) + y_start * width;
+		int* xyz_y = xyz_image->data(1) + y_start * width;
+		int* xyz_z = xyz_image->data(2) + y_start * width;
+
+		for (int y = y_start; y < y_end; ++y) {
+			uint8_t* argb_line = argb + y * stride;
+			int x = 0;
+			if (avx2) {
+				x = xyz_to_rgba_avx2 (xyz_x, xyz_y, xyz_z, width, lut_in, lut_out, fast_matrix, DCI_COEFFICIENT, argb_line);
+				xyz_x += x;
+				xyz_y += x;
+				xyz_z += x;
+				argb_line += x * 4;
+			}
+			for (; x < width; ++x) {
 
-			DCP_ASSERT (*xyz_x >= 0 && *xyz_y >= 0 && *xyz_z >= 0 && *xyz_x < 4096 && *xyz_y < 4096 && *xyz_z < 4096);
+				DCP_ASSERT (*xyz_x >= 0 && *xyz_y >= 0 && *xyz_z >= 0 && *xyz_x < 4096 && *xyz_y < 4096 && *xyz_z < 4096);
 
-			/* In gamma LUT */
-			s.x = lut_in[*xyz_x++];
-			s.y = lut_in[*xyz_y++];
-			s.z = lut_in[*xyz_z++];
+				/* In gamma LUT */
+				s.x = lut_in[*xyz_x++];
+				s.y = lut_in[*xyz_y++];
+				s.z = lut_in[*xyz_z++];
 
-			/* DCI companding */
-			s.x /= DCI_COEFFICIENT;
-			s.y /= DCI_COEFFICIENT;
-			s.z /= DCI_COEFFICIENT;
+				/* DCI companding */
+				s.x /= DCI_COEFFICIENT;
+				s.y /= DCI_COEFFICIENT;
+				s.z /= DCI_COEFFICIENT;
 
-			/* XYZ to RGB */
-			d.r = ((s.x * fast_matrix[0]) + (s.y * fast_matrix[1]) + (s.z * fast_matrix[2]));
-			d.g = ((s.x * fast_matrix[3]) + (s.y * fast_matrix[4]) + (s.z * fast_matrix[5]));
-			d.b = ((s.x * fast_matrix[6]) + (s.y * fast_matrix[7]) + (s.z * fast_matrix[8]));
+				/* XYZ to RGB */
+				d.r = ((s.x * fast_matrix[0]) + (s.y * fast_matrix[1]) + (s.z * fast_matrix[2]));
+				d.g = ((s.x * fast_matrix[3]) + (s.y * fast_matrix[4]) + (s.z * fast_matrix[5]));
+				d.b = ((s.x * fast_matrix[6]) + (s.y * fast_matrix[7]) + (s.z * fast_matrix[8]));
 
-			d.r = min (d.r, 1.0);
-			d.r = max (d.r, 0.0);
+				d.r = min (d.r, 1.0);
+				d.r = max (d.r, 0.0);
 
-			d.g = min (d.g, 1.0);
-			d.g = max (d.g, 0.0);
+				d.g = min (d.g, 1.0);
+				d.g = max (d.g, 0.0);
 
-			d.b = min (d.b, 1.0);
-			d.b = max (d.b, 0.0);
+				d.b = min (d.b, 1.0);
+				d.b = max (d.b, 0.0);
 
-			/* Out gamma LUT */
-			*argb_line++ = lut_out[lrint(d.b * max_colour)] * 0xff;
-			*argb_line++ = lut_out[lrint(d.g * max_colour)] * 0xff;
-			*argb_line++ = lut_out[lrint(d.r * max_colour)] * 0xff;
-			*argb_line++ = 0xff;
+				/* Out gamma LUT */
+				*argb_line++ = lut_out[lrint(d.b * max_colour)] * 0xff;
+				*argb_line++ = lut_out[lrint(d.g * max_colour)] * 0xff;
+				*argb_line++ = lut_out[lrint(d.r * max_colour)] * 0xff;
+				*argb_line++ = 0xff;
+			}
 		}
+	});
+}
 
-		argb += stride;
-	}
+
+void
+dcp::xyz_to_rgb (
+	shared_ptr<const OpenJPEGImage> xyz_image,
+	ColourConversion const & conversion,
+	uint8_t* rgb,
+	int stride,
+	optional<NoteHandler> note
+	)
+{
+	xyz_to_rgb (xyz_image, conversion, rgb, stride, 1, note);
 }
 
 
@@ -141,95 +277,202 @@ dcp::xyz_to_rgb (
 	ColourConversion const & conversion,
 	uint8_t* rgb,
 	int stride,
+	int threads,
 	optional<NoteHandler> note
 	)
 {
-	struct {
-		double x, y, z;
-	} s;
-
-	struct {
-		double r, g, b;
-	} d;
-
-	/* These should be 12-bit values from 0-4095 */
-	int* xyz_x = xyz_image->data (0);
-	int* xyz_y = xyz_image->data (1);
-	int* xyz_z = xyz_image->data (2);
-
-	double const * lut_in = conversion.out()->lut (12, false);
-	double const * lut_out = conversion.in()->lut (16, true);
-	auto const matrix = conversion.xyz_to_rgb ();
-
-	double fast_matrix[9] = {
-		matrix (0, 0), matrix (0, 1), matrix (0, 2),
-		matrix (1, 0), matrix (1, 1), matrix (1, 2),
-		matrix (2, 0), matrix (2, 1), matrix (2, 2)
-	};
+	xyz_to_rgb (xyz_image, CompiledColourConversion(conversion), rgb, stride, threads, note);
+}
+
+
+void
+dcp::xyz_to_rgb (
+	shared_ptr<const OpenJPEGImage> xyz_image,
+	CompiledColourConversion const & conversion,
+	uint8_t* rgb,
+	int stride,
+	int threads,
+	optional<NoteHandler> note
+	)
+{
+	xyz_to_rgb (xyz_image, conversion, rgb, stride, Executor(), threads, note);
+}
+
+
+void
+dcp::xyz_to_rgb (
+	shared_ptr<const OpenJPEGImage> xyz_image,
+	CompiledColourConversion const & conversion,
+	uint8_t* rgb,
+	int stride,
+	Executor executor,
+	int bands,
+	optional<NoteHandler> note
+	)
+{
+	auto const lut_in = conversion.xyz_to_rgb_lut_in ();
+	auto const lut_out = conversion.xyz_to_rgb_lut_out ();
+	auto const fast_matrix = conversion.xyz_to_rgb_matrix ();
 
 	int const height = xyz_image->size().height;
 	int const width = xyz_image->size().width;
 
-	for (int y = 0; y < height; ++y) {
-		auto rgb_line = reinterpret_cast<uint16_t*> (rgb + y * stride);
-		for (int x = 0; x < width; ++x) {
+	bool const avx2 = rgb_xyz_avx2 ();
+
+	/* Out-of-range values found in each band, so that they can be reported in order
+	 * on this thread once all the bands are done.
+	 */
+	vector<vector<int>> out_of_range (max(1, bands));
+
+	for_each_band (height, executor, bands, [&](int band, int y_start, int y_end) {
+		struct {
+			double x, y, z;
+		} s;
+
+		struct {
+			double r, g, b;
+		} d;
+
+		/* These should be 12-bit values from 0-4095 */
+		int* xyz_x = xyz_image->data(0) + y_start * width;
+		int* xyz_y = xyz_image->data(1) + y_start * width;
+		int* xyz_z = xyz_image->data(2) + y_start * width;
+
+		auto& bad = out_of_range[band];
+
+		for (int y = y_start; y < y_end; ++y) {
+			auto rgb_line = reinterpret_cast<uint16_t*> (rgb + y * stride);
+			int x = 0;
+			if (avx2) {
+				x = xyz_to_rgb_avx2 (xyz_x, xyz_y, xyz_z, width, lut_in, lut_out, fast_matrix, DCI_COEFFICIENT, rgb_line);
+				xyz_x += x;
+				xyz_y += x;
+				xyz_z += x;
+				rgb_line += x * 3;
+			}
+			for (; x < width; ++x) {
 
-			int cx = *xyz_x++;
-			int cy = *xyz_y++;
-			int cz = *xyz_z++;
+				int cx = *xyz_x++;
+				int cy = *xyz_y++;
+				int cz = *xyz_z++;
 
-			if (cx < 0 || cx > 4095) {
-				if (note) {
-					note.get()(NoteType::NOTE, String::compose("XYZ value %1 out of range", cx));
+				if (cx < 0 || cx > 4095) {
+					bad.push_back (cx);
+					cx = max (min (cx, 4095), 0);
 				}
-				cx = max (min (cx, 4095), 0);
-			}
 
-			if (cy < 0 || cy > 4095) {
-				if (note) {
-					note.get()(NoteType::NOTE, String::compose("XYZ value %1 out of range", cy));
+				if (cy < 0 || cy > 4095) {
+					bad.push_back (cy);
+					cy = max (min (cy, 4095), 0);
 				}
-				cy = max (min (cy, 4095), 0);
-			}
 
-			if (cz < 0 || cz > 4095) {
-				if (note) {
-					note.get()(NoteType::NOTE, String::compose("XYZ value %1 out of range", cz));
+				if (cz < 0 || cz > 4095) {
+					bad.push_back (cz);
+					cz = max (min (cz, 4095), 0);
 				}
-				cz = max (min (cz, 4095), 0);
+
+				/* In gamma LUT */
+				s.x = lut_in[cx];
+				s.y = lut_in[cy];
+				s.z = lut_in[cz];
+
+				/* DCI companding */
+				s.x /= DCI_COEFFICIENT;
+				s.y /= DCI_COEFFICIENT;
+				s.z /= DCI_COEFFICIENT;
+
+				/* XYZ to RGB */
+				d.r = ((s.x * fast_matrix[0]) + (s.y * fast_matrix[1]) + (s.z * fast_matrix[2]));
+				d.g = ((s.x * fast_matrix[3]) + (s.y * fast_matrix[4]) + (s.z * fast_matrix[5]));
+				d.b = ((s.x * fast_matrix[6]) + (s.y * fast_matrix[7]) + (s.z * fast_matrix[8]));
+
+				d.r = min (d.r, 1.0);
+				d.r = max (d.r, 0.0);
+
+				d.g = min (d.g, 1.0);
+				d.g = max (d.g, 0.0);
+
+				d.b = min (d.b, 1.0);
+				d.b = max (d.b, 0.0);
+
+				*rgb_line++ = lrint(lut_out[lrint(d.r * 65535)] * 65535);
+				*rgb_line++ = lrint(lut_out[lrint(d.g * 65535)] * 65535);
+				*rgb_line++ = lrint(lut_out[lrint(d.b * 65535)] * 65535);
+			}
+		}
+	});
+
+	if (note) {
+		for (auto const& i: out_of_range) {
+			for (auto j: i) {
+				note.get()(NoteType::NOTE, String::compose("XYZ value %1 out of range", j));
 			}
+		}
+	}
+}
+
+
+void
+dcp::xyz_to_rgb_fast (
+	shared_ptr<const OpenJPEGImage> xyz_image,
+	CompiledColourConversion const & conversion,
+	uint8_t* rgb,
+	int stride
+	)
+{
+	/* In gamma LUT with the DCI companding folded in */
+	float lut_in[4096];
+	for (int i = 0; i < 4096; ++i) {
+		lut_in[i] = conversion.xyz_to_rgb_lut_in()[i] / DCI_COEFFICIENT;
+	}
 
-			/* In gamma LUT */
-			s.x = lut_in[cx];
-			s.y = lut_in[cy];
-			s.z = lut_in[cz];
+	/* Out gamma LUT going straight to 8 bits, indexed with 12 bits rather than 16 */
+	int const out_max = 4095;
+	uint8_t lut_out[out_max + 1];
+	for (int i = 0; i <= out_max; ++i) {
+		lut_out[i] = conversion.xyz_to_rgb_lut_out()[lrint(i * 65535.0 / out_max)] * 0xff;
+	}
+
+	float matrix[9];
+	for (int i = 0; i < 9; ++i) {
+		matrix[i] = conversion.xyz_to_rgb_matrix()[i];
+	}
+
+	int const height = xyz_image->size().height;
+	int const width = xyz_image->size().width;
 
-			/* DCI companding */
-			s.x /= DCI_COEFFICIENT;
-			s.y /= DCI_COEFFICIENT;
-			s.z /= DCI_COEFFICIENT;
+	auto clamp = [](float v) {
+		return min (max (v, 0.0f), 1.0f);
+	};
 
-			/* XYZ to RGB */
-			d.r = ((s.x * fast_matrix[0]) + (s.y * fast_matrix[1]) + (s.z * fast_matrix[2]));
-			d.g = ((s.x * fast_matrix[3]) + (s.y * fast_matrix[4]) + (s.z * fast_matrix[5]));
-			d.b = ((s.x * fast_matrix[6]) + (s.y * fast_matrix[7]) + (s.z * fast_matrix[8]));
+	/* Out-of-range values (which should not happen) are clamped as xyz_to_rgb() does */
+	auto clamp_index = [](int v) {
+		return min (max (v, 0), 4095);
+	};
 
-			d.r = min (d.r, 1.0);
-			d.r = max (d.r, 0.0);
+	int const* xyz_x = xyz_image->data(0);
+	int const* xyz_y = xyz_image->data(1);
+	int const* xyz_z = xyz_image->data(2);
 
-			d.g = min (d.g, 1.0);
-			d.g = max (d.g, 0.0);
+	for (int y = 0; y < height; ++y) {
+		uint8_t* rgb_line = rgb + y * stride;
+		for (int x = 0; x < width; ++x) {
+			float const sx = lut_in[clamp_index(*xyz_x++)];
+			float const sy = lut_in[clamp_index(*xyz_y++)];
+			float const sz = lut_in[clamp_index(*xyz_z++)];
 
-			d.b = min (d.b, 1.0);
-			d.b = max (d.b, 0.0);
+			float const r = clamp (sx * matrix[0] + sy * matrix[1] + sz * matrix[2]);
+			float const g = clamp (sx * matrix[3] + sy * matrix[4] + sz * matrix[5]);
+			float const b = clamp (sx * matrix[6] + sy * matrix[7] + sz * matrix[8]);
 
-			*rgb_line++ = lrint(lut_out[lrint(d.r * 65535)] * 65535);
-			*rgb_line++ = lrint(lut_out[lrint(d.g * 65535)] * 65535);
-			*rgb_line++ = lrint(lut_out[lrint(d.b * 65535)] * 65535);
+			*rgb_line++ = lut_out[static_cast<int>(r * out_max + 0.5f)];
+			*rgb_line++ = lut_out[static_cast<int>(g * out_max + 0.5f)];
+			*rgb_line++ = lut_out[static_cast<int>(b * out_max + 0.5f)];
 		}
 	}
 }
 
+
 void
 dcp::combined_rgb_to_xyz (ColourConversion const & conversion, double* matrix)
 {
@@ -266,63 +509,124 @@ dcp::rgb_to_xyz (
 	optional<NoteHandler> note
 	)
 {
-	auto xyz = make_shared<OpenJPEGImage>(size);
+	return rgb_to_xyz (rgb, size, stride, conversion, 1, note);
+}
 
-	struct {
-		double r, g, b;
-	} s;
 
-	struct {
-		double x, y, z;
-	} d;
+shared_ptr<dcp::OpenJPEGImage>
+dcp::rgb_to_xyz (
+	uint8_t const * rgb,
+	dcp::Size size,
+	int stride,
+	ColourConversion const & conversion,
+	int threads,
+	optional<NoteHandler> note
+	)
+{
+	return rgb_to_xyz (rgb, size, stride, CompiledColourConversion(conversion), threads, note);
+}
+
+
+shared_ptr<dcp::OpenJPEGImage>
+dcp::rgb_to_xyz (
+	uint8_t const * rgb,
+	dcp::Size size,
+	int stride,
+	CompiledColourConversion const & conversion,
+	int threads,
+	optional<NoteHandler> note
+	)
+{
+	return rgb_to_xyz (rgb, size, stride, conversion, Executor(), threads, note);
+}
 
-	auto const * lut_in = conversion.in()->lut (12, false);
-	auto const * lut_out = conversion.out()->lut (16, true);
 
+shared_ptr<dcp::OpenJPEGImage>
+dcp::rgb_to_xyz (
+	uint8_t const * rgb,
+	dcp::Size size,
+	int stride,
+	CompiledColourConversion const & conversion,
+	Executor executor,
+	int bands,
+	optional<NoteHandler> note
+	)
+{
+	auto xyz = make_shared<OpenJPEGImage>(size);
+
+	auto const lut_in = conversion.rgb_to_xyz_lut_in ();
+	auto const lut_out = conversion.rgb_to_xyz_lut_out ();
 	/* This is is the product of the RGB to XYZ matrix, the Bradford transform and the DCI companding */
-	double fast_matrix[9];
-	combined_rgb_to_xyz (conversion, fast_matrix);
-
-	int clamped = 0;
-	int* xyz_x = xyz->data (0);
-	int* xyz_y = xyz->data (1);
-	int* xyz_z = xyz->data (2);
-	for (int y = 0; y < size.height; ++y) {
-		auto p = reinterpret_cast<uint16_t const *> (rgb + y * stride);
-		for (int x = 0; x < size.width; ++x) {
-
-			/* In gamma LUT (converting 16-bit to 12-bit) */
-			s.r = lut_in[*p++ >> 4];
-			s.g = lut_in[*p++ >> 4];
-			s.b = lut_in[*p++ >> 4];
-
-			/* RGB to XYZ, Bradford transform and DCI companding */
-			d.x = s.r * fast_matrix[0] + s.g * fast_matrix[1] + s.b * fast_matrix[2];
-			d.y = s.r * fast_matrix[3] + s.g * fast_matrix[4] + s.b * fast_matrix[5];
-			d.z = s.r * fast_matrix[6] + s.g * fast_matrix[7] + s.b * fast_matrix[8];
-
-			/* Clamp */
-
-			if (d.x < 0 || d.y < 0 || d.z < 0 || d.x > 65535 || d.y > 65535 || d.z > 65535) {
-				++clamped;
+	auto const fast_matrix = conversion.rgb_to_xyz_matrix ();
+
+	bool const avx2 = rgb_xyz_avx2 ();
+
+	/* Number of clamped pixels in each band, each written once when its band is finished */
+	vector<int> clamped (max(1, bands));
+
+	for_each_band (size.height, executor, bands, [&](int band, int y_start, int y_end) {
+		int band_clamped = 0;
+
+		struct {
+			double r, g, b;
+		} s;
+
+		struct {
+			double x, y, z;
+		} d;
+
+		int* xyz_x = xyz->data(0) + y_start * size.width;
+		int* xyz_y = xyz->data(1) + y_start * size.width;
+		int* xyz_z = xyz->data(2) + y_start * size.width;
+
+		for (int y = y_start; y < y_end; ++y) {
+			auto p = reinterpret_cast<uint16_t const *> (rgb + y * stride);
+			int x = 0;
+			if (avx2) {
+				x = rgb_to_xyz_avx2 (p, size.width, lut_in, lut_out, fast_matrix, xyz_x, xyz_y, xyz_z, band_clamped);
+				p += x * 3;
+				xyz_x += x;
+				xyz_y += x;
+				xyz_z += x;
 			}
+			for (; x < size.width; ++x) {
+
+				/* In gamma LUT (converting 16-bit to 12-bit) */
+				s.r = lut_in[*p++ >> 4];
+				s.g = lut_in[*p++ >> 4];
+				s.b = lut_in[*p++ >> 4];
+
+				/* RGB to XYZ, Bradford transform and DCI companding */
+				d.x = s.r * fast_matrix[0] + s.g * fast_matrix[1] + s.b * fast_matrix[2];
+				d.y = s.r * fast_matrix[3] + s.g * fast_matrix[4] + s.b * fast_matrix[5];
+				d.z = s.r * fast_matrix[6] + s.g * fast_matrix[7] + s.b * fast_matrix[8];
+
+				/* Clamp */
 
-			d.x = max (0.0, d.x);
-			d.y = max (0.0, d.y);
-			d.z = max (0.0, d.z);
-			d.x = min (65535.0, d.x);
-			d.y = min (65535.0, d.y);
-			d.z = min (65535.0, d.z);
-
-			/* Out gamma LUT */
-			*xyz_x++ = lrint (lut_out[lrint(d.x)] * 4095);
-			*xyz_y++ = lrint (lut_out[lrint(d.y)] * 4095);
-			*xyz_z++ = lrint (lut_out[lrint(d.z)] * 4095);
+				if (d.x < 0 || d.y < 0 || d.z < 0 || d.x > 65535 || d.y > 65535 || d.z > 65535) {
+					++band_clamped;
+				}
+
+				d.x = max (0.0, d.x);
+				d.y = max (0.0, d.y);
+				d.z = max (0.0, d.z);
+				d.x = min (65535.0, d.x);
+				d.y = min (65535.0, d.y);
+				d.z = min (65535.0, d.z);
+
+				/* Out gamma LUT */
+				*xyz_x++ = lrint (lut_out[lrint(d.x)] * 4095);
+				*xyz_y++ = lrint (lut_out[lrint(d.y)] * 4095);
+				*xyz_z++ = lrint (lut_out[lrint(d.z)] * 4095);
+			}
 		}
-	}
 
-	if (clamped && note) {
-		note.get()(NoteType::NOTE, String::compose("%1 XYZ value(s) clamped", clamped));
+		clamped[band] = band_clamped;
+	});
+
+	auto const total_clamped = std::accumulate (clamped.begin(), clamped.end(), 0);
+	if (total_clamped && note) {
+		note.get()(NoteType::NOTE, String::compose("%1 XYZ value(s) clamped", total_clamped));
 	}
 
 	return xyz;
@@ -39,6 +39,7 @@
 
 #include "types.h"
 #include <memory>
+#include <boost/function.hpp>
 #include <boost/optional.hpp>
 #include <stdint.h>
 
@@ -49,6 +50,14 @@ namespace dcp {
 class OpenJPEGImage;
 class Image;
 class ColourConversion;
+class CompiledColourConversion;
+
+
+/** Something which runs tasks, perhaps on other threads (for example by posting them to a
+ *  thread pool).  It is given each task and must arrange for it to be run exactly once;
+ *  the conversion that gave it the tasks waits until they have all finished.
+ */
+typedef boost::function<void (boost::function<void ()>)> Executor;
 
 
 /** Convert an XYZ image to RGBA.
@@ -74,6 +83,43 @@ extern void xyz_to_rgba (
 	);
 
 
+/** As above, but splitting the image into bands of rows which are converted in parallel.
+ *  @param threads Number of threads to use.
+ */
+extern void xyz_to_rgba (
+	std::shared_ptr<const OpenJPEGImage>,
+	ColourConversion const & conversion,
+	uint8_t* rgba,
+	int stride,
+	int threads
+	);
+
+
+/** As above, using a conversion which has already been prepared */
+extern void xyz_to_rgba (
+	std::shared_ptr<const OpenJPEGImage>,
+	CompiledColourConversion const & conversion,
+	uint8_t* rgba,
+	int stride,
+	int threads = 1
+	);
+
+
+/** As above, but running the bands on a caller-supplied executor rather than on threads
+ *  which are made for this call.
+ *  @param executor Executor to run the bands.
+ *  @param bands Number of bands to split the image into.
+ */
+extern void xyz_to_rgba (
+	std::shared_ptr<const OpenJPEGImage>,
+	CompiledColourConversion const & conversion,
+	uint8_t* rgba,
+	int stride,
+	Executor executor,
+	int bands
+	);
+
+
 /** Convert an XYZ image to 48bpp RGB.
  *  @param xyz_image Frame in XYZ.
  *  @param conversion Colour conversion to use.
@@ -92,6 +138,63 @@ extern void xyz_to_rgb (
 	);
 
 
+/** As above, but splitting the image into bands of rows which are converted in parallel.
+ *  Any notes are given to the handler on the calling thread, in the same order as they
+ *  would be by the single-threaded version.
+ *  @param threads Number of threads to use.
+ */
+extern void xyz_to_rgb (
+	std::shared_ptr<const OpenJPEGImage>,
+	ColourConversion const & conversion,
+	uint8_t* rgb,
+	int stride,
+	int threads,
+	boost::optional<NoteHandler> note = boost::optional<NoteHandler> ()
+	);
+
+
+/** As above, using a conversion which has already been prepared */
+extern void xyz_to_rgb (
+	std::shared_ptr<const OpenJPEGImage>,
+	CompiledColourConversion const & conversion,
+	uint8_t* rgb,
+	int stride,
+	int threads = 1,
+	boost::optional<NoteHandler> note = boost::optional<NoteHandler> ()
+	);
+
+
+/** As above, but running the bands on a caller-supplied executor rather than on threads
+ *  which are made for this call.
+ *  @param executor Executor to run the bands.
+ *  @param bands Number of bands to split the image into.
+ */
+extern void xyz_to_rgb (
+	std::shared_ptr<const OpenJPEGImage>,
+	CompiledColourConversion const & conversion,
+	uint8_t* rgb,
+	int stride,
+	Executor executor,
+	int bands,
+	boost::optional<NoteHandler> note = boost::optional<NoteHandler> ()
+	);
+
+
+/** Convert an XYZ image to 24bpp RGB quickly, for previews.  This uses single-precision
+ *  arithmetic and a coarser output LUT than xyz_to_rgb(), so results may be a level or so
+ *  different from those that xyz_to_rgb() would give, and out-of-range values are clamped
+ *  without notes being made.
+ *  @param rgb Buffer to fill with packed RGB 8:8:8 data.
+ *  @param stride Stride for RGB data in bytes.
+ */
+extern void xyz_to_rgb_fast (
+	std::shared_ptr<const OpenJPEGImage>,
+	CompiledColourConversion const & conversion,
+	uint8_t* rgb,
+	int stride
+	);
+
+
 /** @param rgb RGB data; packed RGB 16:16:16, 48bpp, 16R, 16G, 16B,
  *  with the 2-byte value for each R/G/B component stored as
  *  little-endian; i.e. AV_PIX_FMT_RGB48LE.
@@ -107,6 +210,48 @@ extern std::shared_ptr<OpenJPEGImage> rgb_to_xyz (
 	);
 
 
+/** As above, but splitting the image into bands of rows which are converted in parallel.
+ *  Clamping is counted over the whole image and reported in a single note, as it is
+ *  by the single-threaded version.
+ *  @param threads Number of threads to use.
+ */
+extern std::shared_ptr<OpenJPEGImage> rgb_to_xyz (
+	uint8_t const * rgb,
+	dcp::Size size,
+	int stride,
+	ColourConversion const & conversion,
+	int threads,
+	boost::optional<NoteHandler> note = boost::optional<NoteHandler> ()
+	);
+
+
+/** As above, using a conversion which has already been prepared */
+extern std::shared_ptr<OpenJPEGImage> rgb_to_xyz (
+	uint8_t const * rgb,
+	dcp::Size size,
+	int stride,
+	CompiledColourConversion const & conversion,
+	int threads = 1,
+	boost::optional<NoteHandler> note = boost::optional<NoteHandler> ()
+	);
+
+
+/** As above, but running the bands on a caller-supplied executor rather than on threads
+ *  which are made for this call.
+ *  @param executor Executor to run the bands.
+ *  @param bands Number of bands to split the image into.
+ */
+extern std::shared_ptr<OpenJPEGImage> rgb_to_xyz (
+	uint8_t const * rgb,
+	dcp::Size size,
+	int stride,
+	CompiledColourConversion const & conversion,
+	Executor executor,
+	int bands,
+	boost::optional<NoteHandler> note = boost::optional<NoteHandler> ()
+	);
+
+
 /** @param conversion Colour conversion.
  *  @param matrix Filled in with the product of the RGB to XYZ matrix, the Bradford transform and the DCI companding.
  */
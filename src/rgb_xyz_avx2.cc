@@ -0,0 +1,299 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/rgb_xyz_avx2.cc
+ *  @brief AVX2 versions of the inner loops of the RGB/XYZ conversions.
+ *
+ *  These work on four pixels at a time in double precision, doing exactly the same operations
+ *  in the same order as the scalar code so that the results are bit-identical.  FMA is not
+ *  used as it would change the rounding.
+ */
+
+
+#include "rgb_xyz_avx2.h"
+#include <atomic>
+#if defined(__x86_64__) && defined(__GNUC__)
+#define LIBDCP_AVX2
+#include <immintrin.h>
+#endif
+
+
+static std::atomic<bool> avx2_allowed (true);
+
+
+bool
+dcp::rgb_xyz_avx2 ()
+{
+#ifdef LIBDCP_AVX2
+	static bool const supported = __builtin_cpu_supports ("avx2");
+	return supported && avx2_allowed;
+#else
+	return false;
+#endif
+}
+
+
+void
+dcp::set_rgb_xyz_avx2 (bool allowed)
+{
+	avx2_allowed = allowed;
+}
+
+
+#ifdef LIBDCP_AVX2
+
+
+/** @return a*m[0] + b*m[1] + c*m[2], evaluated left to right as the scalar code does */
+__attribute__((target("avx2")))
+static inline __m256d
+dot (__m256d a, __m256d b, __m256d c, __m256d const * m)
+{
+	return _mm256_add_pd (_mm256_add_pd(_mm256_mul_pd(a, m[0]), _mm256_mul_pd(b, m[1])), _mm256_mul_pd(c, m[2]));
+}
+
+
+/** @return true if any of four XYZ values is outside 0-4095 */
+__attribute__((target("avx2")))
+static inline bool
+out_of_range (__m128i x, __m128i y, __m128i z)
+{
+	auto const zero = _mm_setzero_si128 ();
+	auto const max = _mm_set1_epi32 (4095);
+	auto const bad = _mm_or_si128 (
+		_mm_or_si128(_mm_or_si128(_mm_cmplt_epi32(x, zero), _mm_cmplt_epi32(y, zero)), _mm_cmplt_epi32(z, zero)),
+		_mm_or_si128(_mm_or_si128(_mm_cmpgt_epi32(x, max), _mm_cmpgt_epi32(y, max)), _mm_cmpgt_epi32(z, max))
+		);
+	return !_mm_testz_si128 (bad, bad);
+}
+
+
+__attribute__((target("avx2")))
+int
+dcp::rgb_to_xyz_avx2 (
+	uint16_t const * rgb, int width, double const * lut_in, double const * lut_out, double const * matrix,
+	int* xyz_x, int* xyz_y, int* xyz_z, int& clamped
+	)
+{
+	auto const zero = _mm256_setzero_pd ();
+	auto const top = _mm256_set1_pd (65535);
+	auto const scale = _mm256_set1_pd (4095);
+
+	__m256d m[9];
+	for (int i = 0; i < 9; ++i) {
+		m[i] = _mm256_set1_pd (matrix[i]);
+	}
+
+	int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		auto const p = rgb + x * 3;
+
+		/* In gamma LUT (converting 16-bit to 12-bit) */
+		auto const r = _mm256_i32gather_pd (lut_in, _mm_setr_epi32(p[0] >> 4, p[3] >> 4, p[6] >> 4, p[9] >> 4), 8);
+		auto const g = _mm256_i32gather_pd (lut_in, _mm_setr_epi32(p[1] >> 4, p[4] >> 4, p[7] >> 4, p[10] >> 4), 8);
+		auto const b = _mm256_i32gather_pd (lut_in, _mm_setr_epi32(p[2] >> 4, p[5] >> 4, p[8] >> 4, p[11] >> 4), 8);
+
+		/* RGB to XYZ, Bradford transform and DCI companding */
+		auto dx = dot (r, g, b, m);
+		auto dy = dot (r, g, b, m + 3);
+		auto dz = dot (r, g, b, m + 6);
+
+		/* Clamp */
+		auto const out = _mm256_or_pd (
+			_mm256_or_pd(
+				_mm256_or_pd(_mm256_cmp_pd(dx, zero, _CMP_LT_OQ), _mm256_cmp_pd(dy, zero, _CMP_LT_OQ)),
+				_mm256_or_pd(_mm256_cmp_pd(dz, zero, _CMP_LT_OQ), _mm256_cmp_pd(dx, top, _CMP_GT_OQ))
+				),
+			_mm256_or_pd(_mm256_cmp_pd(dy, top, _CMP_GT_OQ), _mm256_cmp_pd(dz, top, _CMP_GT_OQ))
+			);
+		clamped += __builtin_popcount (_mm256_movemask_pd(out));
+
+		dx = _mm256_min_pd (_mm256_max_pd(dx, zero), top);
+		dy = _mm256_min_pd (_mm256_max_pd(dy, zero), top);
+		dz = _mm256_min_pd (_mm256_max_pd(dz, zero), top);
+
+		/* Out gamma LUT */
+		auto const ox = _mm256_i32gather_pd (lut_out, _mm256_cvtpd_epi32(dx), 8);
+		auto const oy = _mm256_i32gather_pd (lut_out, _mm256_cvtpd_epi32(dy), 8);
+		auto const oz = _mm256_i32gather_pd (lut_out, _mm256_cvtpd_epi32(dz), 8);
+		_mm_storeu_si128 (reinterpret_cast<__m128i*>(xyz_x + x), _mm256_cvtpd_epi32(_mm256_mul_pd(ox, scale)));
+		_mm_storeu_si128 (reinterpret_cast<__m128i*>(xyz_y + x), _mm256_cvtpd_epi32(_mm256_mul_pd(oy, scale)));
+		_mm_storeu_si128 (reinterpret_cast<__m128i*>(xyz_z + x), _mm256_cvtpd_epi32(_mm256_mul_pd(oz, scale)));
+	}
+
+	return x;
+}
+
+
+/** Convert four XYZ pixels to linear RGB, clamped to [0, 1] */
+__attribute__((target("avx2")))
+static inline void
+xyz_to_linear_rgb (
+	__m128i cx, __m128i cy, __m128i cz, double const * lut_in, __m256d const * m, __m256d dci_coefficient,
+	__m256d& r, __m256d& g, __m256d& b
+	)
+{
+	auto const zero = _mm256_setzero_pd ();
+	auto const one = _mm256_set1_pd (1);
+
+	/* In gamma LUT and DCI companding */
+	auto const sx = _mm256_div_pd (_mm256_i32gather_pd(lut_in, cx, 8), dci_coefficient);
+	auto const sy = _mm256_div_pd (_mm256_i32gather_pd(lut_in, cy, 8), dci_coefficient);
+	auto const sz = _mm256_div_pd (_mm256_i32gather_pd(lut_in, cz, 8), dci_coefficient);
+
+	/* XYZ to RGB */
+	r = _mm256_max_pd (_mm256_min_pd(dot(sx, sy, sz, m), one), zero);
+	g = _mm256_max_pd (_mm256_min_pd(dot(sx, sy, sz, m + 3), one), zero);
+	b = _mm256_max_pd (_mm256_min_pd(dot(sx, sy, sz, m + 6), one), zero);
+}
+
+
+__attribute__((target("avx2")))
+int
+dcp::xyz_to_rgb_avx2 (
+	int const * xyz_x, int const * xyz_y, int const * xyz_z, int width,
+	double const * lut_in, double const * lut_out, double const * matrix, double dci_coefficient,
+	uint16_t* rgb
+	)
+{
+	auto const scale = _mm256_set1_pd (65535);
+	auto const dci = _mm256_set1_pd (dci_coefficient);
+
+	__m256d m[9];
+	for (int i = 0; i < 9; ++i) {
+		m[i] = _mm256_set1_pd (matrix[i]);
+	}
+
+	int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		auto const cx = _mm_loadu_si128 (reinterpret_cast<__m128i const *>(xyz_x + x));
+		auto const cy = _mm_loadu_si128 (reinterpret_cast<__m128i const *>(xyz_y + x));
+		auto const cz = _mm_loadu_si128 (reinterpret_cast<__m128i const *>(xyz_z + x));
+		if (out_of_range(cx, cy, cz)) {
+			/* Leave these to the scalar code, which reports them */
+			break;
+		}
+
+		__m256d r, g, b;
+		xyz_to_linear_rgb (cx, cy, cz, lut_in, m, dci, r, g, b);
+
+		/* Out gamma LUT */
+		alignas(16) int out[3][4];
+		_mm_store_si128 (reinterpret_cast<__m128i*>(out[0]), _mm256_cvtpd_epi32(_mm256_mul_pd(_mm256_i32gather_pd(lut_out, _mm256_cvtpd_epi32(_mm256_mul_pd(r, scale)), 8), scale)));
+		_mm_store_si128 (reinterpret_cast<__m128i*>(out[1]), _mm256_cvtpd_epi32(_mm256_mul_pd(_mm256_i32gather_pd(lut_out, _mm256_cvtpd_epi32(_mm256_mul_pd(g, scale)), 8), scale)));
+		_mm_store_si128 (reinterpret_cast<__m128i*>(out[2]), _mm256_cvtpd_epi32(_mm256_mul_pd(_mm256_i32gather_pd(lut_out, _mm256_cvtpd_epi32(_mm256_mul_pd(b, scale)), 8), scale)));
+
+		for (int i = 0; i < 4; ++i) {
+			*rgb++ = out[0][i];
+			*rgb++ = out[1][i];
+			*rgb++ = out[2][i];
+		}
+	}
+
+	return x;
+}
+
+
+__attribute__((target("avx2")))
+int
+dcp::xyz_to_rgba_avx2 (
+	int const * xyz_x, int const * xyz_y, int const * xyz_z, int width,
+	double const * lut_in, double const * lut_out, double const * matrix, double dci_coefficient,
+	uint8_t* argb
+	)
+{
+	auto const max_colour = _mm256_set1_pd (65535);
+	auto const scale = _mm256_set1_pd (0xff);
+	auto const dci = _mm256_set1_pd (dci_coefficient);
+
+	__m256d m[9];
+	for (int i = 0; i < 9; ++i) {
+		m[i] = _mm256_set1_pd (matrix[i]);
+	}
+
+	int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		auto const cx = _mm_loadu_si128 (reinterpret_cast<__m128i const *>(xyz_x + x));
+		auto const cy = _mm_loadu_si128 (reinterpret_cast<__m128i const *>(xyz_y + x));
+		auto const cz = _mm_loadu_si128 (reinterpret_cast<__m128i const *>(xyz_z + x));
+		if (out_of_range(cx, cy, cz)) {
+			break;
+		}
+
+		__m256d r, g, b;
+		xyz_to_linear_rgb (cx, cy, cz, lut_in, m, dci, r, g, b);
+
+		/* Out gamma LUT, truncating to 8 bits as the scalar code does */
+		alignas(16) int out[3][4];
+		_mm_store_si128 (reinterpret_cast<__m128i*>(out[0]), _mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_i32gather_pd(lut_out, _mm256_cvtpd_epi32(_mm256_mul_pd(b, max_colour)), 8), scale)));
+		_mm_store_si128 (reinterpret_cast<__m128i*>(out[1]), _mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_i32gather_pd(lut_out, _mm256_cvtpd_epi32(_mm256_mul_pd(g, max_colour)), 8), scale)));
+		_mm_store_si128 (reinterpret_cast<__m128i*>(out[2]), _mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_i32gather_pd(lut_out, _mm256_cvtpd_epi32(_mm256_mul_pd(r, max_colour)), 8), scale)));
+
+		for (int i = 0; i < 4; ++i) {
+			*argb++ = out[0][i];
+			*argb++ = out[1][i];
+			*argb++ = out[2][i];
+			*argb++ = 0xff;
+		}
+	}
+
+	return x;
+}
+
+
+#else
+
+
+int
+dcp::rgb_to_xyz_avx2 (uint16_t const *, int, double const *, double const *, double const *, int*, int*, int*, int&)
+{
+	return 0;
+}
+
+
+int
+dcp::xyz_to_rgb_avx2 (int const *, int const *, int const *, int, double const *, double const *, double const *, double, uint16_t*)
+{
+	return 0;
+}
+
+
+int
+dcp::xyz_to_rgba_avx2 (int const *, int const *, int const *, int, double const *, double const *, double const *, double, uint8_t*)
+{
+	return 0;
+}
+
+
+#endif
@@ -0,0 +1,88 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+/** @file  src/rgb_xyz_avx2.h
+ *  @brief AVX2 versions of the inner loops of the RGB/XYZ conversions.
+ *
+ *  Each of these functions converts as many pixels as it can from the start of one line,
+ *  giving results identical to those of the scalar code in rgb_xyz.cc, and returns the number
+ *  of pixels that it converted.  The caller must convert the rest of the line itself.
+ */
+
+
+#ifndef LIBDCP_RGB_XYZ_AVX2_H
+#define LIBDCP_RGB_XYZ_AVX2_H
+
+
+#include <stdint.h>
+
+
+namespace dcp {
+
+
+/** @return true if the AVX2 conversions are built in, supported by this CPU, and have not been disabled */
+extern bool rgb_xyz_avx2 ();
+
+/** Allow or prevent use of the AVX2 conversions; they are allowed by default */
+extern void set_rgb_xyz_avx2 (bool allowed);
+
+/** @param rgb 16-bit RGB input for one line.
+ *  @param matrix Combined matrix from combined_rgb_to_xyz().
+ *  @param clamped Incremented for each pixel whose XYZ values had to be clamped.
+ */
+extern int rgb_to_xyz_avx2 (
+	uint16_t const * rgb, int width, double const * lut_in, double const * lut_out, double const * matrix,
+	int* xyz_x, int* xyz_y, int* xyz_z, int& clamped
+	);
+
+/** Stops at the first group of pixels containing an XYZ value outside 0-4095 */
+extern int xyz_to_rgb_avx2 (
+	int const * xyz_x, int const * xyz_y, int const * xyz_z, int width,
+	double const * lut_in, double const * lut_out, double const * matrix, double dci_coefficient,
+	uint16_t* rgb
+	);
+
+/** Stops at the first group of pixels containing an XYZ value outside 0-4095 */
+extern int xyz_to_rgba_avx2 (
+	int const * xyz_x, int const * xyz_y, int const * xyz_z, int width,
+	double const * lut_in, double const * lut_out, double const * matrix, double dci_coefficient,
+	uint8_t* argb
+	);
+
+
+}
+
+
+#endif
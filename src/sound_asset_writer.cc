@@ -42,6 +42,7 @@
 #include "crypto_context.h"
 #include "dcp_assert.h"
 #include "exceptions.h"
+#include "pcm_avx2.h"
 #include "sound_asset.h"
 #include "sound_asset_writer.h"
 #include "warnings.h"
@@ -187,56 +188,153 @@ LIBDCP_ENABLE_WARNINGS
 }
 
 
+/** Convert float samples to 24-bit PCM, clipping if necessary */
+static void
+float_to_pcm24 (float const * in, int count, uint8_t* out)
+{
+	static float const clip = 1.0f - (1.0f / pow (2, 23));
+
+	for (int i = 0; i < count; ++i) {
+		float x = in[i];
+		if (x > clip) {
+			x = clip;
+		} else if (x < -clip) {
+			x = -clip;
+		}
+		int32_t const s = x * (1 << 23);
+		*out++ = (s & 0xff);
+		*out++ = (s & 0xff00) >> 8;
+		*out++ = (s & 0xff0000) >> 16;
+	}
+}
+
+
 void
 SoundAssetWriter::write (float const * const * data, int frames)
 {
+	/* Check arguments here, so that a mistake is found by the caller rather than on the write-behind thread */
 	DCP_ASSERT (!_finalized);
 	DCP_ASSERT (frames > 0);
 
-	static float const clip = 1.0f - (1.0f / pow (2, 23));
+	if (!writing_behind()) {
+		do_write (data, frames);
+		return;
+	}
+
+	/* Take a copy of the samples for the write-behind thread, one channel after another */
+	int const ch = _asset->channels ();
+	auto copy = std::make_shared<vector<float>>(ch * frames);
+	for (int i = 0; i < ch; ++i) {
+		if (i != 13 || !_sync) {
+			std::copy (data[i], data[i] + frames, copy->data() + i * frames);
+		}
+	}
+
+	write_behind ([this, copy, ch, frames]() {
+		vector<float const *> channels (ch);
+		for (int i = 0; i < ch; ++i) {
+			channels[i] = copy->data() + i * frames;
+		}
+		do_write (channels.data(), frames);
+	});
+}
+
+
+void
+SoundAssetWriter::do_write (float const * const * data, int frames)
+{
+	DCP_ASSERT (!_finalized);
 
 	if (!_started) {
 		start ();
 	}
 
 	int const ch = _asset->channels ();
+	int const capacity = _state->frame_buffer.Capacity ();
+	bool const avx2 = pcm_avx2 ();
 
-	for (int i = 0; i < frames; ++i) {
-
-		byte_t* out = _state->frame_buffer.Data() + _frame_buffer_offset;
+	int done = 0;
+	while (done < frames) {
+		/* Do as many samples as will fit in the current MXF frame */
+		int const n = min (frames - done, (capacity - _frame_buffer_offset) / (3 * ch));
+		DCP_ASSERT (n > 0);
 
-		/* Write one sample per channel */
+		/* Interleave the channels, leaving the sync channel (if any) to be filled in afterwards */
+		_interleaved.resize (n * ch);
 		for (int j = 0; j < ch; ++j) {
-			int32_t s = 0;
 			if (j == 13 && _sync) {
-				s = _fsk.get();
-			} else {
-				/* Convert sample to 24-bit int, clipping if necessary. */
-				float x = data[j][i];
-				if (x > clip) {
-					x = clip;
-				} else if (x < -clip) {
-					x = -clip;
-				}
-				s = x * (1 << 23);
+				continue;
+			}
+			auto in = data[j] + done;
+			auto out = _interleaved.data() + j;
+			for (int i = 0; i < n; ++i) {
+				*out = in[i];
+				out += ch;
 			}
-			*out++ = (s & 0xff);
-			*out++ = (s & 0xff00) >> 8;
-			*out++ = (s & 0xff0000) >> 16;
 		}
-		_frame_buffer_offset += 3 * ch;
 
-		DCP_ASSERT (_frame_buffer_offset <= int(_state->frame_buffer.Capacity()));
+		/* Convert to 24-bit PCM */
+		byte_t* out = _state->frame_buffer.Data() + _frame_buffer_offset;
+		int const converted = avx2 ? float_to_pcm24_avx2(_interleaved.data(), n * ch, out) : 0;
+		float_to_pcm24 (_interleaved.data() + converted, n * ch - converted, out + converted * 3);
+
+		if (_sync) {
+			auto sync = out + 13 * 3;
+			for (int i = 0; i < n; ++i) {
+				int32_t const s = _fsk.get();
+				sync[0] = (s & 0xff);
+				sync[1] = (s & 0xff00) >> 8;
+				sync[2] = (s & 0xff0000) >> 16;
+				sync += 3 * ch;
+			}
+		}
+
+		_frame_buffer_offset += 3 * ch * n;
+		done += n;
+
+		DCP_ASSERT (_frame_buffer_offset <= capacity);
 
 		/* Finish the MXF frame if required */
-		if (_frame_buffer_offset == int (_state->frame_buffer.Capacity())) {
+		if (_frame_buffer_offset == capacity) {
 			write_current_frame ();
 			_frame_buffer_offset = 0;
-			memset (_state->frame_buffer.Data(), 0, _state->frame_buffer.Capacity());
 		}
 	}
 }
 
+void
+SoundAssetWriter::write (uint8_t const * data, int size)
+{
+	DCP_ASSERT (!_finalized);
+	DCP_ASSERT (size == int(_state->frame_buffer.Capacity()));
+
+	if (!writing_behind()) {
+		do_write (data, size);
+		return;
+	}
+
+	auto copy = std::make_shared<vector<uint8_t>>(data, data + size);
+	write_behind ([this, copy]() {
+		do_write (copy->data(), copy->size());
+	});
+}
+
+
+void
+SoundAssetWriter::do_write (uint8_t const * data, int size)
+{
+	DCP_ASSERT (!_finalized);
+	/* We can't mix this with writing floats unless the floats made up whole frames */
+	DCP_ASSERT (_frame_buffer_offset == 0);
+
+	if (!_started) {
+		start ();
+	}
+
+	memcpy (_state->frame_buffer.Data(), data, size);
+	write_current_frame ();
+}
+
 void
 SoundAssetWriter::write_current_frame ()
 {
@@ -253,10 +351,21 @@ SoundAssetWriter::write_current_frame ()
 	}
 }
 
+SoundAssetWriter::~SoundAssetWriter ()
+{
+	/* Our queued writes use our members, so stop them before those are destroyed */
+	stop_write_behind ();
+}
+
+
 bool
 SoundAssetWriter::finalize ()
 {
+	flush_write_behind ();
+
 	if (_frame_buffer_offset > 0) {
+		/* Pad the last frame with silence */
+		memset (_state->frame_buffer.Data() + _frame_buffer_offset, 0, _state->frame_buffer.Capacity() - _frame_buffer_offset);
 		write_current_frame ();
 	}
 
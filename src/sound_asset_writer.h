@@ -42,11 +42,13 @@
 #include "types.h"
 #include "sound_frame.h"
 #include <memory>
+#include <vector>
 #include <boost/filesystem.hpp>
 #include <boost/shared_array.hpp>
 
 
 struct sync_test1;
+struct sound_asset_writer_avx2_test;
 
 
 namespace dcp {
@@ -63,24 +65,42 @@ class SoundAsset;
  *  Sound samples can be written to the SoundAsset by calling write() with
  *  a buffer of float values.  finalize() must be called after the last samples
  *  have been written.
+ *
+ *  After set_write_behind() has been called write() copies the data it is given
+ *  and returns, leaving the writing (and any encryption) to be done on a background thread.  An error
+ *  from such a write is then thrown by the next call to write() or finalize().
  */
 class SoundAssetWriter : public AssetWriter
 {
 public:
+	~SoundAssetWriter ();
+
 	/** @param data Pointer an array of float pointers, one for each channel.
 	 *  @param frames Number of frames i.e. number of floats that are given for each channel.
 	 */
 	void write (float const * const *, int);
 
+	/** Write a complete frame of 24-bit PCM data, for example one read from another SoundAsset.
+	 *  The data is written as it is; in particular no sync signal is added to it.
+	 *  @param data PCM data.
+	 *  @param size Size of data in bytes, which must be the size of one frame of this asset.
+	 */
+	void write (uint8_t const * data, int size);
+
 	bool finalize () override;
 
+	using AssetWriter::set_write_behind;
+
 private:
 	friend class SoundAsset;
 	friend struct ::sync_test1;
+	friend struct ::sound_asset_writer_avx2_test;
 
 	SoundAssetWriter (SoundAsset *, boost::filesystem::path, bool sync);
 
 	void start ();
+	void do_write (float const * const *, int);
+	void do_write (uint8_t const * data, int size);
 	void write_current_frame ();
 	std::vector<bool> create_sync_packets ();
 
@@ -93,6 +113,8 @@ private:
 
 	SoundAsset* _asset = nullptr;
 	int _frame_buffer_offset = 0;
+	/** Samples from the current call to write(), interleaved ready to be converted to PCM */
+	std::vector<float> _interleaved;
 
 	/** true to ignore any signal passed to write() on channel 14 and instead write a sync track */
 	bool _sync = false;
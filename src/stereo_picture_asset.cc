@@ -43,6 +43,7 @@
 #include "stereo_picture_asset_writer.h"
 #include "stereo_picture_asset_reader.h"
 #include "dcp_assert.h"
+#include "mapped_mxf.h"
 #include <asdcp/AS_DCP.h>
 
 
@@ -50,6 +51,7 @@ using std::string;
 using std::pair;
 using std::make_pair;
 using std::shared_ptr;
+using std::make_shared;
 using std::dynamic_pointer_cast;
 using namespace dcp;
 
@@ -133,17 +135,50 @@ StereoPictureAsset::equals (shared_ptr<const Asset> other, EqualityOptions opt,
 	auto other_picture = dynamic_pointer_cast<const StereoPictureAsset> (other);
 	DCP_ASSERT (other_picture);
 
-	auto reader = start_read ();
-	auto other_reader = other_picture->start_read ();
+	/* Unencrypted assets can be compared straight from their files without reading or copying each frame */
+	shared_ptr<MappedMXF> mapped;
+	shared_ptr<MappedMXF> other_mapped;
+	shared_ptr<StereoPictureAssetReader> reader;
+	shared_ptr<StereoPictureAssetReader> other_reader;
+	if (!encrypted() && !other_picture->encrypted()) {
+		try {
+			mapped = make_shared<MappedMXF>(this);
+			other_mapped = make_shared<MappedMXF>(other_picture.get());
+		} catch (std::exception&) {
+			/* The files could not be mapped, or are laid out in a way that MappedMXF does not
+			 * understand, so read the frames with AssetReaders instead.
+			 */
+			mapped.reset ();
+			other_mapped.reset ();
+		}
+	}
+
+	if (!mapped) {
+		reader = start_read ();
+		other_reader = other_picture->start_read ();
+	}
 
 	bool result = true;
 
 	for (int i = 0; i < _intrinsic_duration; ++i) {
-		shared_ptr<const StereoPictureFrame> frame_A;
-		shared_ptr<const StereoPictureFrame> frame_B;
+		shared_ptr<const Data> left_A;
+		shared_ptr<const Data> right_A;
+		shared_ptr<const Data> left_B;
+		shared_ptr<const Data> right_B;
 		try {
-			frame_A = reader->get_frame (i);
-			frame_B = other_reader->get_frame (i);
+			if (mapped) {
+				left_A = mapped->get_frame (i, Eye::LEFT);
+				right_A = mapped->get_frame (i, Eye::RIGHT);
+				left_B = other_mapped->get_frame (i, Eye::LEFT);
+				right_B = other_mapped->get_frame (i, Eye::RIGHT);
+			} else {
+				auto frame_A = reader->get_frame (i);
+				auto frame_B = other_reader->get_frame (i);
+				left_A = frame_A->left ();
+				right_A = frame_A->right ();
+				left_B = frame_B->left ();
+				right_B = frame_B->right ();
+			}
 		} catch (ReadError& e) {
 			/* If there was a problem reading the frame data we'll just assume
 			   the two frames are not equal.
@@ -154,8 +189,8 @@ StereoPictureAsset::equals (shared_ptr<const Asset> other, EqualityOptions opt,
 
 		if (!frame_buffer_equals (
 			    i, opt, note,
-			    frame_A->left()->data(), frame_A->left()->size(),
-			    frame_B->left()->data(), frame_B->left()->size()
+			    left_A->data(), left_A->size(),
+			    left_B->data(), left_B->size()
 			    )) {
 			result = false;
 			if (!opt.keep_going) {
@@ -165,8 +200,8 @@ StereoPictureAsset::equals (shared_ptr<const Asset> other, EqualityOptions opt,
 
 		if (!frame_buffer_equals (
 			    i, opt, note,
-			    frame_A->right()->data(), frame_A->right()->size(),
-			    frame_B->right()->data(), frame_B->right()->size()
+			    right_A->data(), right_A->size(),
+			    right_B->data(), right_B->size()
 			    )) {
 			result = false;
 			if (!opt.keep_going) {
@@ -85,15 +85,14 @@ StereoPictureAssetWriter::write (uint8_t const * data, int size)
 		start (data, size);
 	}
 
- 	if (ASDCP_FAILURE (_state->j2k_parser.OpenReadFrame (data, size, _state->frame_buffer))) {
- 		boost::throw_exception (MiscError ("could not parse J2K frame"));
- 	}
+	ASDCP::JP2K::FrameBuffer frame;
+	wrap_j2k_frame (data, size, _state->picture_descriptor, frame);
 
 	uint64_t const before_offset = _state->mxf_writer.Tell ();
 
 	string hash;
 	auto r = _state->mxf_writer.WriteFrame (
-		_state->frame_buffer,
+		frame,
 		_next_eye == Eye::LEFT ? ASDCP::JP2K::SP_LEFT : ASDCP::JP2K::SP_RIGHT,
 		_crypto_context->context(),
 		_crypto_context->hmac(),
@@ -132,9 +131,18 @@ StereoPictureAssetWriter::fake_write (int size)
 }
 
 
+StereoPictureAssetWriter::~StereoPictureAssetWriter ()
+{
+	/* Our queued writes use our members, so stop them before those are destroyed */
+	stop_write_behind ();
+}
+
+
 bool
 StereoPictureAssetWriter::finalize ()
 {
+	flush_write_behind ();
+
 	if (_started) {
 		auto r = _state->mxf_writer.Finalize();
 		if (ASDCP_FAILURE(r)) {
@@ -41,6 +41,7 @@
 #include "compose.hpp"
 #include "crypto_context.h"
 #include "exceptions.h"
+#include "frame.h"
 #include "j2k_transcode.h"
 #include "rgb_xyz.h"
 #include "stereo_picture_frame.h"
@@ -98,11 +99,24 @@ StereoPictureFrame::Part::size () const
  */
 StereoPictureFrame::StereoPictureFrame (ASDCP::JP2K::MXFSReader* reader, int n, shared_ptr<DecryptionContext> c, bool check_hmac)
 {
-	/* XXX: unfortunate guesswork on this buffer size */
-	_buffer = make_shared<ASDCP::JP2K::SFrameBuffer>(4 * Kumu::Megabyte);
+	read (reader, n, c, check_hmac);
+}
+
+
+/** Read another frame into this object, re-using its buffer if no Part still refers to it */
+void
+StereoPictureFrame::read (ASDCP::JP2K::MXFSReader* reader, int n, shared_ptr<DecryptionContext> c, bool check_hmac)
+{
+	if (!_buffer || _buffer.use_count() > 1) {
+		/* read_frame() will make a new buffer sized from the index; this is enough for any frame which
+		 * meets the DCI bit rate limit, for when the index cannot say.
+		 */
+		_buffer.reset ();
+		_buffer_size = 4 * Kumu::Megabyte;
+	}
 
-	if (ASDCP_FAILURE (reader->ReadFrame (n, *_buffer, c->context(), check_hmac ? c->hmac() : nullptr))) {
-		boost::throw_exception (ReadError (String::compose ("could not read video frame %1 of %2", n)));
+	if (ASDCP_FAILURE (read_frame(reader, n, _buffer, _buffer_size, c, check_hmac))) {
+		boost::throw_exception (ReadError (String::compose ("could not read video frame %1", n)));
 	}
 }
 
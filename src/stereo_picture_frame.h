@@ -107,7 +107,11 @@ private:
 
 	StereoPictureFrame (ASDCP::JP2K::MXFSReader* reader, int n, std::shared_ptr<DecryptionContext>, bool check_hmac);
 
+	void read (ASDCP::JP2K::MXFSReader* reader, int n, std::shared_ptr<DecryptionContext>, bool check_hmac);
+
 	std::shared_ptr<ASDCP::JP2K::SFrameBuffer> _buffer;
+	/** Capacity of each eye's part of _buffer when it is used to read frames from an MXF */
+	int _buffer_size = 0;
 };
 
 
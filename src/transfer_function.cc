@@ -37,40 +37,87 @@
  */
 
 
+#include "dcp_assert.h"
 #include "transfer_function.h"
 #include <cmath>
 
 
 using std::pow;
-using std::map;
-using std::pair;
-using std::make_pair;
 using std::shared_ptr;
 using namespace dcp;
 
 
+TransferFunction::TransferFunction ()
+{
+	for (int i = 0; i <= max_bit_depth; ++i) {
+		for (int j = 0; j < 2; ++j) {
+			_luts[i][j] = nullptr;
+			_float_luts[i][j] = nullptr;
+		}
+	}
+}
+
+
 TransferFunction::~TransferFunction ()
 {
+	for (int i = 0; i <= max_bit_depth; ++i) {
+		for (int j = 0; j < 2; ++j) {
+			delete[] _luts[i][j].load();
+			delete[] _float_luts[i][j].load();
+		}
+	}
+}
+
+
+double const *
+TransferFunction::lut (int bit_depth, bool inverse) const
+{
+	DCP_ASSERT (bit_depth >= 0 && bit_depth <= max_bit_depth);
+
+	auto& slot = _luts[bit_depth][inverse ? 1 : 0];
+	auto lut = slot.load (std::memory_order_acquire);
+	if (lut) {
+		return lut;
+	}
+
 	boost::mutex::scoped_lock lm (_mutex);
 
-	for (auto const& i: _luts) {
-		delete[] i.second;
+	/* Someone else may have made it while we were waiting for the lock */
+	lut = slot.load (std::memory_order_relaxed);
+	if (!lut) {
+		lut = make_lut (bit_depth, inverse);
+		slot.store (lut, std::memory_order_release);
 	}
 
-	_luts.clear ();
+	return lut;
 }
 
 
-double const *
-TransferFunction::lut (int bit_depth, bool inverse) const
+float const *
+TransferFunction::float_lut (int bit_depth, bool inverse) const
 {
+	DCP_ASSERT (bit_depth >= 0 && bit_depth <= max_bit_depth);
+
+	auto& slot = _float_luts[bit_depth][inverse ? 1 : 0];
+	auto lut = slot.load (std::memory_order_acquire);
+	if (lut) {
+		return lut;
+	}
+
+	/* Get this before taking the lock, as lut() may need it */
+	auto const double_lut = this->lut (bit_depth, inverse);
+
 	boost::mutex::scoped_lock lm (_mutex);
 
-	auto i = _luts.find (make_pair (bit_depth, inverse));
-	if (i != _luts.end ()) {
-		return i->second;
+	lut = slot.load (std::memory_order_relaxed);
+	if (!lut) {
+		int const count = 1 << bit_depth;
+		lut = new float[count];
+		for (int i = 0; i < count; ++i) {
+			lut[i] = double_lut[i];
+		}
+		slot.store (lut, std::memory_order_release);
 	}
 
-	_luts[make_pair(bit_depth, inverse)] = make_lut (bit_depth, inverse);
-	return _luts[make_pair(bit_depth, inverse)];
+	return lut;
 }
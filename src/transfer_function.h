@@ -42,7 +42,7 @@
 
 
 #include <boost/thread/mutex.hpp>
-#include <map>
+#include <atomic>
 #include <memory>
 
 
@@ -51,20 +51,28 @@ namespace dcp {
 
 /** @class TransferFunction
  *  @brief A transfer function represented by a lookup table.
+ *
+ *  LUTs are made the first time they are asked for; after that, getting them
+ *  does not take any lock.
  */
 class TransferFunction
 {
 public:
-	TransferFunction () {}
+	TransferFunction ();
 
 	TransferFunction (TransferFunction const&) = delete;
 	TransferFunction& operator= (TransferFunction const&) = delete;
 
 	virtual ~TransferFunction ();
 
-	/** @return A look-up table (of size 2^bit_depth) whose values range from 0 to 1 */
+	/** @param bit_depth Bit depth, from 0 to 30.
+	 *  @return A look-up table (of size 2^bit_depth) whose values range from 0 to 1
+	 */
 	double const * lut (int bit_depth, bool inverse) const;
 
+	/** @return The same look-up table as lut() with its values converted to float */
+	float const * float_lut (int bit_depth, bool inverse) const;
+
 	virtual bool about_equal (std::shared_ptr<const TransferFunction> other, double epsilon) const = 0;
 
 protected:
@@ -72,8 +80,12 @@ protected:
 	virtual double * make_lut (int bit_depth, bool inverse) const = 0;
 
 private:
-	mutable std::map<std::pair<int, bool>, double*> _luts;
-	/** mutex to protect _luts */
+	static int constexpr max_bit_depth = 30;
+
+	/** LUTs indexed by bit depth and inverse flag, each of which is set once and then never changed */
+	mutable std::atomic<double*> _luts[max_bit_depth + 1][2];
+	mutable std::atomic<float*> _float_luts[max_bit_depth + 1][2];
+	/** mutex held while making a LUT, so that only one thread makes each one */
 	mutable boost::mutex _mutex;
 };
 
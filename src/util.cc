@@ -45,6 +45,7 @@
 #include "openjpeg_image.h"
 #include "dcp_assert.h"
 #include "compose.hpp"
+#include "digest_cache.h"
 #include <openjpeg.h>
 #include <asdcp/KM_util.h>
 #include <asdcp/KM_fileio.h>
@@ -61,6 +62,9 @@
 #include <boost/dll/runtime_symbol_info.hpp>
 #endif
 #include <boost/filesystem.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <stdexcept>
 #include <iostream>
 #include <iomanip>
@@ -116,6 +120,14 @@ dcp::make_digest (ArrayData data)
 string
 dcp::make_digest (boost::filesystem::path filename, function<void (float)> progress)
 {
+	auto cache = digest_cache ();
+	if (cache && cache->policy() == DigestCache::Policy::TRUST) {
+		auto cached = cache->get (filename);
+		if (cached) {
+			return *cached;
+		}
+	}
+
 	Kumu::FileReader reader;
 	auto r = reader.OpenRead (filename.string().c_str ());
 	if (ASDCP_FAILURE(r)) {
@@ -125,26 +137,95 @@ dcp::make_digest (boost::filesystem::path filename, function<void (float)> progr
 	SHA_CTX sha;
 	SHA1_Init (&sha);
 
-	int const buffer_size = 65536;
-	Kumu::ByteString read_buffer (buffer_size);
+	/* Read the file in large chunks into two buffers, filling one on a reader thread
+	 * while the other is hashed on this one.
+	 */
+	struct Reader
+	{
+		Kumu::ByteString buffers[2];
+		/** Bytes read into each buffer, or -1 if it is waiting to be filled */
+		int64_t got[2] = { -1, -1 };
+		std::exception_ptr error;
+		bool stop = false;
+		std::mutex mutex;
+		std::condition_variable changed;
+		std::thread thread;
+
+		~Reader ()
+		{
+			{
+				std::unique_lock<std::mutex> lock (mutex);
+				stop = true;
+				changed.notify_all ();
+			}
+			if (thread.joinable()) {
+				thread.join ();
+			}
+		}
+	};
+
+	int const buffer_size = 4 * Kumu::Megabyte;
+	Reader state;
+	for (auto& i: state.buffers) {
+		i.Capacity (buffer_size);
+	}
+
+	state.thread = std::thread ([&state, &reader, &filename]() {
+		for (int current = 0; ; current = 1 - current) {
+			{
+				std::unique_lock<std::mutex> lock (state.mutex);
+				state.changed.wait (lock, [&state, current]() { return state.stop || state.got[current] == -1; });
+				if (state.stop) {
+					return;
+				}
+			}
+
+			ui32_t read = 0;
+			auto r = reader.Read (state.buffers[current].Data(), state.buffers[current].Capacity(), &read);
+
+			std::unique_lock<std::mutex> lock (state.mutex);
+			if (r == Kumu::RESULT_ENDOFFILE) {
+				read = 0;
+			} else if (ASDCP_FAILURE(r)) {
+				state.error = std::make_exception_ptr (FileError("could not read file to compute digest", filename, r));
+				read = 0;
+			}
+			state.got[current] = read;
+			state.changed.notify_all ();
+			if (read == 0) {
+				return;
+			}
+		}
+	});
 
 	Kumu::fsize_t done = 0;
 	Kumu::fsize_t const size = reader.Size ();
-	while (true) {
-		ui32_t read = 0;
-		auto r = reader.Read (read_buffer.Data(), read_buffer.Capacity(), &read);
+	for (int current = 0; ; current = 1 - current) {
+		int64_t got = 0;
+		{
+			std::unique_lock<std::mutex> lock (state.mutex);
+			state.changed.wait (lock, [&state, current]() { return state.got[current] != -1; });
+			if (state.error) {
+				std::rethrow_exception (state.error);
+			}
+			got = state.got[current];
+		}
 
-		if (r == Kumu::RESULT_ENDOFFILE) {
+		if (got == 0) {
 			break;
-		} else if (ASDCP_FAILURE (r)) {
-			boost::throw_exception (FileError("could not read file to compute digest", filename, r));
 		}
 
-		SHA1_Update (&sha, read_buffer.Data(), read);
+		SHA1_Update (&sha, state.buffers[current].Data(), got);
+
+		{
+			std::unique_lock<std::mutex> lock (state.mutex);
+			state.got[current] = -1;
+			state.changed.notify_all ();
+		}
 
 		if (progress) {
 			progress (float (done) / size);
-			done += read;
+			done += got;
 		}
 	}
 
@@ -152,7 +233,13 @@ dcp::make_digest (boost::filesystem::path filename, function<void (float)> progr
 	SHA1_Final (byte_buffer, &sha);
 
 	char digest[64];
-	return Kumu::base64encode (byte_buffer, SHA_DIGEST_LENGTH, digest, 64);
+	string const result = Kumu::base64encode (byte_buffer, SHA_DIGEST_LENGTH, digest, 64);
+
+	if (cache) {
+		cache->put (filename, result);
+	}
+
+	return result;
 }
 
 
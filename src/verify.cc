@@ -40,10 +40,12 @@
 #include "compose.hpp"
 #include "cpl.h"
 #include "dcp.h"
+#include "digest_cache.h"
 #include "exceptions.h"
 #include "interop_subtitle_asset.h"
 #include "mono_picture_asset.h"
 #include "mono_picture_frame.h"
+#include "mxf_stream.h"
 #include "raw_convert.h"
 #include "reel.h"
 #include "reel_closed_caption_asset.h"
@@ -77,8 +79,15 @@
 #include <xercesc/sax/HandlerBase.hpp>
 #include <xercesc/util/PlatformUtils.hpp>
 #include <boost/algorithm/string.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
 #include <iostream>
 #include <map>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <vector>
 
 
@@ -88,7 +97,9 @@ using std::string;
 using std::cout;
 using std::map;
 using std::max;
+using std::pair;
 using std::set;
+using std::make_pair;
 using std::shared_ptr;
 using std::make_shared;
 using boost::optional;
@@ -371,6 +382,78 @@ validate_xml (T xml, boost::filesystem::path xsd_dtd_directory, vector<Verificat
 }
 
 
+/** Measures the stages of a verification, passing a VerificationTiming for each to a function
+ *  as the next one starts (or when finish() is called).
+ */
+class StageTimer
+{
+public:
+	explicit StageTimer (function<void (VerificationTiming const&)> report)
+		: _report (report)
+	{}
+
+	StageTimer (StageTimer const&) = delete;
+	StageTimer& operator= (StageTimer const&) = delete;
+
+	void start (string stage, optional<boost::filesystem::path> file)
+	{
+		finish ();
+		if (_report) {
+			_current = VerificationTiming();
+			_current->stage = stage;
+			_current->file = file;
+			_bytes = 0;
+			_frames = 0;
+			_start = std::chrono::steady_clock::now();
+		}
+	}
+
+	void finish ()
+	{
+		if (!_current) {
+			return;
+		}
+		_current->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+		_current->bytes = _bytes;
+		_current->frames = _frames;
+		auto const timing = *_current;
+		_current = boost::none;
+		_report (timing);
+	}
+
+	/** May be called from any thread */
+	void add_bytes (int64_t bytes) {
+		_bytes += bytes;
+	}
+
+	/** May be called from any thread */
+	void add_frames (int64_t frames) {
+		_frames += frames;
+	}
+
+private:
+	function<void (VerificationTiming const&)> _report;
+	optional<VerificationTiming> _current;
+	std::chrono::steady_clock::time_point _start;
+	std::atomic<int64_t> _bytes{0};
+	std::atomic<int64_t> _frames{0};
+};
+
+
+/** @return the number of bytes that hashing a file will read, which is none if a
+ *  digest cache will give us the hash.
+ */
+static int64_t
+bytes_to_hash (boost::filesystem::path file)
+{
+	auto cache = digest_cache ();
+	if (cache && cache->policy() == DigestCache::Policy::TRUST && cache->get(file)) {
+		return 0;
+	}
+	return boost::filesystem::file_size (file);
+}
+
+
 enum class VerifyAssetResult {
 	GOOD,
 	CPL_PKL_DIFFER,
@@ -378,11 +461,12 @@ enum class VerifyAssetResult {
 };
 
 
+/** Check an asset's hash against the ones given in the PKL and CPL.
+ *  @param actual_hash Hash of the asset's file.
+ */
 static VerifyAssetResult
-verify_asset (shared_ptr<const DCP> dcp, shared_ptr<const ReelFileAsset> reel_file_asset, function<void (float)> progress)
+verify_asset (shared_ptr<const DCP> dcp, shared_ptr<const ReelFileAsset> reel_file_asset, string actual_hash)
 {
-	auto const actual_hash = reel_file_asset->asset_ref()->hash(progress);
-
 	auto pkls = dcp->pkls();
 	/* We've read this DCP in so it must have at least one PKL */
 	DCP_ASSERT (!pkls.empty());
@@ -412,6 +496,13 @@ verify_asset (shared_ptr<const DCP> dcp, shared_ptr<const ReelFileAsset> reel_fi
 }
 
 
+static VerifyAssetResult
+verify_asset (shared_ptr<const DCP> dcp, shared_ptr<const ReelFileAsset> reel_file_asset, function<void (float)> progress)
+{
+	return verify_asset (dcp, reel_file_asset, reel_file_asset->asset_ref()->hash(progress));
+}
+
+
 void
 verify_language_tag (string tag, vector<VerificationNote>& notes)
 {
@@ -423,51 +514,293 @@ verify_language_tag (string tag, vector<VerificationNote>& notes)
 }
 
 
+/** J2K codestreams of a picture frame; one for a 2D frame, or left and right for a 3D one */
+typedef vector<shared_ptr<const Data>> FrameParts;
+
+
+/** Check the J2K codestreams of every frame in a picture asset.
+ *  @param duration Number of frames to check.
+ *  @param read Functions to read a frame's codestreams.  Frame i is read by read[i % read.size()]; each
+ *  function is called for its frames in order, and never from more than one thread at a time, but
+ *  different functions may be called at the same time on different threads.
+ *  @param check true to run verify_j2k on each frame, false to just read the frames.
+ *  @param threads Number of threads to check frames with; if this is 1 everything happens on the calling thread.
+ *  @param progress Progress reporting function; this will always be called on the calling thread, in frame order.
+ *  @param add Function to receive the notes from each frame; like progress this is called on the calling thread,
+ *  in frame order, so the outcome is the same however many threads are used.
+ */
+static void
+verify_j2k_frames (
+	int64_t duration,
+	vector<function<FrameParts (int64_t)>> read,
+	bool check,
+	int threads,
+	function<void (float)> progress,
+	function<void (vector<VerificationNote> const&)> add
+	)
+{
+	auto check_frame = [check](FrameParts const& parts) {
+		vector<VerificationNote> j2k_notes;
+		if (check) {
+			for (auto i: parts) {
+				verify_j2k (i, j2k_notes);
+			}
+		}
+		return j2k_notes;
+	};
+
+	DCP_ASSERT (!read.empty());
+
+	if (threads <= 1) {
+		for (int64_t i = 0; i < duration; ++i) {
+			add (check_frame(read[i % read.size()](i)));
+			progress (float(i) / duration);
+		}
+		return;
+	}
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	/* Frames that have been read but not yet checked */
+	list<pair<int64_t, FrameParts>> pending;
+	/* Notes from frames that have been checked but not yet given to add() */
+	map<int64_t, vector<VerificationNote>> checked;
+	/* Index of the next frame whose notes should be given to add() */
+	int64_t next = 0;
+	/* Maximum number of frames that may be read but not yet given to add() */
+	int64_t const window = max(threads, static_cast<int>(read.size())) * 2;
+	/* Number of reading threads which have finished */
+	size_t readers_done = 0;
+	bool stop = false;
+	std::exception_ptr error;
+
+	auto fail = [&]() {
+		std::unique_lock<std::mutex> lock (mutex);
+		if (!error) {
+			error = std::current_exception ();
+		}
+		stop = true;
+		changed.notify_all ();
+	};
+
+	vector<std::thread> readers;
+	for (size_t r = 0; r < read.size(); ++r) {
+		readers.push_back (std::thread([&, r]() {
+			try {
+				for (int64_t i = r; i < duration; i += read.size()) {
+					{
+						std::unique_lock<std::mutex> lock (mutex);
+						changed.wait (lock, [&]() { return stop || i < next + window; });
+						if (stop) {
+							return;
+						}
+					}
+					auto parts = read[r](i);
+					std::unique_lock<std::mutex> lock (mutex);
+					pending.push_back (make_pair(i, parts));
+					changed.notify_all ();
+				}
+				std::unique_lock<std::mutex> lock (mutex);
+				++readers_done;
+				changed.notify_all ();
+			} catch (...) {
+				fail ();
+			}
+		}));
+	}
+
+	vector<std::thread> workers;
+	for (int i = 0; i < threads; ++i) {
+		workers.push_back (std::thread([&]() {
+			try {
+				while (true) {
+					pair<int64_t, FrameParts> frame;
+					{
+						std::unique_lock<std::mutex> lock (mutex);
+						changed.wait (lock, [&]() { return stop || readers_done == read.size() || !pending.empty(); });
+						if (stop || pending.empty()) {
+							return;
+						}
+						frame = pending.front ();
+						pending.pop_front ();
+					}
+					auto j2k_notes = check_frame (frame.second);
+					std::unique_lock<std::mutex> lock (mutex);
+					checked[frame.first] = j2k_notes;
+					changed.notify_all ();
+				}
+			} catch (...) {
+				fail ();
+			}
+		}));
+	}
+
+	auto finish = [&]() {
+		{
+			std::unique_lock<std::mutex> lock (mutex);
+			stop = true;
+			changed.notify_all ();
+		}
+		for (auto& i: readers) {
+			i.join ();
+		}
+		for (auto& i: workers) {
+			i.join ();
+		}
+	};
+
+	try {
+		while (true) {
+			int64_t index;
+			vector<VerificationNote> j2k_notes;
+			{
+				std::unique_lock<std::mutex> lock (mutex);
+				changed.wait (lock, [&]() { return error || next == duration || checked.find(next) != checked.end(); });
+				if (error || next == duration) {
+					break;
+				}
+				index = next++;
+				j2k_notes = checked[index];
+				checked.erase (index);
+				changed.notify_all ();
+			}
+			add (j2k_notes);
+			progress (float(index) / duration);
+		}
+	} catch (...) {
+		finish ();
+		throw;
+	}
+
+	finish ();
+
+	if (error) {
+		std::rethrow_exception (error);
+	}
+}
+
+
+int
+dcp::max_picture_frame_size (Fraction edit_rate)
+{
+	return rint (250 * 1000000 / (8 * edit_rate.as_float()));
+}
+
+
+int
+dcp::risky_picture_frame_size (Fraction edit_rate)
+{
+	return rint (230 * 1000000 / (8 * edit_rate.as_float()));
+}
+
+
+/** @param stream If non-null, frames will be taken from this stream rather than being read by
+ *  the asset's reader; the stream must be positioned at the start of the asset's file.
+ */
 static void
-verify_picture_asset (shared_ptr<const ReelFileAsset> reel_file_asset, boost::filesystem::path file, vector<VerificationNote>& notes, function<void (float)> progress)
+verify_picture_asset (
+	shared_ptr<const ReelFileAsset> reel_file_asset,
+	boost::filesystem::path file,
+	vector<VerificationNote>& notes,
+	function<void (float)> progress,
+	VerificationOptions const& options,
+	shared_ptr<MXFStream> stream,
+	StageTimer& timer
+	)
 {
 	int biggest_frame = 0;
 	auto asset = dynamic_pointer_cast<PictureAsset>(reel_file_asset->asset_ref().asset());
 	auto const duration = asset->intrinsic_duration ();
 
-	auto check_and_add = [&notes](vector<VerificationNote> const& j2k_notes) {
+	/* Everything in notes so far, so that we can quickly avoid adding duplicates */
+	set<VerificationNote> seen (notes.begin(), notes.end());
+	auto check_and_add = [&notes, &seen, &timer](vector<VerificationNote> const& j2k_notes) {
+		timer.add_frames (1);
 		for (auto i: j2k_notes) {
-			if (find(notes.begin(), notes.end(), i) == notes.end()) {
+			if (seen.insert(i).second) {
 				notes.push_back (i);
 			}
 		}
 	};
 
-	if (auto mono_asset = dynamic_pointer_cast<MonoPictureAsset>(reel_file_asset->asset_ref().asset())) {
-		auto reader = mono_asset->start_read ();
-		for (int64_t i = 0; i < duration; ++i) {
-			auto frame = reader->get_frame (i);
-			biggest_frame = max(biggest_frame, frame->size());
-			if (!mono_asset->encrypted() || mono_asset->key()) {
-				vector<VerificationNote> j2k_notes;
-				verify_j2k (frame, j2k_notes);
-				check_and_add (j2k_notes);
+	/* Frames are always read in order, so when we have a stream we can just take the next
+	 * essence element(s) from it each time.
+	 */
+	auto next = [stream](int64_t i) {
+		auto data = stream->next_essence ();
+		if (!data) {
+			boost::throw_exception (ReadError(String::compose("could not read video frame %1", i)));
+		}
+		return data;
+	};
+
+	std::mutex biggest_frame_mutex;
+	/* When reading from a stream our caller counts the whole file as read, since it is hashed too */
+	auto frame_size = [&biggest_frame, &biggest_frame_mutex, &timer, stream](int size) {
+		if (!stream) {
+			timer.add_bytes (size);
+		}
+		std::unique_lock<std::mutex> lock (biggest_frame_mutex);
+		biggest_frame = max(biggest_frame, size);
+	};
+
+	/* Each AssetReader has its own decryption context, so if we are decrypting we use a reader per
+	 * thread, and frames are decrypted (and have their HMACs checked) in parallel.  With just one
+	 * reader we instead let it read (and decrypt) ahead on another thread while we check frames.
+	 */
+	auto reader_count = [&options](shared_ptr<const PictureAsset> asset) {
+		return asset->encrypted() && asset->key() ? max(1, options.threads) : 1;
+	};
+	int const read_ahead = max(4, options.threads * 2);
+
+	if (stream) {
+		bool const stereo = static_cast<bool>(dynamic_pointer_cast<StereoPictureAsset>(asset));
+		auto read = [next, stereo, frame_size](int64_t i) -> FrameParts {
+			FrameParts parts = { next(i) };
+			if (stereo) {
+				parts.push_back (next(i));
 			}
-			progress (float(i) / duration);
+			for (auto j: parts) {
+				frame_size (j->size());
+			}
+			return parts;
+		};
+		verify_j2k_frames (duration, { read }, true, options.threads, progress, check_and_add);
+	} else if (auto mono_asset = dynamic_pointer_cast<MonoPictureAsset>(reel_file_asset->asset_ref().asset())) {
+		vector<function<FrameParts (int64_t)>> read;
+		auto const count = reader_count (mono_asset);
+		for (int i = 0; i < count; ++i) {
+			auto reader = mono_asset->start_read ();
+			if (count == 1) {
+				reader->set_read_ahead (read_ahead);
+			}
+			read.push_back ([reader, frame_size](int64_t i) -> FrameParts {
+				auto frame = reader->get_frame (i);
+				frame_size (frame->size());
+				return { frame };
+			});
 		}
+		verify_j2k_frames (duration, read, !mono_asset->encrypted() || mono_asset->key(), options.threads, progress, check_and_add);
 	} else if (auto stereo_asset = dynamic_pointer_cast<StereoPictureAsset>(asset)) {
-		auto reader = stereo_asset->start_read ();
-		for (int64_t i = 0; i < duration; ++i) {
-			auto frame = reader->get_frame (i);
-			biggest_frame = max(biggest_frame, max(frame->left()->size(), frame->right()->size()));
-			if (!stereo_asset->encrypted() || mono_asset->key()) {
-				vector<VerificationNote> j2k_notes;
-				verify_j2k (frame->left(), j2k_notes);
-				verify_j2k (frame->right(), j2k_notes);
-				check_and_add (j2k_notes);
+		vector<function<FrameParts (int64_t)>> read;
+		auto const count = reader_count (stereo_asset);
+		for (int i = 0; i < count; ++i) {
+			auto reader = stereo_asset->start_read ();
+			if (count == 1) {
+				reader->set_read_ahead (read_ahead);
 			}
-			progress (float(i) / duration);
+			read.push_back ([reader, frame_size](int64_t i) -> FrameParts {
+				auto frame = reader->get_frame (i);
+				frame_size (frame->left()->size());
+				frame_size (frame->right()->size());
+				return { frame->left(), frame->right() };
+			});
 		}
-
+		verify_j2k_frames (duration, read, !stereo_asset->encrypted() || stereo_asset->key(), options.threads, progress, check_and_add);
 	}
 
-	static const int max_frame =   rint(250 * 1000000 / (8 * asset->edit_rate().as_float()));
-	static const int risky_frame = rint(230 * 1000000 / (8 * asset->edit_rate().as_float()));
+	auto const max_frame = max_picture_frame_size (asset->edit_rate());
+	auto const risky_frame = risky_picture_frame_size (asset->edit_rate());
 	if (biggest_frame > max_frame) {
 		notes.push_back ({
 			VerificationNote::Type::ERROR, VerificationNote::Code::INVALID_PICTURE_FRAME_SIZE_IN_BYTES, file
@@ -486,29 +819,52 @@ verify_main_picture_asset (
 	shared_ptr<const ReelPictureAsset> reel_asset,
 	function<void (string, optional<boost::filesystem::path>)> stage,
 	function<void (float)> progress,
-	vector<VerificationNote>& notes
+	VerificationOptions const& options,
+	vector<VerificationNote>& notes,
+	StageTimer& timer
 	)
 {
 	auto asset = reel_asset->asset();
 	auto const file = *asset->file();
-	stage ("Checking picture asset hash", file);
-	auto const r = verify_asset (dcp, reel_asset, progress);
-	switch (r) {
-		case VerifyAssetResult::BAD:
-			notes.push_back ({
-				VerificationNote::Type::ERROR, VerificationNote::Code::INCORRECT_PICTURE_HASH, file
-			});
-			break;
-		case VerifyAssetResult::CPL_PKL_DIFFER:
-			notes.push_back ({
-				VerificationNote::Type::ERROR, VerificationNote::Code::MISMATCHED_PICTURE_HASHES, file
-			});
-			break;
-		default:
-			break;
+
+	auto hash_note = [&notes, file](VerifyAssetResult r, vector<VerificationNote>::iterator position) {
+		switch (r) {
+			case VerifyAssetResult::BAD:
+				notes.insert (position, {
+					VerificationNote::Type::ERROR, VerificationNote::Code::INCORRECT_PICTURE_HASH, file
+				});
+				break;
+			case VerifyAssetResult::CPL_PKL_DIFFER:
+				notes.insert (position, {
+					VerificationNote::Type::ERROR, VerificationNote::Code::MISMATCHED_PICTURE_HASHES, file
+				});
+				break;
+			default:
+				break;
+		}
+	};
+
+	if (!asset->encrypted()) {
+		/* Hash the file and check its frames with a single read, putting any note about
+		 * the hash before those about the frames as we would if we did this in two passes.
+		 */
+		stage ("Checking picture asset hash and frame sizes", file);
+		auto stream = make_shared<MXFStream>(file);
+		auto const position = notes.size();
+		timer.add_bytes (boost::filesystem::file_size(file));
+		verify_picture_asset (reel_asset, file, notes, progress, options, stream, timer);
+		auto const digest = stream->digest ();
+		if (auto cache = digest_cache()) {
+			cache->put (file, digest);
+		}
+		hash_note (verify_asset(dcp, reel_asset, digest), notes.begin() + position);
+	} else {
+		stage ("Checking picture asset hash", file);
+		timer.add_bytes (bytes_to_hash(file));
+		hash_note (verify_asset(dcp, reel_asset, progress), notes.end());
+		stage ("Checking picture frame sizes", asset->file());
+		verify_picture_asset (reel_asset, file, notes, progress, options, shared_ptr<MXFStream>(), timer);
 	}
-	stage ("Checking picture frame sizes", asset->file());
-	verify_picture_asset (reel_asset, file, notes, progress);
 
 	/* Only flat/scope allowed by Bv2.1 */
 	if (
@@ -569,11 +925,14 @@ verify_main_sound_asset (
 	shared_ptr<const ReelSoundAsset> reel_asset,
 	function<void (string, optional<boost::filesystem::path>)> stage,
 	function<void (float)> progress,
-	vector<VerificationNote>& notes
+	vector<VerificationNote>& notes,
+	StageTimer& timer
 	)
 {
 	auto asset = reel_asset->asset();
 	stage ("Checking sound asset hash", asset->file());
+	timer.add_bytes (bytes_to_hash(*asset->file()));
+	timer.add_frames (asset->intrinsic_duration());
 	auto const r = verify_asset (dcp, reel_asset, progress);
 	switch (r) {
 		case VerifyAssetResult::BAD:
@@ -726,7 +1085,8 @@ verify_subtitle_asset (
 	function<void (string, optional<boost::filesystem::path>)> stage,
 	boost::filesystem::path xsd_dtd_directory,
 	vector<VerificationNote>& notes,
-	State& state
+	State& state,
+	StageTimer& timer
 	)
 {
 	stage ("Checking subtitle XML", asset->file());
@@ -734,6 +1094,7 @@ verify_subtitle_asset (
 	 * gets passed through libdcp which may clean up and therefore hide errors.
 	 */
 	if (asset->raw_xml()) {
+		timer.add_bytes (asset->raw_xml()->size());
 		validate_xml (asset->raw_xml().get(), xsd_dtd_directory, notes);
 	} else {
 		notes.push_back ({VerificationNote::Type::WARNING, VerificationNote::Code::MISSED_CHECK_OF_ENCRYPTED});
@@ -754,7 +1115,8 @@ verify_closed_caption_asset (
 	optional<int64_t> reel_asset_duration,
 	function<void (string, optional<boost::filesystem::path>)> stage,
 	boost::filesystem::path xsd_dtd_directory,
-	vector<VerificationNote>& notes
+	vector<VerificationNote>& notes,
+	StageTimer& timer
 	)
 {
 	stage ("Checking closed caption XML", asset->file());
@@ -763,6 +1125,7 @@ verify_closed_caption_asset (
 	 */
 	auto raw_xml = asset->raw_xml();
 	if (raw_xml) {
+		timer.add_bytes (raw_xml->size());
 		validate_xml (*raw_xml, xsd_dtd_directory, notes);
 		if (raw_xml->size() > 256 * 1024) {
 			notes.push_back ({VerificationNote::Type::BV21_ERROR, VerificationNote::Code::INVALID_CLOSED_CAPTION_XML_SIZE_IN_BYTES, raw_convert<string>(raw_xml->size()), *asset->file()});
@@ -1151,11 +1514,20 @@ pkl_has_encrypted_assets (shared_ptr<DCP> dcp, shared_ptr<PKL> pkl)
 vector<VerificationNote>
 dcp::verify (
 	vector<boost::filesystem::path> directories,
-	function<void (string, optional<boost::filesystem::path>)> stage,
+	function<void (string, optional<boost::filesystem::path>)> report_stage,
 	function<void (float)> progress,
-	optional<boost::filesystem::path> xsd_dtd_directory
+	optional<boost::filesystem::path> xsd_dtd_directory,
+	VerificationOptions options
 	)
 {
+	StageTimer timer (options.timing);
+	auto stage = [&timer, report_stage](string name, optional<boost::filesystem::path> file) {
+		timer.start (name, file);
+		if (report_stage) {
+			report_stage (name, file);
+		}
+	};
+
 	if (!xsd_dtd_directory) {
 		xsd_dtd_directory = resources_directory() / "xsd";
 	}
@@ -1191,12 +1563,17 @@ dcp::verify (
 			continue;
 		}
 
+		for (auto const& kdm: options.kdms) {
+			dcp->add (kdm);
+		}
+
 		if (dcp->standard() != Standard::SMPTE) {
 			notes.push_back ({VerificationNote::Type::BV21_ERROR, VerificationNote::Code::INVALID_STANDARD});
 		}
 
 		for (auto cpl: dcp->cpls()) {
 			stage ("Checking CPL", cpl->file());
+			timer.add_bytes (boost::filesystem::file_size(cpl->file().get()));
 			validate_xml (cpl->file().get(), *xsd_dtd_directory, notes);
 
 			if (cpl->any_encrypted() && !cpl->all_encrypted()) {
@@ -1315,18 +1692,18 @@ dcp::verify (
 					}
 					/* Check asset */
 					if (reel->main_picture()->asset_ref().resolved()) {
-						verify_main_picture_asset (dcp, reel->main_picture(), stage, progress, notes);
+						verify_main_picture_asset (dcp, reel->main_picture(), stage, progress, options, notes, timer);
 					}
 				}
 
 				if (reel->main_sound() && reel->main_sound()->asset_ref().resolved()) {
-					verify_main_sound_asset (dcp, reel->main_sound(), stage, progress, notes);
+					verify_main_sound_asset (dcp, reel->main_sound(), stage, progress, notes, timer);
 				}
 
 				if (reel->main_subtitle()) {
 					verify_main_subtitle_reel (reel->main_subtitle(), notes);
 					if (reel->main_subtitle()->asset_ref().resolved()) {
-						verify_subtitle_asset (reel->main_subtitle()->asset(), reel->main_subtitle()->duration(), stage, *xsd_dtd_directory, notes, state);
+						verify_subtitle_asset (reel->main_subtitle()->asset(), reel->main_subtitle()->duration(), stage, *xsd_dtd_directory, notes, state, timer);
 					}
 					have_main_subtitle = true;
 				} else {
@@ -1336,7 +1713,7 @@ dcp::verify (
 				for (auto i: reel->closed_captions()) {
 					verify_closed_caption_reel (i, notes);
 					if (i->asset_ref().resolved()) {
-						verify_closed_caption_asset (i->asset(), i->duration(), stage, *xsd_dtd_directory, notes);
+						verify_closed_caption_asset (i->asset(), i->duration(), stage, *xsd_dtd_directory, notes, timer);
 					}
 				}
 
@@ -1444,6 +1821,7 @@ dcp::verify (
 
 		for (auto pkl: dcp->pkls()) {
 			stage ("Checking PKL", pkl->file());
+			timer.add_bytes (boost::filesystem::file_size(pkl->file().get()));
 			validate_xml (pkl->file().get(), *xsd_dtd_directory, notes);
 			if (pkl_has_encrypted_assets(dcp, pkl)) {
 				cxml::Document doc ("PackingList");
@@ -1456,12 +1834,15 @@ dcp::verify (
 
 		if (dcp->asset_map_path()) {
 			stage ("Checking ASSETMAP", dcp->asset_map_path().get());
+			timer.add_bytes (boost::filesystem::file_size(dcp->asset_map_path().get()));
 			validate_xml (dcp->asset_map_path().get(), *xsd_dtd_directory, notes);
 		} else {
 			notes.push_back ({VerificationNote::Type::ERROR, VerificationNote::Code::MISSING_ASSETMAP});
 		}
 	}
 
+	timer.finish ();
+
 	return notes;
 }
 
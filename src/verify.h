@@ -41,9 +41,11 @@
 #define LIBDCP_VERIFY_H
 
 
+#include "decrypted_kdm.h"
 #include <boost/filesystem.hpp>
 #include <boost/function.hpp>
 #include <boost/optional.hpp>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -449,13 +451,58 @@ private:
 };
 
 
+/** Time taken by one stage of a verification, as given to VerificationOptions::timing */
+struct VerificationTiming
+{
+	/** Stage name, as given to verify()'s stage function */
+	std::string stage;
+	/** File that the stage was working on, if any */
+	boost::optional<boost::filesystem::path> file;
+	/** Wall-clock time taken by the stage */
+	double seconds = 0;
+	/** Number of bytes that the stage read from disk (or, for picture frames, from their MXF) */
+	int64_t bytes = 0;
+	/** Number of picture or sound frames that the stage processed */
+	int64_t frames = 0;
+};
+
+
+struct VerificationOptions
+{
+	/** Number of threads to use to check the JPEG2000 codestreams of picture frames.
+	 *  If this is 1 all checks are done on the calling thread.
+	 */
+	int threads = 1;
+
+	/** KDMs to decrypt assets with, so that their frames can be checked.  Frames of encrypted
+	 *  assets are decrypted (and have their HMACs checked) on as many threads as are given
+	 *  in `threads'.
+	 */
+	std::vector<DecryptedKDM> kdms;
+
+	/** If set, this is called (on the thread that called verify()) as each stage finishes,
+	 *  with how long it took and how much it read.
+	 */
+	boost::function<void (VerificationTiming const&)> timing;
+};
+
+
 std::vector<VerificationNote> verify (
 	std::vector<boost::filesystem::path> directories,
 	boost::function<void (std::string, boost::optional<boost::filesystem::path>)> stage,
 	boost::function<void (float)> progress,
-	boost::optional<boost::filesystem::path> xsd_dtd_directory = boost::optional<boost::filesystem::path>()
+	boost::optional<boost::filesystem::path> xsd_dtd_directory = boost::optional<boost::filesystem::path>(),
+	VerificationOptions options = VerificationOptions()
 	);
 
+/** @return size in bytes of the biggest picture frame (or eye of a 3D frame) that Bv2.1 allows at
+ *  the given edit rate; anything bigger gives INVALID_PICTURE_FRAME_SIZE_IN_BYTES.
+ */
+int max_picture_frame_size (Fraction edit_rate);
+
+/** @return size in bytes above which a picture frame gives NEARLY_INVALID_PICTURE_FRAME_SIZE_IN_BYTES */
+int risky_picture_frame_size (Fraction edit_rate);
+
 std::string note_to_string (dcp::VerificationNote note);
 
 bool operator== (dcp::VerificationNote const& a, dcp::VerificationNote const& b);
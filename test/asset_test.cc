@@ -33,8 +33,25 @@
 
 
 #include "asset.h"
+#include "frame.h"
+#include "crypto_context.h"
+#include "exceptions.h"
+#include "j2k_transcode.h"
+#include "key.h"
+#include "mapped_mxf.h"
+#include "mono_picture_asset.h"
+#include "mono_picture_asset_reader.h"
+#include "mono_picture_asset_writer.h"
+#include "mono_picture_frame.h"
+#include "sound_asset.h"
+#include "sound_asset_reader.h"
+#include "sound_asset_writer.h"
+#include "test.h"
+#include "util.h"
+#include <asdcp/AS_DCP.h>
 #include <boost/bind.hpp>
 #include <boost/test/unit_test.hpp>
+#include <algorithm>
 
 
 using std::string;
@@ -69,3 +86,452 @@ BOOST_AUTO_TEST_CASE (asset_test)
 	b->_file = "foo/bar/baz";
 	BOOST_CHECK (a->equals(b, dcp::EqualityOptions(), ignore));
 }
+
+
+/** Check that AssetReader re-uses a frame's buffer only when nobody else is holding the frame */
+BOOST_AUTO_TEST_CASE (asset_reader_frame_reuse_test)
+{
+	dcp::MonoPictureAsset asset ("test/ref/DCP/dcp_test1/video.mxf");
+	auto reader = asset.start_read ();
+
+	auto check = [&asset](shared_ptr<const dcp::MonoPictureFrame> frame, int n) {
+		auto ref = asset.start_read()->get_frame(n);
+		BOOST_REQUIRE_EQUAL (frame->size(), ref->size());
+		BOOST_CHECK (memcmp(frame->data(), ref->data(), ref->size()) == 0);
+	};
+
+	auto frame = reader->get_frame (0);
+	auto const first = frame.get ();
+	check (frame, 0);
+	frame.reset ();
+
+	for (int i = 1; i < asset.intrinsic_duration(); ++i) {
+		frame = reader->get_frame (i);
+		BOOST_CHECK (frame.get() == first);
+		check (frame, i);
+		frame.reset ();
+	}
+
+	auto held = reader->get_frame (3);
+	auto held_data = held->data ();
+	auto other = reader->get_frame (4);
+	BOOST_CHECK (other != held);
+	BOOST_CHECK (held->data() == held_data);
+	check (held, 3);
+	check (other, 4);
+}
+
+
+/** Check that frames read with read-ahead enabled are the same as those read without it */
+BOOST_AUTO_TEST_CASE (asset_reader_read_ahead_test)
+{
+	dcp::MonoPictureAsset asset ("test/ref/DCP/dcp_test1/video.mxf");
+	auto reader = asset.start_read ();
+	reader->set_read_ahead (4);
+
+	auto check = [&asset](shared_ptr<const dcp::MonoPictureFrame> frame, int n) {
+		auto ref = asset.start_read()->get_frame(n);
+		BOOST_REQUIRE_EQUAL (frame->size(), ref->size());
+		BOOST_CHECK (memcmp(frame->data(), ref->data(), ref->size()) == 0);
+	};
+
+	for (int i = 0; i < asset.intrinsic_duration(); ++i) {
+		check (reader->get_frame(i), i);
+	}
+
+	/* Random access should still work */
+	check (reader->get_frame(3), 3);
+	check (reader->get_frame(17), 17);
+	check (reader->get_frame(16), 16);
+
+	BOOST_CHECK_THROW (reader->get_frame(asset.intrinsic_duration() + 10), dcp::ReadError);
+
+	reader->set_read_ahead (0);
+	check (reader->get_frame(5), 5);
+}
+
+
+/** Check that read-ahead with a window which runs past the end of the asset stops at the end */
+BOOST_AUTO_TEST_CASE (asset_reader_read_ahead_end_test)
+{
+	dcp::MonoPictureAsset asset ("test/ref/DCP/dcp_test1/video.mxf");
+	auto const frames = static_cast<int>(asset.intrinsic_duration());
+	auto reader = asset.start_read ();
+	reader->set_read_ahead (frames * 2);
+
+	for (int i = frames - 3; i < frames; ++i) {
+		auto frame = reader->get_frame (i);
+		auto ref = asset.start_read()->get_frame(i);
+		BOOST_REQUIRE_EQUAL (frame->size(), ref->size());
+		BOOST_CHECK (memcmp(frame->data(), ref->data(), ref->size()) == 0);
+	}
+
+	BOOST_CHECK_THROW (reader->get_frame(frames), dcp::ReadError);
+	BOOST_CHECK_THROW (reader->get_frame(-1), dcp::ReadError);
+	BOOST_CHECK_EQUAL (reader->get_frame(0)->size(), asset.start_read()->get_frame(0)->size());
+}
+
+
+/** Check that MappedMXF gives the same frames as an AssetReader */
+BOOST_AUTO_TEST_CASE (mapped_mxf_test)
+{
+	dcp::MonoPictureAsset asset ("test/ref/DCP/dcp_test1/video.mxf");
+	dcp::MappedMXF mapped (&asset);
+	BOOST_REQUIRE_EQUAL (mapped.frames(), asset.intrinsic_duration());
+
+	auto reader = asset.start_read ();
+	for (int i = 0; i < asset.intrinsic_duration(); ++i) {
+		auto frame = mapped.get_frame (i);
+		auto ref = reader->get_frame (i);
+		BOOST_REQUIRE_EQUAL (frame->size(), ref->size());
+		BOOST_CHECK (memcmp(frame->data(), ref->data(), ref->size()) == 0);
+	}
+
+	BOOST_CHECK_THROW (mapped.get_frame(asset.intrinsic_duration()), dcp::ReadError);
+}
+
+
+/** Check that MappedMXF finds the essence of assets written for both standards, whose partitions are laid out differently */
+BOOST_AUTO_TEST_CASE (mapped_mxf_standards_test)
+{
+	boost::filesystem::path const dir = "build/test/mapped_mxf_standards_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+
+	auto j2c = dcp::ArrayData ("test/data/flat_red.j2c");
+
+	for (auto standard: { dcp::Standard::INTEROP, dcp::Standard::SMPTE }) {
+		auto picture = make_shared<dcp::MonoPictureAsset>(dcp::Fraction(24, 1), standard);
+		auto writer = picture->start_write (dir / (standard == dcp::Standard::SMPTE ? "smpte.mxf" : "interop.mxf"), false);
+		for (int i = 0; i < 5; ++i) {
+			writer->write (j2c);
+		}
+		writer->finalize ();
+
+		dcp::MappedMXF mapped (picture.get());
+		BOOST_REQUIRE_EQUAL (mapped.frames(), 5);
+		for (int i = 0; i < 5; ++i) {
+			auto frame = mapped.get_frame (i);
+			BOOST_REQUIRE_EQUAL (frame->size(), j2c.size());
+			BOOST_CHECK (memcmp(frame->data(), j2c.data(), j2c.size()) == 0);
+		}
+	}
+}
+
+
+/** Check that writers can hash their files when they finalize, so that Asset::hash() need not read them again */
+BOOST_AUTO_TEST_CASE (asset_writer_hash_test)
+{
+	boost::filesystem::path const dir = "build/test/asset_writer_hash_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+
+	auto j2c = dcp::ArrayData ("test/data/flat_red.j2c");
+
+	auto write = [dir, &j2c](string name, bool hash, boost::function<void (float)> progress) {
+		auto picture = make_shared<dcp::MonoPictureAsset>(dcp::Fraction(24, 1), dcp::Standard::SMPTE);
+		auto writer = picture->start_write (dir / name, false);
+		if (hash) {
+			writer->set_hash_on_finalize (progress);
+		}
+		for (int i = 0; i < 24; ++i) {
+			writer->write (j2c);
+		}
+		writer->finalize ();
+		return picture;
+	};
+
+	int calls = 0;
+	auto hashed = write ("hashed.mxf", true, [&calls](float) { ++calls; });
+	BOOST_CHECK (calls > 0);
+	auto const digest = dcp::make_digest (*hashed->file(), {});
+	boost::filesystem::remove (*hashed->file());
+	BOOST_CHECK_EQUAL (hashed->hash(), digest);
+
+	/* Without set_hash_on_finalize() the file must still be there to be hashed */
+	auto unhashed = write ("unhashed.mxf", false, {});
+	boost::filesystem::remove (*unhashed->file());
+	BOOST_CHECK_THROW (unhashed->hash(), dcp::FileError);
+
+	/* Throwing from the progress callback cancels the hash but not the write */
+	auto picture = make_shared<dcp::MonoPictureAsset>(dcp::Fraction(24, 1), dcp::Standard::SMPTE);
+	auto writer = picture->start_write (dir / "cancelled.mxf", false);
+	writer->set_hash_on_finalize ([](float) { throw std::runtime_error("cancelled"); });
+	writer->write (j2c);
+	BOOST_CHECK_THROW (writer->finalize(), std::runtime_error);
+	BOOST_CHECK_EQUAL (dcp::MonoPictureAsset(dir / "cancelled.mxf").intrinsic_duration(), 1);
+}
+
+
+/** Check that frames written with write-behind end up the same as those written directly */
+BOOST_AUTO_TEST_CASE (asset_writer_write_behind_test)
+{
+	boost::filesystem::path const dir = "build/test/asset_writer_write_behind_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+
+	int const frames = 16;
+	auto j2c = make_shared<dcp::ArrayData>("test/data/flat_red.j2c");
+
+	dcp::MonoPictureAsset direct_picture (dcp::Fraction(24, 1), dcp::Standard::SMPTE);
+	auto direct_writer = direct_picture.start_write (dir / "direct.mxf", false);
+	std::vector<dcp::FrameInfo> direct_info;
+	for (int i = 0; i < frames; ++i) {
+		direct_info.push_back (direct_writer->write(*j2c));
+	}
+	direct_writer->finalize ();
+
+	dcp::MonoPictureAsset behind_picture (dcp::Fraction(24, 1), dcp::Standard::SMPTE);
+	auto behind_writer = behind_picture.start_write (dir / "behind.mxf", false);
+	behind_writer->set_write_behind (2);
+	std::vector<std::future<dcp::FrameInfo>> behind_info;
+	std::vector<dcp::FrameInfo> callback_info;
+	for (int i = 0; i < frames; ++i) {
+		if (i % 2) {
+			behind_info.push_back (behind_writer->write_async(j2c));
+		} else {
+			behind_writer->write_async (j2c, [&callback_info](dcp::FrameInfo info) { callback_info.push_back(info); });
+		}
+	}
+	behind_writer->finalize ();
+
+	BOOST_CHECK_EQUAL (behind_picture.intrinsic_duration(), frames);
+	BOOST_REQUIRE_EQUAL (callback_info.size(), frames / 2);
+	for (int i = 0; i < frames; ++i) {
+		auto info = (i % 2) ? behind_info[i / 2].get() : callback_info[i / 2];
+		BOOST_CHECK_EQUAL (info.offset, direct_info[i].offset);
+		BOOST_CHECK_EQUAL (info.size, direct_info[i].size);
+		BOOST_CHECK_EQUAL (info.hash, direct_info[i].hash);
+	}
+
+	auto reader = behind_picture.start_read ();
+	for (int i = 0; i < frames; ++i) {
+		auto frame = reader->get_frame (i);
+		BOOST_REQUIRE_EQUAL (frame->size(), j2c->size());
+		BOOST_CHECK (memcmp(frame->data(), j2c->data(), j2c->size()) == 0);
+	}
+
+	int const channels = 6;
+	int const samples = 2000;
+	std::vector<float> ramp (samples);
+	for (int i = 0; i < samples; ++i) {
+		ramp[i] = i / 4000.0;
+	}
+	float const* data[channels];
+	for (int i = 0; i < channels; ++i) {
+		data[i] = ramp.data();
+	}
+
+	dcp::SoundAsset direct_sound (dcp::Fraction(24, 1), 48000, channels, dcp::LanguageTag("en-GB"), dcp::Standard::SMPTE);
+	auto direct_sound_writer = direct_sound.start_write (dir / "direct_audio.mxf");
+	dcp::SoundAsset behind_sound (dcp::Fraction(24, 1), 48000, channels, dcp::LanguageTag("en-GB"), dcp::Standard::SMPTE);
+	auto behind_sound_writer = behind_sound.start_write (dir / "behind_audio.mxf");
+	behind_sound_writer->set_write_behind (4);
+	for (int i = 0; i < 24; ++i) {
+		direct_sound_writer->write (data, samples);
+		behind_sound_writer->write (data, samples);
+	}
+	direct_sound_writer->finalize ();
+	behind_sound_writer->finalize ();
+
+	BOOST_REQUIRE_EQUAL (behind_sound.intrinsic_duration(), direct_sound.intrinsic_duration());
+	auto direct_reader = direct_sound.start_read ();
+	auto behind_reader = behind_sound.start_read ();
+	for (int i = 0; i < direct_sound.intrinsic_duration(); ++i) {
+		auto a = direct_reader->get_frame (i);
+		auto b = behind_reader->get_frame (i);
+		BOOST_REQUIRE_EQUAL (a->size(), b->size());
+		BOOST_CHECK (memcmp(a->data(), b->data(), a->size()) == 0);
+	}
+}
+
+
+/** Check that write-behind writers report bad arguments to the caller, and that write_async()
+ *  delivers errors through its future when there is no write-behind.
+ */
+BOOST_AUTO_TEST_CASE (asset_writer_write_behind_errors_test)
+{
+	boost::filesystem::path const dir = "build/test/asset_writer_write_behind_errors_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+
+	auto j2c = make_shared<dcp::ArrayData>("test/data/flat_red.j2c");
+	auto junk = make_shared<dcp::ArrayData>(j2c->size());
+	memset (junk->data(), 0, junk->size());
+
+	dcp::MonoPictureAsset direct_picture (dcp::Fraction(24, 1), dcp::Standard::SMPTE);
+	auto direct_writer = direct_picture.start_write (dir / "direct.mxf", false);
+	BOOST_CHECK_EQUAL (direct_writer->write_async(j2c).get().size, direct_writer->write(*j2c).size);
+	auto failed = direct_writer->write_async (junk);
+	BOOST_CHECK_THROW (failed.get(), dcp::MiscError);
+	direct_writer->finalize ();
+
+	dcp::MonoPictureAsset behind_picture (dcp::Fraction(24, 1), dcp::Standard::SMPTE);
+	auto behind_writer = behind_picture.start_write (dir / "behind.mxf", false);
+	behind_writer->set_write_behind (2);
+	BOOST_CHECK_THROW (behind_writer->write_async(shared_ptr<dcp::Data>()), dcp::ProgrammingError);
+	behind_writer->write_async (j2c).get ();
+	behind_writer->finalize ();
+	BOOST_CHECK_THROW (behind_writer->write_async(j2c), dcp::ProgrammingError);
+
+	dcp::SoundAsset sound (dcp::Fraction(24, 1), 48000, 6, dcp::LanguageTag("en-GB"), dcp::Standard::SMPTE);
+	auto sound_writer = sound.start_write (dir / "audio.mxf");
+	sound_writer->set_write_behind (2);
+	float const* data[6] = {};
+	BOOST_CHECK_THROW (sound_writer->write(data, 0), dcp::ProgrammingError);
+	uint8_t pcm[16] = {};
+	BOOST_CHECK_THROW (sound_writer->write(pcm, sizeof(pcm)), dcp::ProgrammingError);
+}
+
+
+/** Check that an error from a queued write comes out of the next write_async() or finalize() */
+BOOST_AUTO_TEST_CASE (asset_writer_write_behind_queued_error_test)
+{
+	boost::filesystem::path const dir = "build/test/asset_writer_write_behind_queued_error_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+
+	auto j2c = make_shared<dcp::ArrayData>("test/data/flat_red.j2c");
+	auto junk = make_shared<dcp::ArrayData>(j2c->size());
+	memset (junk->data(), 0, junk->size());
+
+	/* With a queue of 1 the second write_async() after the junk cannot be queued until the
+	 * junk has failed, so one of the two must throw the junk's error.
+	 */
+	dcp::MonoPictureAsset picture (dcp::Fraction(24, 1), dcp::Standard::SMPTE);
+	auto writer = picture.start_write (dir / "write.mxf", false);
+	writer->set_write_behind (1);
+	writer->write_async (j2c).get ();
+	auto failed = writer->write_async (junk);
+	bool thrown = false;
+	try {
+		writer->write_async (j2c);
+		writer->write_async (j2c);
+	} catch (dcp::MiscError&) {
+		thrown = true;
+	}
+	BOOST_CHECK (thrown);
+	BOOST_CHECK_THROW (failed.get(), dcp::MiscError);
+
+	/* The error has been reported, so the writer can carry on */
+	writer->write_async (j2c).get ();
+	writer->finalize ();
+
+	/* An error which no write_async() has reported comes out of finalize() */
+	dcp::MonoPictureAsset finalized_picture (dcp::Fraction(24, 1), dcp::Standard::SMPTE);
+	auto finalized_writer = finalized_picture.start_write (dir / "finalize.mxf", false);
+	finalized_writer->set_write_behind (2);
+	finalized_writer->write_async (j2c, {});
+	bool called = false;
+	finalized_writer->write_async (junk, [&called](dcp::FrameInfo) { called = true; });
+	BOOST_CHECK_THROW (finalized_writer->finalize(), dcp::MiscError);
+	BOOST_CHECK (!called);
+}
+
+
+/** Check that picture asset writers refuse frames which are not codestreams of the asset's size */
+BOOST_AUTO_TEST_CASE (picture_asset_writer_frame_check_test)
+{
+	boost::filesystem::path const dir = "build/test/picture_asset_writer_frame_check_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+
+	dcp::ArrayData j2c ("test/data/flat_red.j2c");
+	dcp::MonoPictureAsset picture (dcp::Fraction(24, 1), dcp::Standard::SMPTE);
+	auto writer = picture.start_write (dir / "video.mxf", false);
+	writer->write (j2c);
+
+	dcp::ArrayData garbage (j2c.size());
+	memset (garbage.data(), 0, garbage.size());
+	BOOST_CHECK_THROW (writer->write(garbage), dcp::MiscError);
+
+	auto wrong_size = dcp::compress_j2k (black_image(dcp::Size(2048, 858)), 100000000, 24, false, false);
+	BOOST_CHECK_THROW (writer->write(wrong_size), dcp::MiscError);
+
+	writer->write (j2c);
+	writer->finalize ();
+	BOOST_CHECK_EQUAL (picture.intrinsic_duration(), 2);
+}
+
+
+/** Check that an encrypted frame written from the caller's buffer leaves the same J2K headers in the
+ *  clear as one which has been through JP2K::CodestreamParser::OpenReadFrame().
+ */
+BOOST_AUTO_TEST_CASE (picture_asset_writer_plaintext_offset_test)
+{
+	boost::filesystem::path const dir = "build/test/picture_asset_writer_plaintext_offset_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+
+	dcp::ArrayData j2c ("test/data/flat_red.j2c");
+	dcp::Key key;
+
+	dcp::MonoPictureAsset picture (dcp::Fraction(24, 1), dcp::Standard::SMPTE);
+	picture.set_key (key);
+	auto writer = picture.start_write (dir / "wrapped.mxf", false);
+	writer->write (j2c);
+	writer->finalize ();
+
+	/* Write the same frame with asdcplib's parser, using the same writer info */
+	ASDCP::JP2K::MXFReader wrapped_reader;
+	BOOST_REQUIRE (!ASDCP_FAILURE(wrapped_reader.OpenRead((dir / "wrapped.mxf").string().c_str())));
+	ASDCP::WriterInfo info;
+	wrapped_reader.FillWriterInfo (info);
+
+	ASDCP::JP2K::CodestreamParser parser;
+	ASDCP::JP2K::FrameBuffer parsed (j2c.size());
+	BOOST_REQUIRE (!ASDCP_FAILURE(parser.OpenReadFrame(j2c.data(), j2c.size(), parsed)));
+	ASDCP::JP2K::PictureDescriptor descriptor;
+	parser.FillPictureDescriptor (descriptor);
+	descriptor.EditRate = ASDCP::Rational (24, 1);
+
+	dcp::EncryptionContext context (key, dcp::Standard::SMPTE);
+	ASDCP::JP2K::MXFWriter parsed_writer;
+	BOOST_REQUIRE (!ASDCP_FAILURE(parsed_writer.OpenWrite((dir / "parsed.mxf").string().c_str(), info, descriptor, 16384, false)));
+	BOOST_REQUIRE (!ASDCP_FAILURE(parsed_writer.WriteFrame(parsed, context.context(), context.hmac())));
+	BOOST_REQUIRE (!ASDCP_FAILURE(parsed_writer.Finalize()));
+
+	ASDCP::JP2K::MXFReader parsed_reader;
+	BOOST_REQUIRE (!ASDCP_FAILURE(parsed_reader.OpenRead((dir / "parsed.mxf").string().c_str())));
+
+	/* Without a decryption context asdcplib gives us the encrypted frame and its plaintext offset */
+	ASDCP::JP2K::FrameBuffer wrapped_frame (j2c.size() * 2);
+	BOOST_REQUIRE (!ASDCP_FAILURE(wrapped_reader.ReadFrame(0, wrapped_frame)));
+	ASDCP::JP2K::FrameBuffer parsed_frame (j2c.size() * 2);
+	BOOST_REQUIRE (!ASDCP_FAILURE(parsed_reader.ReadFrame(0, parsed_frame)));
+
+	BOOST_CHECK (parsed_frame.PlaintextOffset() > 0);
+	BOOST_CHECK_EQUAL (wrapped_frame.PlaintextOffset(), parsed_frame.PlaintextOffset());
+
+	/* and the headers should be there in the clear, in the same place */
+	auto find = [&j2c](ASDCP::JP2K::FrameBuffer const& frame) {
+		auto const clear = frame.PlaintextOffset();
+		auto i = std::search (frame.RoData(), frame.RoData() + frame.Size(), j2c.data(), j2c.data() + clear);
+		return i == frame.RoData() + frame.Size() ? -1 : i - frame.RoData();
+	};
+	BOOST_CHECK (find(parsed_frame) >= 0);
+	BOOST_CHECK_EQUAL (find(wrapped_frame), find(parsed_frame));
+}
+
+
+/** Check that the frame sizes which read_frame() takes from the index are enough for each frame,
+ *  without being much bigger, and that the last frame (which has no following entry) gives none.
+ */
+BOOST_AUTO_TEST_CASE (frame_size_from_index_test)
+{
+	dcp::MonoPictureAsset asset ("test/ref/DCP/dcp_test1/video.mxf");
+	auto reader = asset.start_read ();
+
+	auto const frames = asset.intrinsic_duration ();
+	BOOST_REQUIRE (frames > 1);
+	for (int i = 0; i < frames - 1; ++i) {
+		auto const indexed = dcp::frame_size_from_index (reader->reader(), i);
+		auto const frame = reader->get_frame (i);
+		BOOST_CHECK (indexed >= frame->size());
+		/* Just the KLV key and length */
+		BOOST_CHECK (indexed <= frame->size() + 64);
+	}
+
+	BOOST_CHECK_EQUAL (dcp::frame_size_from_index(reader->reader(), frames - 1), 0);
+	BOOST_CHECK (reader->get_frame(frames - 1)->size() > 0);
+}
@@ -36,6 +36,8 @@
 #include "modified_gamma_transfer_function.h"
 #include <boost/test/unit_test.hpp>
 #include <cmath>
+#include <thread>
+#include <vector>
 
 using std::pow;
 using std::shared_ptr;
@@ -154,3 +156,37 @@ BOOST_AUTO_TEST_CASE (colour_conversion_bradford_test)
 	BOOST_CHECK_CLOSE (b(2, 1), 0.0119945, 0.1);
 	BOOST_CHECK_CLOSE (b(2, 2), 0.7785377, 0.1);
 }
+
+/** Check that LUTs asked for on several threads at once are made once, and that float LUTs match the double ones */
+BOOST_AUTO_TEST_CASE (transfer_function_lut_threads_test)
+{
+	auto tf = std::make_shared<GammaTransferFunction>(2.6);
+
+	std::vector<double const *> luts (8);
+	std::vector<float const *> float_luts (8);
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 8; ++i) {
+		threads.push_back (std::thread([tf, i, &luts, &float_luts]() {
+			float_luts[i] = tf->float_lut (12, i % 2);
+			luts[i] = tf->lut (12, i % 2);
+		}));
+	}
+	for (auto& i: threads) {
+		i.join ();
+	}
+
+	for (int i = 0; i < 8; ++i) {
+		BOOST_CHECK (luts[i] == tf->lut(12, i % 2));
+		BOOST_CHECK (float_luts[i] == tf->float_lut(12, i % 2));
+	}
+
+	BOOST_CHECK (tf->lut(12, false) != tf->lut(12, true));
+
+	for (auto inverse: { false, true }) {
+		auto lut = tf->lut (12, inverse);
+		auto float_lut = tf->float_lut (12, inverse);
+		for (int i = 0; i < 4096; ++i) {
+			BOOST_REQUIRE_EQUAL (float_lut[i], static_cast<float>(lut[i]));
+		}
+	}
+}
@@ -0,0 +1,126 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+#include "array_data.h"
+#include "digest_cache.h"
+#include "exceptions.h"
+#include "util.h"
+#include <boost/algorithm/string.hpp>
+#include <boost/test/unit_test.hpp>
+#include <ctime>
+
+
+using std::make_shared;
+using std::string;
+
+
+static void
+write_file (boost::filesystem::path path, string contents, std::time_t modified)
+{
+	dcp::ArrayData (reinterpret_cast<uint8_t const*>(contents.c_str()), contents.size()).write (path);
+	boost::filesystem::last_write_time (path, modified);
+}
+
+
+/** Check that digests are stored, persisted, invalidated and trusted (or not) as they should be */
+BOOST_AUTO_TEST_CASE (digest_cache_test)
+{
+	boost::filesystem::path const dir = "build/test/digest_cache_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+
+	auto const file = dir / "file";
+	auto const cache_file = dir / "cache";
+	/* Far enough in the past that the file will be thought to have settled */
+	auto const modified = std::time(nullptr) - 60;
+
+	write_file (file, "hello", modified);
+	auto const hello_digest = dcp::make_digest (file, {});
+
+	auto cache = make_shared<dcp::DigestCache>(cache_file, dcp::DigestCache::Policy::TRUST);
+	dcp::set_digest_cache (cache);
+	BOOST_CHECK_EQUAL (dcp::make_digest(file, {}), hello_digest);
+	BOOST_REQUIRE (cache->get(file));
+	BOOST_CHECK_EQUAL (*cache->get(file), hello_digest);
+
+	/* The digest should be read back from disk once it has been flushed */
+	BOOST_CHECK (!dcp::DigestCache(cache_file, dcp::DigestCache::Policy::TRUST).get(file));
+	cache->flush ();
+	BOOST_CHECK_EQUAL (dcp::DigestCache(cache_file, dcp::DigestCache::Policy::TRUST).get(file).get_value_or(""), hello_digest);
+
+	/* Changing the file without changing its size or modification time should still invalidate the entry */
+	write_file (file, "jello", modified);
+	BOOST_CHECK (!cache->get(file));
+	auto const jello_digest = dcp::make_digest (file, {});
+	BOOST_CHECK (jello_digest != hello_digest);
+	BOOST_CHECK_EQUAL (cache->get(file).get_value_or(""), jello_digest);
+
+	/* Tamper with the cached digest; a trusting cache will believe it but a verifying one will not */
+	cache->flush ();
+	auto contents = dcp::file_to_string (cache_file);
+	boost::algorithm::replace_all (contents, jello_digest, "wrong");
+	dcp::ArrayData (reinterpret_cast<uint8_t const*>(contents.c_str()), contents.size()).write (cache_file);
+
+	dcp::set_digest_cache (make_shared<dcp::DigestCache>(cache_file, dcp::DigestCache::Policy::TRUST));
+	BOOST_CHECK_EQUAL (dcp::make_digest(file, {}), "wrong");
+
+	cache = make_shared<dcp::DigestCache>(cache_file, dcp::DigestCache::Policy::VERIFY);
+	dcp::set_digest_cache (cache);
+	BOOST_CHECK (cache->mismatches().empty());
+	BOOST_CHECK_EQUAL (dcp::make_digest(file, {}), jello_digest);
+	BOOST_CHECK_EQUAL (cache->get(file).get_value_or(""), jello_digest);
+	BOOST_REQUIRE_EQUAL (cache->mismatches().size(), 1U);
+	BOOST_CHECK (cache->mismatches()[0] == boost::filesystem::canonical(file));
+	/* Now that the cache is right, hashing again is not a mismatch */
+	BOOST_CHECK (cache->put(file, jello_digest));
+	BOOST_CHECK_EQUAL (cache->mismatches().size(), 1U);
+
+	/* Files which have only just been modified are not cached */
+	write_file (file, "fresh", std::time(nullptr));
+	dcp::make_digest (file, {});
+	BOOST_CHECK (!cache->get(file));
+
+	/* Failing to write the cache is only an error if we ask for it to be flushed */
+	write_file (file, "hello", modified);
+	{
+		auto unwritable = make_shared<dcp::DigestCache>(dir / "missing" / "cache", dcp::DigestCache::Policy::TRUST);
+		dcp::set_digest_cache (unwritable);
+		BOOST_CHECK_EQUAL (dcp::make_digest(file, {}), hello_digest);
+		BOOST_CHECK_THROW (unwritable->flush(), dcp::FileError);
+		dcp::set_digest_cache (nullptr);
+	}
+
+	dcp::set_digest_cache (nullptr);
+}
@@ -0,0 +1,207 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+#include "frame_buffer_pool.h"
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+using std::shared_ptr;
+using std::make_shared;
+
+
+BOOST_AUTO_TEST_CASE (frame_buffer_pool_reuse_test)
+{
+	dcp::FrameBufferPool pool (1024 * 1024);
+
+	auto a = pool.get (1000);
+	BOOST_REQUIRE (a);
+	BOOST_CHECK (a->size() >= 1000);
+	auto const a_data = a->data ();
+	BOOST_CHECK_EQUAL (pool.in_use(), 1000);
+	a.reset ();
+	BOOST_CHECK_EQUAL (pool.in_use(), 0);
+	BOOST_CHECK_EQUAL (pool.allocated(), 1000);
+
+	/* A block which is a bit smaller should re-use the idle one */
+	auto b = pool.get (900);
+	BOOST_CHECK (b->data() == a_data);
+	BOOST_CHECK_EQUAL (pool.allocated(), 1000);
+
+	/* but a much smaller one should not */
+	auto c = pool.get (100);
+	BOOST_CHECK (c->data() != a_data);
+	BOOST_CHECK_EQUAL (pool.allocated(), 1100);
+}
+
+
+BOOST_AUTO_TEST_CASE (frame_buffer_pool_limit_test)
+{
+	dcp::FrameBufferPool pool (3000);
+
+	auto a = pool.get (1000);
+	auto b = pool.get (1000);
+	b.reset ();
+
+	/* This should free the idle block to make room */
+	auto c = pool.get (2000);
+	BOOST_CHECK_EQUAL (pool.allocated(), 3000);
+
+	std::atomic<bool> got (false);
+	std::thread waiter ([&pool, &got]() {
+		auto d = pool.get (1000);
+		got = true;
+	});
+
+	std::this_thread::sleep_for (std::chrono::milliseconds(100));
+	BOOST_CHECK (!got);
+	a.reset ();
+	waiter.join ();
+	BOOST_CHECK (got);
+	BOOST_CHECK (pool.allocated() <= 3000);
+
+	c.reset ();
+
+	/* A request bigger than the whole pool is allowed when nothing else is in use */
+	auto e = pool.get (5000);
+	BOOST_CHECK_EQUAL (e->size(), 5000);
+	e.reset ();
+	BOOST_CHECK (pool.allocated() <= 3000);
+}
+
+
+/** Check that a thread which hands its blocks to other threads waits for them to be released,
+ *  rather than allocating outside the pool.
+ */
+BOOST_AUTO_TEST_CASE (frame_buffer_pool_producer_test)
+{
+	dcp::FrameBufferPool pool (3000);
+
+	std::mutex mutex;
+	std::vector<shared_ptr<dcp::FrameBufferPool::Block>> handed;
+	int64_t most_allocated = 0;
+
+	std::thread consumer ([&]() {
+		for (int i = 0; i < 10; ++i) {
+			std::this_thread::sleep_for (std::chrono::milliseconds(10));
+			std::unique_lock<std::mutex> lock (mutex);
+			if (!handed.empty()) {
+				handed.erase (handed.begin());
+			}
+		}
+		std::unique_lock<std::mutex> lock (mutex);
+		handed.clear ();
+	});
+
+	for (int i = 0; i < 8; ++i) {
+		auto block = pool.get (1000);
+		std::unique_lock<std::mutex> lock (mutex);
+		handed.push_back (block);
+		most_allocated = std::max (most_allocated, pool.allocated());
+		BOOST_CHECK (pool.in_use() <= 3000);
+	}
+
+	consumer.join ();
+
+	BOOST_CHECK (most_allocated <= 3000);
+	BOOST_CHECK_EQUAL (pool.in_use(), 0);
+}
+
+
+/** Check that a request which can never fit in the pool waits until nothing else is in use */
+BOOST_AUTO_TEST_CASE (frame_buffer_pool_too_big_test)
+{
+	dcp::FrameBufferPool pool (3000);
+
+	auto a = pool.get (1000);
+
+	std::atomic<bool> got (false);
+	std::thread waiter ([&pool, &got]() {
+		auto blocks = pool.get (2000, 2);
+		BOOST_CHECK_EQUAL (blocks.size(), 2U);
+		got = true;
+	});
+
+	std::this_thread::sleep_for (std::chrono::milliseconds(100));
+	BOOST_CHECK (!got);
+	a.reset ();
+	waiter.join ();
+	BOOST_CHECK (got);
+	BOOST_CHECK (pool.allocated() <= 3000);
+	BOOST_CHECK_EQUAL (pool.in_use(), 0);
+}
+
+
+/** Check that blocks which are asked for together are given together */
+BOOST_AUTO_TEST_CASE (frame_buffer_pool_together_test)
+{
+	dcp::FrameBufferPool pool (3500);
+
+	auto a = pool.get (1000);
+	auto b = pool.get (1000);
+
+	std::atomic<bool> got (false);
+	std::thread waiter ([&pool, &got]() {
+		auto blocks = pool.get (1500, 2);
+		got = true;
+	});
+
+	/* Releasing one block makes room for one of the waiter's blocks, but not both */
+	std::this_thread::sleep_for (std::chrono::milliseconds(100));
+	a.reset ();
+	std::this_thread::sleep_for (std::chrono::milliseconds(100));
+	BOOST_CHECK (!got);
+	BOOST_CHECK_EQUAL (pool.in_use(), 1000);
+
+	b.reset ();
+	waiter.join ();
+	BOOST_CHECK (got);
+	BOOST_CHECK (pool.allocated() <= 3500);
+}
+
+
+BOOST_AUTO_TEST_CASE (frame_buffer_pool_lifetime_test)
+{
+	auto pool = make_shared<dcp::FrameBufferPool>(4096);
+	auto a = pool->get (4096);
+	pool.reset ();
+	a->data()[4095] = 42;
+	a.reset ();
+}
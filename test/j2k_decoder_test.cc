@@ -0,0 +1,215 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+#include "array_data.h"
+#include "exceptions.h"
+#include "j2k_decoder.h"
+#include "j2k_transcode.h"
+#include "openjpeg_image.h"
+#include <openjpeg.h>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+
+
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+
+
+static void
+check_same (shared_ptr<dcp::OpenJPEGImage> a, shared_ptr<dcp::OpenJPEGImage> b)
+{
+	BOOST_REQUIRE (a->size() == b->size());
+	for (int c = 0; c < 3; ++c) {
+		auto const N = a->size().width * a->size().height;
+		for (int i = 0; i < N; ++i) {
+			BOOST_REQUIRE_EQUAL (a->data(c)[i], b->data(c)[i]);
+		}
+	}
+}
+
+
+/** Check that `area' is the part of `full' which starts at (x, y) */
+static void
+check_crop (shared_ptr<dcp::OpenJPEGImage> area, shared_ptr<dcp::OpenJPEGImage> full, int x, int y)
+{
+	auto const width = area->size().width;
+	auto const height = area->size().height;
+	BOOST_REQUIRE (x + width <= full->size().width);
+	BOOST_REQUIRE (y + height <= full->size().height);
+	for (int c = 0; c < 3; ++c) {
+		for (int ay = 0; ay < height; ++ay) {
+			for (int ax = 0; ax < width; ++ax) {
+				BOOST_REQUIRE_EQUAL (area->data(c)[ay * width + ax], full->data(c)[(ay + y) * full->size().width + ax + x]);
+			}
+		}
+	}
+}
+
+
+/* A copy of the straightforward decoder that decompress_j2k() used before J2KDecoder was
+ * written (and which decompress_j2k() now uses), so that J2KDecoder can be checked against
+ * something which does not share its code.
+ */
+
+struct ReferenceReadBuffer
+{
+	uint8_t const * data;
+	OPJ_SIZE_T size;
+	OPJ_SIZE_T offset;
+};
+
+
+static OPJ_SIZE_T
+reference_read (void* buffer, OPJ_SIZE_T nb_bytes, void* user)
+{
+	auto read = reinterpret_cast<ReferenceReadBuffer*>(user);
+	auto const N = std::min (nb_bytes, read->size - read->offset);
+	memcpy (buffer, read->data + read->offset, N);
+	read->offset += N;
+	return N;
+}
+
+
+static shared_ptr<dcp::OpenJPEGImage>
+reference_decompress_j2k (dcp::Data const& data, int reduce)
+{
+	auto decoder = opj_create_decompress (OPJ_CODEC_J2K);
+	BOOST_REQUIRE (decoder);
+	opj_dparameters_t parameters;
+	opj_set_default_decoder_parameters (&parameters);
+	parameters.cp_reduce = reduce;
+	opj_setup_decoder (decoder, &parameters);
+
+	auto stream = opj_stream_default_create (OPJ_TRUE);
+	BOOST_REQUIRE (stream);
+	ReferenceReadBuffer buffer = { data.data(), static_cast<OPJ_SIZE_T>(data.size()), 0 };
+	opj_stream_set_read_function (stream, reference_read);
+	opj_stream_set_user_data (stream, &buffer, nullptr);
+	opj_stream_set_user_data_length (stream, data.size());
+
+	opj_image_t* image = nullptr;
+	BOOST_REQUIRE (opj_read_header(stream, decoder, &image));
+	BOOST_REQUIRE (opj_decode(decoder, stream, image));
+
+	opj_destroy_codec (decoder);
+	opj_stream_destroy (stream);
+
+	image->x1 = rint (float(image->x1) / pow (2.0f, reduce));
+	image->y1 = rint (float(image->y1) / pow (2.0f, reduce));
+	return make_shared<dcp::OpenJPEGImage>(image);
+}
+
+
+/** @return A codestream of an image with detail everywhere, so that decoding the wrong part of it,
+ *  or decoding any part wrongly, will show.
+ */
+static dcp::ArrayData
+detailed_j2k ()
+{
+	dcp::Size const size (1998, 1080);
+	auto image = make_shared<dcp::OpenJPEGImage>(size);
+	for (int c = 0; c < 3; ++c) {
+		auto p = image->data(c);
+		for (int y = 0; y < size.height; ++y) {
+			for (int x = 0; x < size.width; ++x) {
+				*p++ = ((x * (c + 3) + y * (7 - c) + (x * y) / 97) * 13) % 4096;
+			}
+		}
+	}
+
+	return dcp::compress_j2k (image, 250000000, 24, false, false);
+}
+
+
+BOOST_AUTO_TEST_CASE (j2k_decoder_test)
+{
+	for (auto j2k: { dcp::ArrayData("test/data/flat_red.j2c"), detailed_j2k() }) {
+		dcp::J2KDecoder decoder;
+		decoder.set_threads_per_frame (4);
+		check_same (decoder.decode(j2k), reference_decompress_j2k(j2k, 0));
+
+		decoder.set_reduce (1);
+		auto reduced = decoder.decode (j2k);
+		BOOST_CHECK (reduced->size() == dcp::Size(999, 540));
+		check_same (reduced, reference_decompress_j2k(j2k, 1));
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE (j2k_decoder_area_test)
+{
+	auto const j2k = detailed_j2k ();
+
+	dcp::J2KDecoder decoder;
+
+	decoder.set_area (dcp::J2KDecoder::Area(100, 200, 64, 32));
+	auto area = decoder.decode (j2k);
+	BOOST_REQUIRE (area->size() == dcp::Size(64, 32));
+	check_crop (area, reference_decompress_j2k(j2k, 0), 100, 200);
+
+	/* An area which does not start on a code-block boundary and runs to the edges of the image */
+	decoder.set_area (dcp::J2KDecoder::Area(1931, 1013, 67, 67));
+	area = decoder.decode (j2k);
+	BOOST_REQUIRE (area->size() == dcp::Size(67, 67));
+	check_crop (area, reference_decompress_j2k(j2k, 0), 1931, 1013);
+
+	decoder.set_area (dcp::J2KDecoder::Area(100, 200, 64, 32));
+	decoder.set_reduce (1);
+	area = decoder.decode (j2k);
+	BOOST_REQUIRE (area->size() == dcp::Size(32, 16));
+	check_crop (area, reference_decompress_j2k(j2k, 1), 50, 100);
+}
+
+
+BOOST_AUTO_TEST_CASE (j2k_decoder_batch_test)
+{
+	auto j2k = make_shared<dcp::ArrayData>("test/data/flat_red.j2c");
+	auto corrupt = make_shared<dcp::ArrayData>(1024);
+	memset (corrupt->data(), 0, corrupt->size());
+
+	dcp::J2KDecoder decoder;
+	auto single = decoder.decode (*j2k);
+
+	vector<shared_ptr<const dcp::Data>> frames (9, j2k);
+	auto images = decoder.decode (frames, 4);
+	BOOST_REQUIRE_EQUAL (images.size(), frames.size());
+	for (auto i: images) {
+		check_same (i, single);
+	}
+
+	frames[5] = corrupt;
+	BOOST_CHECK_THROW (decoder.decode(frames, 4), dcp::ReadError);
+}
@@ -0,0 +1,200 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+#include "j2k_encoder.h"
+#include "j2k_transcode.h"
+#include "openjpeg_image.h"
+#include "verify.h"
+#include <openjpeg.h>
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+#include <random>
+
+
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+
+
+static shared_ptr<dcp::OpenJPEGImage>
+random_image (std::mt19937& generator)
+{
+	std::uniform_int_distribution<int> distribution (0, 4095);
+	auto xyz = make_shared<dcp::OpenJPEGImage>(dcp::Size(1998, 1080));
+	for (int c = 0; c < 3; ++c) {
+		for (int p = 0; p < (1998 * 1080); ++p) {
+			xyz->data(c)[p] = distribution(generator);
+		}
+	}
+	return xyz;
+}
+
+
+/* A copy of the straightforward encoder that compress_j2k() used before J2KEncoder was written
+ * (and which compress_j2k() now uses), so that J2KEncoder can be checked against something which
+ * does not share its code.
+ */
+
+struct ReferenceWriteBuffer
+{
+	vector<uint8_t> data;
+	size_t offset = 0;
+};
+
+
+static OPJ_SIZE_T
+reference_write (void* buffer, OPJ_SIZE_T nb_bytes, void* user)
+{
+	auto write = reinterpret_cast<ReferenceWriteBuffer*>(user);
+	if (write->offset + nb_bytes > write->data.size()) {
+		write->data.resize (write->offset + nb_bytes);
+	}
+	memcpy (write->data.data() + write->offset, buffer, nb_bytes);
+	write->offset += nb_bytes;
+	return nb_bytes;
+}
+
+
+static OPJ_BOOL
+reference_seek (OPJ_OFF_T position, void* user)
+{
+	reinterpret_cast<ReferenceWriteBuffer*>(user)->offset = position;
+	return OPJ_TRUE;
+}
+
+
+static dcp::ArrayData
+reference_compress_j2k (shared_ptr<const dcp::OpenJPEGImage> xyz, int bandwidth, int frames_per_second)
+{
+	/* openjpeg overwrites the image that it encodes */
+	dcp::OpenJPEGImage copy (*xyz);
+
+	auto encoder = opj_create_compress (OPJ_CODEC_J2K);
+	BOOST_REQUIRE (encoder);
+
+	opj_cparameters_t parameters;
+	opj_set_default_encoder_parameters (&parameters);
+	parameters.rsiz = OPJ_PROFILE_CINEMA_2K;
+	char comment[] = "libdcp";
+	parameters.cp_comment = comment;
+	parameters.max_cs_size = (bandwidth / 8) / frames_per_second;
+	parameters.max_comp_size = parameters.max_cs_size / 1.25;
+	parameters.tcp_numlayers = 1;
+	parameters.tcp_mct = 1;
+	parameters.numgbits = 1;
+
+	BOOST_REQUIRE (opj_setup_encoder(encoder, &parameters, copy.opj_image()));
+
+	auto stream = opj_stream_default_create (OPJ_FALSE);
+	BOOST_REQUIRE (stream);
+	ReferenceWriteBuffer output;
+	opj_stream_set_write_function (stream, reference_write);
+	opj_stream_set_seek_function (stream, reference_seek);
+	opj_stream_set_user_data (stream, &output, nullptr);
+
+	BOOST_REQUIRE (opj_start_compress(encoder, copy.opj_image(), stream));
+	BOOST_REQUIRE (opj_encode(encoder, stream));
+	BOOST_REQUIRE (opj_end_compress(encoder, stream));
+
+	opj_stream_destroy (stream);
+	opj_destroy_codec (encoder);
+
+	return dcp::ArrayData (output.data.data(), output.data.size());
+}
+
+
+BOOST_AUTO_TEST_CASE (j2k_encoder_test)
+{
+	std::mt19937 generator (42);
+	auto xyz = random_image (generator);
+	dcp::OpenJPEGImage copy (*xyz);
+
+	dcp::J2KEncoder encoder (100000000, 24, false, false, 4);
+	auto encoded = encoder.encode (xyz);
+
+	/* The input should be untouched */
+	for (int c = 0; c < 3; ++c) {
+		BOOST_REQUIRE (memcmp(xyz->data(c), copy.data(c), 1998 * 1080 * sizeof(int)) == 0);
+	}
+
+	/* and the output the same as the reference encoder's, even when the scratch image is re-used */
+	auto reference = reference_compress_j2k (xyz, 100000000, 24);
+	BOOST_CHECK (encoded == reference);
+	BOOST_CHECK (encoder.encode(xyz) == reference);
+	BOOST_CHECK_EQUAL (encoder.maximum_frame_size(), 100000000 / 8 / 24);
+
+	/* Encoding in place should give the same codestream */
+	BOOST_CHECK (encoder.encode_in_place(make_shared<dcp::OpenJPEGImage>(copy)) == reference);
+}
+
+
+BOOST_AUTO_TEST_CASE (j2k_encoder_threads_test)
+{
+	std::mt19937 generator (42);
+	vector<shared_ptr<const dcp::OpenJPEGImage>> frames;
+	for (int i = 0; i < 6; ++i) {
+		frames.push_back (random_image(generator));
+	}
+
+	dcp::J2KEncoder encoder (100000000, 24, false, false, 3);
+	auto encoded = encoder.encode (frames);
+	BOOST_REQUIRE_EQUAL (encoded.size(), frames.size());
+	for (size_t i = 0; i < frames.size(); ++i) {
+		BOOST_CHECK (encoded[i] == reference_compress_j2k(frames[i], 100000000, 24));
+	}
+
+	auto future = encoder.encode_async (frames[2]);
+	BOOST_CHECK (future.get() == encoded[2]);
+
+	auto in_place = encoder.encode_async_in_place (make_shared<dcp::OpenJPEGImage>(*frames[3]));
+	BOOST_CHECK (in_place.get() == encoded[3]);
+}
+
+
+BOOST_AUTO_TEST_CASE (j2k_encoder_frame_size_limit_test)
+{
+	std::mt19937 generator (42);
+	auto xyz = random_image (generator);
+
+	/* Ask for more than Bv2.1 allows, but limit the frames to what verify() is happy with */
+	dcp::J2KEncoder encoder (500000000, 24, false, false, 1);
+	auto const limit = dcp::risky_picture_frame_size (dcp::Fraction(24, 1));
+	BOOST_REQUIRE (encoder.encode(xyz).size() > limit);
+	encoder.set_frame_size_limit (limit);
+	BOOST_CHECK (encoder.encode(xyz).size() <= limit);
+
+	encoder.set_frame_size_limit (100000);
+	BOOST_CHECK (encoder.encode(xyz).size() <= 100000);
+}
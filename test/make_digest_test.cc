@@ -33,6 +33,9 @@
 
 
 #include "array_data.h"
+#include "exceptions.h"
+#include "mono_picture_asset.h"
+#include "mxf_stream.h"
 #include "util.h"
 #include <boost/bind.hpp>
 #include <boost/test/unit_test.hpp>
@@ -61,3 +64,47 @@ BOOST_AUTO_TEST_CASE (make_digest_test)
 	/* Hash it */
 	BOOST_CHECK_EQUAL (dcp::make_digest("build/test/random", boost::bind(&progress, _1)), "GKbk/V3fcRtP5MaPdSmAGNbKkaU=");
 }
+
+
+/** Check that MXFStream gives the same digest as make_digest and finds every frame */
+BOOST_AUTO_TEST_CASE (mxf_stream_test)
+{
+	boost::filesystem::path const file = "test/ref/DCP/dcp_test1/video.mxf";
+	dcp::MonoPictureAsset asset (file);
+	auto reader = asset.start_read ();
+
+	dcp::MXFStream stream (file);
+	for (int64_t i = 0; i < asset.intrinsic_duration(); ++i) {
+		auto essence = stream.next_essence ();
+		BOOST_REQUIRE (essence);
+		auto frame = reader->get_frame (i);
+		BOOST_REQUIRE_EQUAL (essence->size(), frame->size());
+		BOOST_CHECK (memcmp(essence->data(), frame->data(), frame->size()) == 0);
+	}
+	BOOST_CHECK (!stream.next_essence());
+
+	BOOST_CHECK_EQUAL (stream.digest(), dcp::make_digest(file, boost::bind(&progress, _1)));
+}
+
+
+/** Check that MXFStream rejects an essence element whose length runs past the end of the file */
+BOOST_AUTO_TEST_CASE (mxf_stream_bad_length_test)
+{
+	boost::filesystem::path const file = "build/test/mxf_stream_bad_length_test.mxf";
+	dcp::ArrayData data ("test/ref/DCP/dcp_test1/video.mxf");
+	auto const size = data.size();
+	int key = 0;
+	while (key < size - 17 && !dcp::is_essence_key(data.data() + key)) {
+		++key;
+	}
+	BOOST_REQUIRE (key < size - 17);
+	auto const length = data.data()[key + 16];
+	BOOST_REQUIRE (length & 0x80);
+	for (int i = 0; i < (length & 0x7f); ++i) {
+		data.data()[key + 17 + i] = 0xff;
+	}
+	data.write (file);
+
+	dcp::MXFStream stream (file);
+	BOOST_CHECK_THROW (stream.next_essence(), dcp::ReadError);
+}
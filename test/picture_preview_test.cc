@@ -0,0 +1,91 @@
+/*
+    Copyright (C) 2021 Carl Hetherington <cth@carlh.net>
+
+    This file is part of libdcp.
+
+    libdcp is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    libdcp is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libdcp.  If not, see <http://www.gnu.org/licenses/>.
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of portions of this program with the
+    OpenSSL library under certain conditions as described in each
+    individual source file, and distribute linked combinations
+    including the two.
+
+    You must obey the GNU General Public License in all respects
+    for all of the code used other than OpenSSL.  If you modify
+    file(s) with this exception, you may extend this exception to your
+    version of the file(s), but you are not obligated to do so.  If you
+    do not wish to do so, delete this exception statement from your
+    version.  If you delete this exception statement from all source
+    files in the program, then also delete it here.
+*/
+
+
+
+#include "compose.hpp"
+#include "mono_picture_asset.h"
+#include "mono_picture_asset_reader.h"
+#include "mono_picture_frame.h"
+#include "openjpeg_image.h"
+#include "picture_preview.h"
+#include "util.h"
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+
+
+using std::make_shared;
+
+
+BOOST_AUTO_TEST_CASE (picture_preview_test)
+{
+	boost::filesystem::path const dir = "build/test/picture_preview_test";
+	boost::filesystem::remove_all (dir);
+
+	auto asset = make_shared<dcp::MonoPictureAsset>("test/ref/DCP/dcp_test1/video.mxf");
+	dcp::PicturePreview preview (asset, 2, dir);
+
+	auto const size = asset->start_read()->get_frame(3)->xyz_image(2)->size();
+
+	auto image = preview.get (3);
+	BOOST_CHECK (image.size == size);
+	BOOST_CHECK_EQUAL (image.rgb.size(), size.width * size.height * 3);
+
+	/* The preview should now be in the cache, and come back from there the same */
+	auto file = preview.cache_file (3);
+	BOOST_REQUIRE (file);
+	BOOST_REQUIRE (boost::filesystem::exists(*file));
+	BOOST_CHECK_EQUAL (boost::filesystem::file_size(*file), image.rgb.size() + dcp::String::compose("P6\n%1 %2\n255\n", size.width, size.height).size());
+	BOOST_CHECK (preview.get(3).rgb == image.rgb);
+
+	/* A broken cache file should be ignored, and replaced */
+	boost::filesystem::resize_file (*file, 100);
+	BOOST_CHECK (preview.get(3).rgb == image.rgb);
+	BOOST_CHECK_EQUAL (boost::filesystem::file_size(*file), image.rgb.size() + dcp::String::compose("P6\n%1 %2\n255\n", size.width, size.height).size());
+
+	/* So should one whose header claims a size that the preview cannot be */
+	{
+		auto f = dcp::fopen_boost (*file, "wb");
+		BOOST_REQUIRE (f);
+		fprintf (f, "P6\n%d %d\n255\n", 65536, 65536);
+		fclose (f);
+	}
+	BOOST_CHECK (preview.get(3).rgb == image.rgb);
+	BOOST_CHECK_EQUAL (boost::filesystem::file_size(*file), image.rgb.size() + dcp::String::compose("P6\n%1 %2\n255\n", size.width, size.height).size());
+
+	/* Previews made without a cache should be the same */
+	dcp::PicturePreview uncached (asset, 2);
+	BOOST_CHECK (!uncached.cache_file(3));
+	BOOST_CHECK (uncached.get(3).rgb == image.rgb);
+}
@@ -32,12 +32,20 @@
 */
 
 #include "rgb_xyz.h"
+#include "rgb_xyz_avx2.h"
 #include "openjpeg_image.h"
 #include "colour_conversion.h"
+#include "compiled_colour_conversion.h"
 #include "stream_operators.h"
+#include "transfer_function.h"
+#include "compose.hpp"
 #include <boost/test/unit_test.hpp>
 #include <boost/bind.hpp>
 #include <boost/scoped_array.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 using std::max;
 using std::list;
@@ -210,3 +218,453 @@ BOOST_AUTO_TEST_CASE (rgb_xyz_round_trip_test)
 	}
 #endif
 }
+
+
+/** Check that the AVX2 conversions give exactly the same results as the scalar ones */
+BOOST_AUTO_TEST_CASE (rgb_xyz_avx2_test)
+{
+	if (!dcp::rgb_xyz_avx2()) {
+		return;
+	}
+
+	srand (0);
+	/* An odd width so that the scalar code has to finish off each line */
+	dcp::Size const size (643, 480);
+
+	scoped_array<uint8_t> rgb (new uint8_t[size.width * size.height * 6]);
+	for (int i = 0; i < size.width * size.height * 6; ++i) {
+		rgb[i] = rand() & 0xff;
+	}
+
+	for (auto conversion: { dcp::ColourConversion::srgb_to_xyz(), dcp::ColourConversion::rec709_to_xyz(), dcp::ColourConversion::p3_to_xyz() }) {
+		dcp::set_rgb_xyz_avx2 (false);
+		auto scalar_xyz = dcp::rgb_to_xyz (rgb.get(), size, size.width * 6, conversion);
+		dcp::set_rgb_xyz_avx2 (true);
+		auto avx2_xyz = dcp::rgb_to_xyz (rgb.get(), size, size.width * 6, conversion);
+
+		for (int c = 0; c < 3; ++c) {
+			BOOST_REQUIRE (memcmp(scalar_xyz->data(c), avx2_xyz->data(c), size.width * size.height * sizeof(int)) == 0);
+		}
+
+		/* Some out-of-range values, which xyz_to_rgb should report and clamp in the same way */
+		avx2_xyz->data(0)[17] = -4;
+		avx2_xyz->data(2)[size.width * 2 + 5] = 6901;
+
+		scoped_array<uint8_t> scalar_rgb (new uint8_t[size.width * size.height * 6]);
+		scoped_array<uint8_t> avx2_rgb (new uint8_t[size.width * size.height * 6]);
+
+		dcp::set_rgb_xyz_avx2 (false);
+		notes.clear ();
+		dcp::xyz_to_rgb (avx2_xyz, conversion, scalar_rgb.get(), size.width * 6, boost::optional<dcp::NoteHandler>(boost::bind(&note_handler, _1, _2)));
+		auto scalar_notes = notes;
+		dcp::set_rgb_xyz_avx2 (true);
+		notes.clear ();
+		dcp::xyz_to_rgb (avx2_xyz, conversion, avx2_rgb.get(), size.width * 6, boost::optional<dcp::NoteHandler>(boost::bind(&note_handler, _1, _2)));
+
+		BOOST_CHECK (scalar_notes == notes);
+		BOOST_REQUIRE (memcmp(scalar_rgb.get(), avx2_rgb.get(), size.width * size.height * 6) == 0);
+
+		scoped_array<uint8_t> scalar_rgba (new uint8_t[size.width * size.height * 4]);
+		scoped_array<uint8_t> avx2_rgba (new uint8_t[size.width * size.height * 4]);
+
+		dcp::set_rgb_xyz_avx2 (false);
+		dcp::xyz_to_rgba (scalar_xyz, conversion, scalar_rgba.get(), size.width * 4);
+		dcp::set_rgb_xyz_avx2 (true);
+		dcp::xyz_to_rgba (scalar_xyz, conversion, avx2_rgba.get(), size.width * 4);
+
+		BOOST_REQUIRE (memcmp(scalar_rgba.get(), avx2_rgba.get(), size.width * size.height * 4) == 0);
+	}
+}
+
+
+/** Check that converting in bands on several threads gives the same results and notes as doing it on one */
+BOOST_AUTO_TEST_CASE (rgb_xyz_threads_test)
+{
+	srand (0);
+	dcp::Size const size (640, 479);
+
+	scoped_array<uint8_t> rgb (new uint8_t[size.width * size.height * 6]);
+	for (int i = 0; i < size.width * size.height * 6; ++i) {
+		rgb[i] = rand() & 0xff;
+	}
+
+	auto const conversion = dcp::ColourConversion::rec709_to_xyz();
+
+	list<string> serial_notes;
+	auto serial_xyz = dcp::rgb_to_xyz (rgb.get(), size, size.width * 6, conversion, boost::optional<dcp::NoteHandler>([&serial_notes](dcp::NoteType, string s) { serial_notes.push_back(s); }));
+	list<string> threaded_notes;
+	auto threaded_xyz = dcp::rgb_to_xyz (rgb.get(), size, size.width * 6, conversion, 7, boost::optional<dcp::NoteHandler>([&threaded_notes](dcp::NoteType, string s) { threaded_notes.push_back(s); }));
+
+	BOOST_CHECK (serial_notes == threaded_notes);
+	for (int c = 0; c < 3; ++c) {
+		BOOST_REQUIRE (memcmp(serial_xyz->data(c), threaded_xyz->data(c), size.width * size.height * sizeof(int)) == 0);
+	}
+
+	/* Put some out-of-range values in different bands */
+	serial_xyz->data(0)[3] = -4;
+	serial_xyz->data(1)[size.width * 200] = 6901;
+	serial_xyz->data(2)[size.width * 478 + 7] = 4096;
+
+	scoped_array<uint8_t> serial_rgb (new uint8_t[size.width * size.height * 6]);
+	scoped_array<uint8_t> threaded_rgb (new uint8_t[size.width * size.height * 6]);
+
+	notes.clear ();
+	dcp::xyz_to_rgb (serial_xyz, conversion, serial_rgb.get(), size.width * 6, boost::optional<dcp::NoteHandler>(boost::bind(&note_handler, _1, _2)));
+	serial_notes = notes;
+	notes.clear ();
+	dcp::xyz_to_rgb (serial_xyz, conversion, threaded_rgb.get(), size.width * 6, 7, boost::optional<dcp::NoteHandler>(boost::bind(&note_handler, _1, _2)));
+
+	BOOST_CHECK_EQUAL (serial_notes.size(), 3);
+	BOOST_CHECK (serial_notes == notes);
+	BOOST_REQUIRE (memcmp(serial_rgb.get(), threaded_rgb.get(), size.width * size.height * 6) == 0);
+
+	scoped_array<uint8_t> serial_rgba (new uint8_t[size.width * size.height * 4]);
+	scoped_array<uint8_t> threaded_rgba (new uint8_t[size.width * size.height * 4]);
+	dcp::xyz_to_rgba (threaded_xyz, conversion, serial_rgba.get(), size.width * 4);
+	dcp::xyz_to_rgba (threaded_xyz, conversion, threaded_rgba.get(), size.width * 4, 7);
+	BOOST_REQUIRE (memcmp(serial_rgba.get(), threaded_rgba.get(), size.width * size.height * 4) == 0);
+}
+
+
+/** A small fixed set of threads which run whatever tasks they are given, for rgb_xyz_executor_test */
+class TestPool
+{
+public:
+	explicit TestPool (int threads)
+	{
+		for (int i = 0; i < threads; ++i) {
+			_threads.push_back (std::thread([this]() {
+				while (true) {
+					boost::function<void ()> task;
+					{
+						std::unique_lock<std::mutex> lock (_mutex);
+						while (_tasks.empty() && !_stop) {
+							_changed.wait (lock);
+						}
+						if (_tasks.empty()) {
+							return;
+						}
+						task = _tasks.front ();
+						_tasks.pop_front ();
+					}
+					task ();
+				}
+			}));
+		}
+	}
+
+	~TestPool ()
+	{
+		{
+			std::unique_lock<std::mutex> lock (_mutex);
+			_stop = true;
+		}
+		_changed.notify_all ();
+		for (auto& i: _threads) {
+			i.join ();
+		}
+	}
+
+	void post (boost::function<void ()> task)
+	{
+		{
+			std::unique_lock<std::mutex> lock (_mutex);
+			_tasks.push_back (task);
+			++_posted;
+		}
+		_changed.notify_one ();
+	}
+
+	int posted () const {
+		return _posted;
+	}
+
+private:
+	std::mutex _mutex;
+	std::condition_variable _changed;
+	std::list<boost::function<void ()>> _tasks;
+	std::vector<std::thread> _threads;
+	std::atomic<int> _posted{0};
+	bool _stop = false;
+};
+
+
+/** Check that converting in bands on a caller-supplied executor gives the same results and notes as doing it on one thread,
+ *  and that the same executor can be used for several conversions.
+ */
+BOOST_AUTO_TEST_CASE (rgb_xyz_executor_test)
+{
+	srand (1);
+	dcp::Size const size (640, 479);
+
+	scoped_array<uint8_t> rgb (new uint8_t[size.width * size.height * 6]);
+	for (int i = 0; i < size.width * size.height * 6; ++i) {
+		rgb[i] = rand() & 0xff;
+	}
+
+	dcp::CompiledColourConversion const conversion (dcp::ColourConversion::rec709_to_xyz());
+
+	TestPool pool (3);
+	dcp::Executor executor = boost::bind(&TestPool::post, &pool, _1);
+
+	list<string> serial_notes;
+	auto serial_xyz = dcp::rgb_to_xyz (rgb.get(), size, size.width * 6, conversion, 1, boost::optional<dcp::NoteHandler>([&serial_notes](dcp::NoteType, string s) { serial_notes.push_back(s); }));
+	list<string> pool_notes;
+	auto pool_xyz = dcp::rgb_to_xyz (rgb.get(), size, size.width * 6, conversion, executor, 8, boost::optional<dcp::NoteHandler>([&pool_notes](dcp::NoteType, string s) { pool_notes.push_back(s); }));
+
+	BOOST_CHECK_EQUAL (pool.posted(), 8);
+	BOOST_CHECK (serial_notes == pool_notes);
+	for (int c = 0; c < 3; ++c) {
+		BOOST_REQUIRE (memcmp(serial_xyz->data(c), pool_xyz->data(c), size.width * size.height * sizeof(int)) == 0);
+	}
+
+	serial_xyz->data(0)[3] = -4;
+	serial_xyz->data(2)[size.width * 478 + 7] = 4096;
+
+	scoped_array<uint8_t> serial_rgb (new uint8_t[size.width * size.height * 6]);
+	scoped_array<uint8_t> pool_rgb (new uint8_t[size.width * size.height * 6]);
+
+	notes.clear ();
+	dcp::xyz_to_rgb (serial_xyz, conversion, serial_rgb.get(), size.width * 6, 1, boost::optional<dcp::NoteHandler>(boost::bind(&note_handler, _1, _2)));
+	serial_notes = notes;
+	notes.clear ();
+	dcp::xyz_to_rgb (serial_xyz, conversion, pool_rgb.get(), size.width * 6, executor, 5, boost::optional<dcp::NoteHandler>(boost::bind(&note_handler, _1, _2)));
+
+	BOOST_CHECK_EQUAL (serial_notes.size(), 2);
+	BOOST_CHECK (serial_notes == notes);
+	BOOST_REQUIRE (memcmp(serial_rgb.get(), pool_rgb.get(), size.width * size.height * 6) == 0);
+
+	scoped_array<uint8_t> serial_rgba (new uint8_t[size.width * size.height * 4]);
+	scoped_array<uint8_t> pool_rgba (new uint8_t[size.width * size.height * 4]);
+	dcp::xyz_to_rgba (pool_xyz, conversion, serial_rgba.get(), size.width * 4);
+	dcp::xyz_to_rgba (pool_xyz, conversion, pool_rgba.get(), size.width * 4, executor, 4);
+	BOOST_REQUIRE (memcmp(serial_rgba.get(), pool_rgba.get(), size.width * size.height * 4) == 0);
+
+	BOOST_CHECK_EQUAL (pool.posted(), 17);
+}
+
+
+/* What follows are copies of the straightforward per-pixel conversions which libdcp used before
+ * CompiledColourConversion, bands and AVX2 were added, so that the current code can be checked
+ * against something which does not share any of its preparation.
+ */
+
+static double const reference_dci_coefficient = 48.0 / 52.37;
+
+
+static shared_ptr<dcp::OpenJPEGImage>
+reference_rgb_to_xyz (uint8_t const * rgb, dcp::Size size, int stride, dcp::ColourConversion const & conversion, int& clamped)
+{
+	auto xyz = make_shared<dcp::OpenJPEGImage>(size);
+
+	auto const * lut_in = conversion.in()->lut (12, false);
+	auto const * lut_out = conversion.out()->lut (16, true);
+
+	auto const rgb_to_xyz = conversion.rgb_to_xyz ();
+	auto const bradford = conversion.bradford ();
+
+	double fast_matrix[9];
+	for (int y = 0; y < 3; ++y) {
+		for (int x = 0; x < 3; ++x) {
+			fast_matrix[y * 3 + x] = (bradford (y, 0) * rgb_to_xyz (0, x) + bradford (y, 1) * rgb_to_xyz (1, x) + bradford (y, 2) * rgb_to_xyz (2, x))
+				* reference_dci_coefficient * 65535;
+		}
+	}
+
+	clamped = 0;
+	int* xyz_x = xyz->data (0);
+	int* xyz_y = xyz->data (1);
+	int* xyz_z = xyz->data (2);
+	for (int y = 0; y < size.height; ++y) {
+		auto p = reinterpret_cast<uint16_t const *> (rgb + y * stride);
+		for (int x = 0; x < size.width; ++x) {
+			double const r = lut_in[*p++ >> 4];
+			double const g = lut_in[*p++ >> 4];
+			double const b = lut_in[*p++ >> 4];
+
+			double dx = r * fast_matrix[0] + g * fast_matrix[1] + b * fast_matrix[2];
+			double dy = r * fast_matrix[3] + g * fast_matrix[4] + b * fast_matrix[5];
+			double dz = r * fast_matrix[6] + g * fast_matrix[7] + b * fast_matrix[8];
+
+			if (dx < 0 || dy < 0 || dz < 0 || dx > 65535 || dy > 65535 || dz > 65535) {
+				++clamped;
+			}
+
+			dx = std::min (65535.0, max (0.0, dx));
+			dy = std::min (65535.0, max (0.0, dy));
+			dz = std::min (65535.0, max (0.0, dz));
+
+			*xyz_x++ = lrint (lut_out[lrint(dx)] * 4095);
+			*xyz_y++ = lrint (lut_out[lrint(dy)] * 4095);
+			*xyz_z++ = lrint (lut_out[lrint(dz)] * 4095);
+		}
+	}
+
+	return xyz;
+}
+
+
+/** @param rgba true to write 8-bit BGRA as xyz_to_rgba() does, false to write 16-bit RGB as xyz_to_rgb() does.
+ *  @param out_of_range Filled with each out-of-range XYZ value, in the order they are found.
+ */
+static void
+reference_xyz_to_rgb (shared_ptr<const dcp::OpenJPEGImage> xyz_image, dcp::ColourConversion const & conversion, uint8_t* out, int stride, bool rgba, std::vector<int>& out_of_range)
+{
+	double const * lut_in = conversion.out()->lut (12, false);
+	double const * lut_out = conversion.in()->lut (16, true);
+	auto const matrix = conversion.xyz_to_rgb ();
+
+	int const width = xyz_image->size().width;
+	int const height = xyz_image->size().height;
+
+	int const* xyz_x = xyz_image->data (0);
+	int const* xyz_y = xyz_image->data (1);
+	int const* xyz_z = xyz_image->data (2);
+
+	auto in = [&out_of_range](int v) {
+		if (v < 0 || v > 4095) {
+			out_of_range.push_back (v);
+			v = max (std::min (v, 4095), 0);
+		}
+		return v;
+	};
+
+	for (int y = 0; y < height; ++y) {
+		auto rgb_line = reinterpret_cast<uint16_t*> (out + y * stride);
+		auto rgba_line = out + y * stride;
+		for (int x = 0; x < width; ++x) {
+			int const cx = in (*xyz_x++);
+			int const cy = in (*xyz_y++);
+			int const cz = in (*xyz_z++);
+
+			double const sx = lut_in[cx] / reference_dci_coefficient;
+			double const sy = lut_in[cy] / reference_dci_coefficient;
+			double const sz = lut_in[cz] / reference_dci_coefficient;
+
+			double d[3];
+			for (int c = 0; c < 3; ++c) {
+				d[c] = (sx * matrix (c, 0)) + (sy * matrix (c, 1)) + (sz * matrix (c, 2));
+				d[c] = max (std::min (d[c], 1.0), 0.0);
+			}
+
+			if (rgba) {
+				*rgba_line++ = lut_out[lrint(d[2] * 65535)] * 0xff;
+				*rgba_line++ = lut_out[lrint(d[1] * 65535)] * 0xff;
+				*rgba_line++ = lut_out[lrint(d[0] * 65535)] * 0xff;
+				*rgba_line++ = 0xff;
+			} else {
+				for (int c = 0; c < 3; ++c) {
+					*rgb_line++ = lrint(lut_out[lrint(d[c] * 65535)] * 65535);
+				}
+			}
+		}
+	}
+}
+
+
+/** Check that a CompiledColourConversion, used for several frames, gives the same results as the
+ *  reference per-pixel conversions above, as does a ColourConversion given directly.
+ */
+BOOST_AUTO_TEST_CASE (compiled_colour_conversion_test)
+{
+	srand (0);
+	dcp::Size const size (321, 240);
+
+	auto const conversion = dcp::ColourConversion::p3_to_xyz();
+	dcp::CompiledColourConversion const compiled (conversion);
+
+	for (int frame = 0; frame < 3; ++frame) {
+		scoped_array<uint8_t> rgb (new uint8_t[size.width * size.height * 6]);
+		for (int i = 0; i < size.width * size.height * 6; ++i) {
+			rgb[i] = rand() & 0xff;
+		}
+
+		int reference_clamped = 0;
+		auto reference_xyz = reference_rgb_to_xyz (rgb.get(), size, size.width * 6, conversion, reference_clamped);
+		list<string> reference_notes;
+		if (reference_clamped) {
+			reference_notes.push_back (dcp::String::compose("%1 XYZ value(s) clamped", reference_clamped));
+		}
+
+		list<string> direct_notes;
+		auto xyz = dcp::rgb_to_xyz (rgb.get(), size, size.width * 6, conversion, boost::optional<dcp::NoteHandler>([&direct_notes](dcp::NoteType, string s) { direct_notes.push_back(s); }));
+		list<string> compiled_notes;
+		auto compiled_xyz = dcp::rgb_to_xyz (rgb.get(), size, size.width * 6, compiled, 3, boost::optional<dcp::NoteHandler>([&compiled_notes](dcp::NoteType, string s) { compiled_notes.push_back(s); }));
+		BOOST_CHECK (direct_notes == reference_notes);
+		BOOST_CHECK (compiled_notes == reference_notes);
+		for (int c = 0; c < 3; ++c) {
+			BOOST_REQUIRE (memcmp(reference_xyz->data(c), xyz->data(c), size.width * size.height * sizeof(int)) == 0);
+			BOOST_REQUIRE (memcmp(reference_xyz->data(c), compiled_xyz->data(c), size.width * size.height * sizeof(int)) == 0);
+		}
+
+		/* Some out-of-range values for xyz_to_rgb to report and clamp */
+		xyz->data(0)[frame] = -4;
+		xyz->data(1)[size.width * 100 + frame] = 4096;
+
+		std::vector<int> reference_out_of_range;
+		scoped_array<uint8_t> reference_back (new uint8_t[size.width * size.height * 6]);
+		reference_xyz_to_rgb (xyz, conversion, reference_back.get(), size.width * 6, false, reference_out_of_range);
+		list<string> reference_back_notes;
+		for (auto i: reference_out_of_range) {
+			reference_back_notes.push_back (dcp::String::compose("XYZ value %1 out of range", i));
+		}
+		BOOST_REQUIRE_EQUAL (reference_back_notes.size(), 2U);
+
+		scoped_array<uint8_t> back (new uint8_t[size.width * size.height * 6]);
+		scoped_array<uint8_t> compiled_back (new uint8_t[size.width * size.height * 6]);
+		notes.clear ();
+		dcp::xyz_to_rgb (xyz, conversion, back.get(), size.width * 6, boost::optional<dcp::NoteHandler>(boost::bind(&note_handler, _1, _2)));
+		BOOST_CHECK (notes == reference_back_notes);
+		notes.clear ();
+		dcp::xyz_to_rgb (xyz, compiled, compiled_back.get(), size.width * 6, 3, boost::optional<dcp::NoteHandler>(boost::bind(&note_handler, _1, _2)));
+		BOOST_CHECK (notes == reference_back_notes);
+		BOOST_REQUIRE (memcmp(reference_back.get(), back.get(), size.width * size.height * 6) == 0);
+		BOOST_REQUIRE (memcmp(reference_back.get(), compiled_back.get(), size.width * size.height * 6) == 0);
+
+		std::vector<int> unused;
+		scoped_array<uint8_t> reference_rgba (new uint8_t[size.width * size.height * 4]);
+		reference_xyz_to_rgb (compiled_xyz, conversion, reference_rgba.get(), size.width * 4, true, unused);
+		scoped_array<uint8_t> rgba (new uint8_t[size.width * size.height * 4]);
+		scoped_array<uint8_t> compiled_rgba (new uint8_t[size.width * size.height * 4]);
+		dcp::xyz_to_rgba (compiled_xyz, conversion, rgba.get(), size.width * 4);
+		dcp::xyz_to_rgba (compiled_xyz, compiled, compiled_rgba.get(), size.width * 4, 3);
+		BOOST_REQUIRE (memcmp(reference_rgba.get(), rgba.get(), size.width * size.height * 4) == 0);
+		BOOST_REQUIRE (memcmp(reference_rgba.get(), compiled_rgba.get(), size.width * size.height * 4) == 0);
+	}
+}
+
+
+/** Check that xyz_to_rgb_fast gives results within a level of xyz_to_rgb's */
+BOOST_AUTO_TEST_CASE (xyz_rgb_fast_test)
+{
+	srand (0);
+	dcp::Size const size (640, 480);
+
+	auto xyz = make_shared<dcp::OpenJPEGImage>(size);
+	for (int c = 0; c < 3; ++c) {
+		for (int i = 0; i < size.width * size.height; ++i) {
+			xyz->data(c)[i] = rand() & 0xfff;
+		}
+		/* Make sure that every value is tried */
+		for (int i = 0; i < 4096; ++i) {
+			xyz->data(c)[i] = i;
+		}
+		/* and some out-of-range ones, which should be clamped in the same way */
+		xyz->data(c)[4096] = -1;
+		xyz->data(c)[4097] = -5000;
+		xyz->data(c)[4098] = 4096;
+		xyz->data(c)[4099] = 100000;
+	}
+
+	dcp::CompiledColourConversion conversion (dcp::ColourConversion::srgb_to_xyz());
+
+	scoped_array<uint8_t> slow (new uint8_t[size.width * size.height * 6]);
+	dcp::xyz_to_rgb (xyz, conversion, slow.get(), size.width * 6);
+	scoped_array<uint8_t> fast (new uint8_t[size.width * size.height * 3]);
+	dcp::xyz_to_rgb_fast (xyz, conversion, fast.get(), size.width * 3);
+
+	auto slow_16 = reinterpret_cast<uint16_t*>(slow.get());
+	for (int i = 0; i < size.width * size.height * 3; ++i) {
+		BOOST_REQUIRE (abs((slow_16[i] >> 8) - fast[i]) <= 1);
+	}
+}
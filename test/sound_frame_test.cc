@@ -36,7 +36,9 @@
 #include "sound_frame.h"
 #include "sound_asset.h"
 #include "sound_asset_reader.h"
+#include "sound_asset_writer.h"
 #include "exceptions.h"
+#include "pcm_avx2.h"
 #include <sndfile.h>
 
 using std::shared_ptr;
@@ -99,3 +101,127 @@ BOOST_AUTO_TEST_CASE (sound_frame_test2)
 
 	BOOST_CHECK_THROW (asset.start_read()->get_frame (99999999), dcp::ReadError);
 }
+
+
+/** Check that frames read from a SoundAsset can be written to another one unchanged */
+BOOST_AUTO_TEST_CASE (sound_frame_write_raw_test)
+{
+	boost::filesystem::path const dir = "build/test/sound_frame_write_raw_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+
+	auto in = simple_sound (dir, "_in", dcp::MXFMetadata(), "de-DE");
+
+	dcp::SoundAsset out (in->edit_rate(), in->sampling_rate(), in->channels(), dcp::LanguageTag("de-DE"), dcp::Standard::SMPTE);
+	auto writer = out.start_write (dir / "out.mxf");
+	auto reader = in->start_read ();
+	for (int64_t i = 0; i < in->intrinsic_duration(); ++i) {
+		auto frame = reader->get_frame (i);
+		writer->write (frame->data(), frame->size());
+	}
+	writer->finalize ();
+
+	BOOST_REQUIRE_EQUAL (out.intrinsic_duration(), in->intrinsic_duration());
+
+	auto out_reader = out.start_read ();
+	for (int64_t i = 0; i < in->intrinsic_duration(); ++i) {
+		auto a = reader->get_frame (i);
+		auto b = out_reader->get_frame (i);
+		BOOST_REQUIRE_EQUAL (a->size(), b->size());
+		BOOST_CHECK (memcmp(a->data(), b->data(), a->size()) == 0);
+	}
+}
+
+
+/** Check the PCM written by SoundAssetWriter, with and without AVX2 and a sync channel, against
+ *  a sample-by-sample conversion and a separately-generated sync signal.
+ */
+BOOST_AUTO_TEST_CASE (sound_asset_writer_avx2_test)
+{
+	boost::filesystem::path const dir = "build/test/sound_asset_writer_avx2_test";
+	boost::filesystem::remove_all (dir);
+	boost::filesystem::create_directories (dir);
+
+	int const channels = 16;
+	int const sync_channel = 13;
+	int const samples_per_frame = 2000;
+	std::string const id = "e004046e09234f90a4ae4355e7e83506";
+	/* Chunk lengths which do not fit the 2000-sample frames, and leave a partial frame at the end */
+	int const lengths[] = { 1, 7, 1999, 2001, 33, 4000, 123 };
+
+	srand (0);
+	std::vector<std::vector<float>> samples (channels);
+	for (auto length: lengths) {
+		for (int i = 0; i < channels; ++i) {
+			for (int j = 0; j < length; ++j) {
+				samples[i].push_back((rand() % 2400 - 1200) / 1000.0);
+			}
+		}
+	}
+	samples[0][0] = 1;
+	samples[1][0] = -1;
+	samples[2][0] = 0.5;
+	int const total = samples[0].size();
+
+	/* Convert a sample as the writer has always done: clip, scale and truncate */
+	auto reference = [](float x) {
+		double const clip = 1 - 1.0 / 8388608;
+		return static_cast<int>(std::max(-clip, std::min(clip, static_cast<double>(x))) * 8388608);
+	};
+
+	/* Make the sync signal that should be written for an asset with our ID */
+	dcp::SoundAsset sync_asset (dcp::Fraction(24, 1), 48000, channels, dcp::LanguageTag("en-GB"), dcp::Standard::SMPTE);
+	sync_asset._id = id;
+	auto sync_writer = sync_asset.start_write (dir / "unused.mxf", true);
+	dcp::FSK fsk;
+	std::vector<int> sync;
+	for (int i = 0; i < total; ++i) {
+		if ((i % samples_per_frame) == 0) {
+			sync_writer->_frames_written = i / samples_per_frame;
+			fsk.set_data (sync_writer->create_sync_packets());
+		}
+		sync.push_back (fsk.get());
+	}
+
+	for (auto avx2: { false, true }) {
+		for (auto with_sync: { false, true }) {
+			dcp::set_pcm_avx2 (avx2);
+			dcp::SoundAsset asset (dcp::Fraction(24, 1), 48000, channels, dcp::LanguageTag("en-GB"), dcp::Standard::SMPTE);
+			asset._id = id;
+			auto writer = asset.start_write (dir / "test.mxf", with_sync);
+			int done = 0;
+			for (auto length: lengths) {
+				std::vector<float const*> data;
+				for (int i = 0; i < channels; ++i) {
+					data.push_back (samples[i].data() + done);
+				}
+				writer->write (data.data(), length);
+				done += length;
+			}
+			writer->finalize ();
+			dcp::set_pcm_avx2 (true);
+
+			BOOST_REQUIRE_EQUAL (asset.intrinsic_duration(), (total + samples_per_frame - 1) / samples_per_frame);
+			auto reader = asset.start_read ();
+			for (int64_t i = 0; i < asset.intrinsic_duration(); ++i) {
+				auto frame = reader->get_frame (i);
+				BOOST_REQUIRE_EQUAL (frame->samples(), samples_per_frame);
+				for (int j = 0; j < channels; ++j) {
+					for (int k = 0; k < samples_per_frame; ++k) {
+						int const index = i * samples_per_frame + k;
+						int expected = 0;
+						if (index < total) {
+							expected = (with_sync && j == sync_channel) ? sync[index] : reference(samples[j][index]);
+						}
+						BOOST_REQUIRE_EQUAL (frame->get(j, k), expected);
+					}
+				}
+			}
+
+			auto first = reader->get_frame (0);
+			BOOST_CHECK_EQUAL (first->get(0, 0), 0x7fffff);
+			BOOST_CHECK_EQUAL (first->get(1, 0), -0x7fffff);
+			BOOST_CHECK_EQUAL (first->get(2, 0), 0x400000);
+		}
+	}
+}
@@ -301,11 +301,7 @@ BOOST_AUTO_TEST_CASE (verify_no_error)
 	BOOST_CHECK_EQUAL (st->first, "Checking reel");
 	BOOST_REQUIRE (!st->second);
 	++st;
-	BOOST_CHECK_EQUAL (st->first, "Checking picture asset hash");
-	BOOST_REQUIRE (st->second);
-	BOOST_CHECK_EQUAL (st->second.get(), canonical(dir / "video.mxf"));
-	++st;
-	BOOST_CHECK_EQUAL (st->first, "Checking picture frame sizes");
+	BOOST_CHECK_EQUAL (st->first, "Checking picture asset hash and frame sizes");
 	BOOST_REQUIRE (st->second);
 	BOOST_CHECK_EQUAL (st->second.get(), canonical(dir / "video.mxf"));
 	++st;
@@ -331,6 +327,45 @@ BOOST_AUTO_TEST_CASE (verify_no_error)
 }
 
 
+BOOST_AUTO_TEST_CASE (verify_timings)
+{
+	stages.clear ();
+	auto dir = setup (1, "timings");
+
+	vector<dcp::VerificationTiming> timings;
+	dcp::VerificationOptions options;
+	options.timing = [&timings](dcp::VerificationTiming const& timing) {
+		timings.push_back (timing);
+	};
+	auto notes = dcp::verify ({dir}, &stage, &progress, xsd_test, options);
+	BOOST_CHECK_EQUAL (notes.size(), 0);
+
+	/* There should be one timing for each stage, in the same order */
+	BOOST_REQUIRE_EQUAL (timings.size(), stages.size());
+	auto st = stages.begin();
+	for (auto const& i: timings) {
+		BOOST_CHECK_EQUAL (i.stage, st->first);
+		BOOST_CHECK (i.file == st->second);
+		BOOST_CHECK (i.seconds >= 0);
+		++st;
+	}
+
+	BOOST_CHECK_EQUAL (timings[1].stage, "Checking CPL");
+	BOOST_CHECK_EQUAL (timings[1].bytes, boost::filesystem::file_size(dir / dcp_test1_cpl));
+	BOOST_CHECK_EQUAL (timings[2].stage, "Checking reel");
+	BOOST_CHECK_EQUAL (timings[2].bytes, 0);
+
+	dcp::MonoPictureAsset picture (dir / "video.mxf");
+	BOOST_CHECK_EQUAL (timings[3].stage, "Checking picture asset hash and frame sizes");
+	BOOST_CHECK_EQUAL (timings[3].bytes, boost::filesystem::file_size(dir / "video.mxf"));
+	BOOST_CHECK_EQUAL (timings[3].frames, picture.intrinsic_duration());
+
+	BOOST_CHECK_EQUAL (timings[4].stage, "Checking sound asset hash");
+	BOOST_CHECK_EQUAL (timings[4].bytes, boost::filesystem::file_size(dir / "audio.mxf"));
+	BOOST_CHECK (timings[4].frames > 0);
+}
+
+
 BOOST_AUTO_TEST_CASE (verify_incorrect_picture_sound_hash)
 {
 	using namespace boost::filesystem;
@@ -540,11 +575,7 @@ BOOST_AUTO_TEST_CASE (verify_invalid_standard)
 	BOOST_CHECK_EQUAL (st->first, "Checking reel");
 	BOOST_REQUIRE (!st->second);
 	++st;
-	BOOST_CHECK_EQUAL (st->first, "Checking picture asset hash");
-	BOOST_REQUIRE (st->second);
-	BOOST_CHECK_EQUAL (st->second.get(), canonical(dir / "j2c_c6035f97-b07d-4e1c-944d-603fc2ddc242.mxf"));
-	++st;
-	BOOST_CHECK_EQUAL (st->first, "Checking picture frame sizes");
+	BOOST_CHECK_EQUAL (st->first, "Checking picture asset hash and frame sizes");
 	BOOST_REQUIRE (st->second);
 	BOOST_CHECK_EQUAL (st->second.get(), canonical(dir / "j2c_c6035f97-b07d-4e1c-944d-603fc2ddc242.mxf"));
 	++st;
@@ -680,6 +711,43 @@ BOOST_AUTO_TEST_CASE (verify_valid_picture_frame_size_in_bytes)
 }
 
 
+/** Check that checking picture frames on several threads gives the same notes, in the same order, and the same
+ *  progress reports as doing it serially.
+ */
+BOOST_AUTO_TEST_CASE (verify_picture_frames_with_threads)
+{
+	auto image = black_image ();
+	auto frame = dcp::compress_j2k (image, 100000000, 24, false, false);
+	int const too_big = 1302083 * 2;
+	dcp::ArrayData oversized_frame(too_big);
+	memcpy (oversized_frame.data(), frame.data(), frame.size());
+	memset (oversized_frame.data() + frame.size(), 0, too_big - frame.size());
+
+	path const dir("build/test/verify_picture_frames_with_threads");
+	prepare_directory (dir);
+	dcp_from_frame (oversized_frame, dir);
+
+	vector<float> progress_values;
+	auto record_progress = [&progress_values](float p) {
+		progress_values.push_back (p);
+	};
+
+	for (auto check: { dir, setup(1, "picture_frames_with_threads") }) {
+		progress_values.clear ();
+		auto serial_notes = dcp::verify ({check}, &stage, record_progress, xsd_test);
+		auto serial_progress = progress_values;
+
+		dcp::VerificationOptions options;
+		options.threads = 4;
+		progress_values.clear ();
+		auto threaded_notes = dcp::verify ({check}, &stage, record_progress, xsd_test, options);
+
+		BOOST_CHECK (serial_notes == threaded_notes);
+		BOOST_CHECK (serial_progress == progress_values);
+	}
+}
+
+
 BOOST_AUTO_TEST_CASE (verify_valid_interop_subtitles)
 {
 	path const dir("build/test/verify_valid_interop_subtitles");
@@ -2888,6 +2956,71 @@ BOOST_AUTO_TEST_CASE (verify_partially_encrypted)
 }
 
 
+/** Check that decrypting and checking the frames of an encrypted picture asset on several threads
+ *  gives the same notes and progress reports as doing it serially.
+ */
+BOOST_AUTO_TEST_CASE (verify_encrypted_picture_frames_with_threads)
+{
+	path dir ("build/test/verify_encrypted_picture_frames_with_threads");
+	prepare_directory (dir);
+
+	dcp::DCP d (dir);
+
+	auto signer = make_shared<dcp::CertificateChain>();
+	signer->add (dcp::Certificate(dcp::file_to_string("test/ref/crypt/ca.self-signed.pem")));
+	signer->add (dcp::Certificate(dcp::file_to_string("test/ref/crypt/intermediate.signed.pem")));
+	signer->add (dcp::Certificate(dcp::file_to_string("test/ref/crypt/leaf.signed.pem")));
+	signer->set_key (dcp::file_to_string("test/ref/crypt/leaf.key"));
+
+	auto cpl = make_shared<dcp::CPL>("A Test DCP", dcp::ContentKind::TRAILER, dcp::Standard::SMPTE);
+
+	dcp::Key key;
+
+	auto mp = make_shared<dcp::MonoPictureAsset>(dcp::Fraction (24, 1), dcp::Standard::SMPTE);
+	mp->set_key (key);
+
+	auto writer = mp->start_write (dir / "video.mxf", false);
+	dcp::ArrayData j2c ("test/data/flat_red.j2c");
+	for (int i = 0; i < 24; ++i) {
+		writer->write (j2c.data(), j2c.size());
+	}
+	writer->finalize ();
+
+	auto reel = make_shared<dcp::Reel>(
+		make_shared<dcp::ReelMonoPictureAsset>(mp, 0),
+		make_shared<dcp::ReelSoundAsset>(simple_sound(dir, "", dcp::MXFMetadata(), "de-DE"), 0)
+		);
+	cpl->add (reel);
+	d.add (cpl);
+	d.write_xml ("OpenDCP 0.0.25", "OpenDCP 0.0.25", "2012-07-17T04:45:18+00:00", "A Test DCP", signer);
+
+	dcp::VerificationOptions options;
+	options.kdms.push_back (
+		dcp::DecryptedKDM(
+			cpl, key, dcp::LocalTime("2016-01-01T00:00:00+00:00"), dcp::LocalTime("2017-01-01T00:00:00+00:00"), "", "", ""
+			)
+		);
+
+	vector<float> progress_values;
+	auto record_progress = [&progress_values](float p) {
+		progress_values.push_back (p);
+	};
+
+	auto serial_notes = dcp::verify ({dir}, &stage, record_progress, xsd_test, options);
+	auto serial_progress = progress_values;
+
+	options.threads = 4;
+	progress_values.clear ();
+	auto threaded_notes = dcp::verify ({dir}, &stage, record_progress, xsd_test, options);
+
+	BOOST_CHECK (serial_notes == threaded_notes);
+	BOOST_CHECK (serial_progress == progress_values);
+	for (auto const& i: threaded_notes) {
+		BOOST_CHECK (i.code() != dcp::VerificationNote::Code::FAILED_READ);
+	}
+}
+
+
 BOOST_AUTO_TEST_CASE (verify_jpeg2000_codestream_2k)
 {
 	vector<dcp::VerificationNote> notes;
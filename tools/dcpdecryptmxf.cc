@@ -43,17 +43,30 @@
 #include "key.h"
 #include "mono_picture_asset.h"
 #include "mono_picture_asset_writer.h"
+#include "sound_asset.h"
+#include "sound_asset_reader.h"
+#include "sound_asset_writer.h"
+#include "sound_frame.h"
 #include "util.h"
 #include <asdcp/AS_DCP.h>
 #include <getopt.h>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 
 using std::cerr;
 using std::cout;
 using std::shared_ptr;
 using std::string;
+using std::vector;
 using boost::optional;
 
 
@@ -68,21 +81,116 @@ help (string n)
 	     << "  -o, --output       output filename\n"
 	     << "  -k, --kdm          KDM file\n"
 	     << "  -p, --private-key  private key file\n"
-	     << "  -t, --type         MXF type: picture or atmos\n"
-	     << "  -i, --ignore-hmac  don't raise an error if HMACs don't agree\n";
+	     << "  -t, --type         MXF type: picture, sound or atmos\n"
+	     << "  -i, --ignore-hmac  don't raise an error if HMACs don't agree\n"
+	     << "  -j, --threads      number of threads to read and decrypt frames with\n";
 }
 
+/** Copy the frames of `in' to `writer'.  Frames are read and decrypted on `threads' threads, each using its own
+ *  reader (and hence its own decryption context), and written in order on the calling thread.  No more than a
+ *  few frames per thread are held between being read and written.
+ */
 template <class T, class U>
-void copy (T const& in, shared_ptr<U> writer, bool ignore_hmac)
+void copy (T const& in, shared_ptr<U> writer, bool ignore_hmac, int threads)
 {
-	auto reader = in.start_read();
-	reader->set_check_hmac (!ignore_hmac);
-	for (int64_t i = 0; i < in.intrinsic_duration(); ++i) {
-		auto frame = reader->get_frame (i);
-		writer->write (frame->data(), frame->size());
+	typedef decltype(in.start_read()->get_frame(0)) Frame;
+
+	auto const duration = in.intrinsic_duration();
+	/* Maximum number of frames that may be read but not yet written */
+	int64_t const window = threads * 4;
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	/* Frames which have been read but not yet written, keyed by index */
+	std::map<int64_t, Frame> ready;
+	/* Index of the next frame to write */
+	int64_t next = 0;
+	bool stop = false;
+	std::exception_ptr error;
+
+	vector<std::thread> readers;
+	for (int t = 0; t < threads; ++t) {
+		readers.push_back (std::thread([&, t]() {
+			try {
+				auto reader = in.start_read ();
+				reader->set_check_hmac (!ignore_hmac);
+				for (int64_t i = t; i < duration; i += threads) {
+					{
+						std::unique_lock<std::mutex> lock (mutex);
+						changed.wait (lock, [&]() { return stop || i < next + window; });
+						if (stop) {
+							return;
+						}
+					}
+					auto frame = reader->get_frame (i);
+					std::unique_lock<std::mutex> lock (mutex);
+					ready[i] = frame;
+					changed.notify_all ();
+				}
+			} catch (...) {
+				std::unique_lock<std::mutex> lock (mutex);
+				if (!error) {
+					error = std::current_exception ();
+				}
+				stop = true;
+				changed.notify_all ();
+			}
+		}));
+	}
+
+	auto finish = [&]() {
+		{
+			std::unique_lock<std::mutex> lock (mutex);
+			stop = true;
+			changed.notify_all ();
+		}
+		for (auto& i: readers) {
+			i.join ();
+		}
+	};
+
+	auto const start = std::chrono::steady_clock::now ();
+	int64_t bytes = 0;
+
+	try {
+		while (next < duration) {
+			Frame frame;
+			{
+				std::unique_lock<std::mutex> lock (mutex);
+				changed.wait (lock, [&]() { return error || ready.find(next) != ready.end(); });
+				if (error) {
+					break;
+				}
+				auto i = ready.find (next);
+				frame = i->second;
+				ready.erase (i);
+			}
+
+			writer->write (frame->data(), frame->size());
+			bytes += frame->size();
+
+			std::unique_lock<std::mutex> lock (mutex);
+			++next;
+			changed.notify_all ();
+		}
+	} catch (...) {
+		finish ();
+		throw;
 	}
-	writer->finalize();
-};
+
+	finish ();
+
+	if (error) {
+		std::rethrow_exception (error);
+	}
+
+	writer->finalize ();
+
+	auto const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	cout << std::fixed << std::setprecision(1)
+	     << "Copied " << duration << " frames (" << (bytes / 1e6) << "MB) in " << seconds << "s: "
+	     << (seconds > 0 ? duration / seconds : 0) << " frames/s, " << (seconds > 0 ? bytes / 1e6 / seconds : 0) << "MB/s\n";
+}
 
 
 int
@@ -95,9 +203,11 @@ main (int argc, char* argv[])
 	optional<boost::filesystem::path> kdm_file;
 	optional<boost::filesystem::path> private_key_file;
 	bool ignore_hmac = false;
+	int threads = std::max(1U, std::thread::hardware_concurrency());
 
 	enum class Type {
 		PICTURE,
+		SOUND,
 		ATMOS,
 	};
 
@@ -114,10 +224,11 @@ main (int argc, char* argv[])
 			{ "private-key", required_argument, 0, 'p'},
 			{ "type", required_argument, 0, 't' },
 			{ "ignore-hmac", no_argument, 0, 'i' },
+			{ "threads", required_argument, 0, 'j' },
 			{ 0, 0, 0, 0 }
 		};
 
-		int c = getopt_long (argc, argv, "Avho:k:p:t:i", long_options, &option_index);
+		int c = getopt_long (argc, argv, "Avho:k:p:t:ij:", long_options, &option_index);
 
 		if (c == -1) {
 			break;
@@ -145,6 +256,8 @@ main (int argc, char* argv[])
 		case 't':
 			if (strcmp(optarg, "picture") == 0) {
 				type = Type::PICTURE;
+			} else if (strcmp(optarg, "sound") == 0) {
+				type = Type::SOUND;
 			} else if (strcmp(optarg, "atmos") == 0) {
 				type = Type::ATMOS;
 			} else {
@@ -155,6 +268,9 @@ main (int argc, char* argv[])
 		case 'i':
 			ignore_hmac = true;
 			break;
+		case 'j':
+			threads = std::max(1, atoi(optarg));
+			break;
 		}
 	}
 
@@ -221,7 +337,22 @@ main (int argc, char* argv[])
 				in.atmos_version()
 				);
 			auto writer = out.start_write (output_file.get());
-			copy (in, writer, ignore_hmac);
+			copy (in, writer, ignore_hmac, threads);
+			break;
+		}
+		case Type::SOUND:
+		{
+			dcp::SoundAsset in (input_file);
+			add_key (in, decrypted_kdm);
+			dcp::SoundAsset out (
+				in.edit_rate(),
+				in.sampling_rate(),
+				in.channels(),
+				dcp::LanguageTag(in.language().get_value_or("und")),
+				in.standard()
+				);
+			auto writer = out.start_write (output_file.get());
+			copy (in, writer, ignore_hmac, threads);
 			break;
 		}
 		case Type::PICTURE:
@@ -230,7 +361,7 @@ main (int argc, char* argv[])
 			add_key (in, decrypted_kdm);
 			dcp::MonoPictureAsset out (in.edit_rate(), dcp::Standard::SMPTE);
 			auto writer = out.start_write (output_file.get(), false);
-			copy (in, writer, ignore_hmac);
+			copy (in, writer, ignore_hmac, threads);
 			break;
 		}
 		}
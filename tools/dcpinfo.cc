@@ -157,6 +157,7 @@ main_picture (vector<string> const& only, shared_ptr<Reel> reel, bool analyse, b
 		shared_ptr<MonoPictureAsset> ma = dynamic_pointer_cast<MonoPictureAsset>(mp->asset());
 		if (analyse && ma) {
 			shared_ptr<MonoPictureAssetReader> reader = ma->start_read ();
+			reader->set_read_ahead (8);
 			pair<int, int> j2k_size_range (INT_MAX, 0);
 			for (int64_t i = 0; i < ma->intrinsic_duration(); ++i) {
 				shared_ptr<const MonoPictureFrame> frame = reader->get_frame (i);
@@ -34,10 +34,16 @@
 #include "verify.h"
 #include "compose.hpp"
 #include "common.h"
+#include "decrypted_kdm.h"
+#include "digest_cache.h"
+#include "encrypted_kdm.h"
+#include "exceptions.h"
+#include "util.h"
 #include <boost/bind.hpp>
 #include <boost/optional.hpp>
 #include <boost/filesystem.hpp>
 #include <getopt.h>
+#include <iomanip>
 #include <iostream>
 #include <cstdlib>
 
@@ -57,7 +63,13 @@ help (string n)
 	     << "  -h, --help              show this help\n"
 	     << "  --ignore-missing-assets don't give errors about missing assets\n"
 	     << "  --ignore-bv21-smpte     don't give the SMPTE Bv2.1 error about a DCP not being SMPTE\n"
-	     << "  -q, --quiet             don't report progress\n";
+	     << "  -t, --threads           number of threads to use when checking picture frames\n"
+	     << "  --digest-cache <file>   keep asset digests in <file> and re-hash assets to check them\n"
+	     << "  --trust-digest-cache    use digests from the --digest-cache file rather than re-hashing unchanged assets\n"
+	     << "  -k, --kdm <file>        KDM to decrypt encrypted assets with, so that their picture frames can be checked\n"
+	     << "  -p, --private-key <file> private key to decrypt the KDM with\n"
+	     << "  -q, --quiet             don't report progress\n"
+	     << "  --timings               report how long each stage of the verification took\n";
 }
 
 void
@@ -80,6 +92,32 @@ progress ()
 
 }
 
+static void
+print_timings (vector<dcp::VerificationTiming> const& timings)
+{
+	cout << "\nTimings:\n";
+	cout << std::setw(10) << "seconds" << std::setw(12) << "MB" << std::setw(10) << "MB/s" << std::setw(10) << "frames" << std::setw(10) << "fps" << "  stage\n";
+
+	double total_seconds = 0;
+	int64_t total_bytes = 0;
+	auto line = [](double seconds, int64_t bytes, int64_t frames, string name) {
+		cout << std::fixed << std::setprecision(3) << std::setw(10) << seconds
+		     << std::setprecision(1) << std::setw(12) << bytes / 1e6
+		     << std::setw(10) << (seconds > 0 ? bytes / 1e6 / seconds : 0)
+		     << std::setw(10) << frames
+		     << std::setw(10) << (seconds > 0 ? frames / seconds : 0)
+		     << "  " << name << "\n";
+	};
+
+	for (auto const& i: timings) {
+		line (i.seconds, i.bytes, i.frames, i.file ? i.stage + ": " + i.file->filename().string() : i.stage);
+		total_seconds += i.seconds;
+		total_bytes += i.bytes;
+	}
+
+	line (total_seconds, total_bytes, 0, "Total");
+}
+
 int
 main (int argc, char* argv[])
 {
@@ -88,6 +126,12 @@ main (int argc, char* argv[])
 	bool ignore_missing_assets = false;
 	bool ignore_bv21_smpte = false;
 	bool quiet = false;
+	bool timings = false;
+	optional<boost::filesystem::path> digest_cache;
+	bool trust_digest_cache = false;
+	optional<boost::filesystem::path> kdm_file;
+	optional<boost::filesystem::path> private_key_file;
+	dcp::VerificationOptions verification_options;
 
 	int option_index = 0;
 	while (true) {
@@ -97,10 +141,16 @@ main (int argc, char* argv[])
 			{ "ignore-missing-assets", no_argument, 0, 'A' },
 			{ "ignore-bv21-smpte", no_argument, 0, 'B' },
 			{ "quiet", no_argument, 0, 'q' },
+			{ "threads", required_argument, 0, 't' },
+			{ "digest-cache", required_argument, 0, 'C' },
+			{ "trust-digest-cache", no_argument, 0, 'T' },
+			{ "kdm", required_argument, 0, 'k' },
+			{ "private-key", required_argument, 0, 'p' },
+			{ "timings", no_argument, 0, 'M' },
 			{ 0, 0, 0, 0 }
 		};
 
-		int c = getopt_long (argc, argv, "VhABq", long_options, &option_index);
+		int c = getopt_long (argc, argv, "VhABqt:C:Tk:p:M", long_options, &option_index);
 
 		if (c == -1) {
 			break;
@@ -122,6 +172,24 @@ main (int argc, char* argv[])
 		case 'q':
 			quiet = true;
 			break;
+		case 't':
+			verification_options.threads = atoi (optarg);
+			break;
+		case 'C':
+			digest_cache = optarg;
+			break;
+		case 'T':
+			trust_digest_cache = true;
+			break;
+		case 'k':
+			kdm_file = optarg;
+			break;
+		case 'p':
+			private_key_file = optarg;
+			break;
+		case 'M':
+			timings = true;
+			break;
 		}
 	}
 
@@ -135,11 +203,50 @@ main (int argc, char* argv[])
 		exit (EXIT_FAILURE);
 	}
 
+	if (trust_digest_cache && !digest_cache) {
+		cerr << argv[0] << ": --trust-digest-cache needs --digest-cache.\n";
+		exit (EXIT_FAILURE);
+	}
+
+	if (static_cast<bool>(kdm_file) != static_cast<bool>(private_key_file)) {
+		cerr << argv[0] << ": --kdm and --private-key must be given together.\n";
+		exit (EXIT_FAILURE);
+	}
+
+	if (kdm_file) {
+		dcp::EncryptedKDM encrypted_kdm (dcp::file_to_string(*kdm_file));
+		verification_options.kdms.push_back (dcp::DecryptedKDM(encrypted_kdm, dcp::file_to_string(*private_key_file)));
+	}
+
+	if (digest_cache) {
+		dcp::set_digest_cache (
+			std::make_shared<dcp::DigestCache>(*digest_cache, trust_digest_cache ? dcp::DigestCache::Policy::TRUST : dcp::DigestCache::Policy::VERIFY)
+			);
+	}
+
+	vector<dcp::VerificationTiming> stage_timings;
+	if (timings) {
+		verification_options.timing = [&stage_timings](dcp::VerificationTiming const& timing) {
+			stage_timings.push_back (timing);
+		};
+	}
+
 	vector<boost::filesystem::path> directories;
 	directories.push_back (argv[optind]);
-	auto notes = dcp::verify (directories, bind(&stage, quiet, _1, _2), bind(&progress));
+	auto notes = dcp::verify (directories, bind(&stage, quiet, _1, _2), bind(&progress), boost::none, verification_options);
 	dcp::filter_notes (notes, ignore_missing_assets);
 
+	if (auto cache = dcp::digest_cache()) {
+		for (auto const& i: cache->mismatches()) {
+			cerr << argv[0] << ": cached digest of " << i.string() << " was wrong\n";
+		}
+		try {
+			cache->flush ();
+		} catch (dcp::FileError& e) {
+			cerr << argv[0] << ": " << e.what() << "\n";
+		}
+	}
+
 	bool failed = false;
 	for (auto i: notes) {
 		if (ignore_bv21_smpte && i.code() == dcp::VerificationNote::Code::INVALID_STANDARD) {
@@ -163,5 +270,9 @@ main (int argc, char* argv[])
 		cout << "DCP verified OK.\n";
 	}
 
+	if (timings) {
+		print_timings (stage_timings);
+	}
+
 	exit (failed ? EXIT_FAILURE : EXIT_SUCCESS);
 }